@@ -0,0 +1,275 @@
+#include "Trace.h"
+#include "Branch_Predictor.h"
+#include "Bench.h"
+
+// Throughput benchmark of the compiled-in predictor on synthetic branch
+// streams. Every stream is generated from a fixed seed, so runs are
+// comparable across commits. `make bench` builds and runs one binary per
+// predictor.
+//
+// --check instead holds the tournament predictor to nearly perfect accuracy
+// on the nested loops, whose exits its per-branch local histories learn;
+// without them it falls below 99%. `make check` runs it.
+
+#define num_streams 3
+#define check_min_correct 99.9 // Percent of the loops --check needs right
+
+const char *streamNames[num_streams] = {"loops", "correlated", "random"};
+
+// Nested loops: exit branches with trip counts 4, 7 and 13 around two
+// always-taken body branches.
+static void genLoops(uint64_t *pcs, uint8_t *taken, uint64_t count, uint64_t *seed)
+{
+    unsigned trip[3] = {4, 7, 13};
+    unsigned iter[3] = {0, 0, 0};
+    uint64_t i = 0;
+    while (i < count)
+    {
+        pcs[i] = 0x400100; taken[i] = 1; if (++i == count) break;
+        pcs[i] = 0x400140; taken[i] = 1; if (++i == count) break;
+
+        // Innermost loop back edge, then the enclosing ones when it exits
+        int level;
+        for (level = 0; level < 3 && i < count; level++)
+        {
+            bool back = ++iter[level] < trip[level];
+            pcs[i] = 0x400200 + 0x40 * level;
+            taken[i] = back;
+            ++i;
+            if (back)
+            {
+                break;
+            }
+            iter[level] = 0;
+        }
+    }
+}
+
+// Pairs of random branches followed by a branch on their xor, plus a
+// branch that repeats the previous outcome.
+static void genCorrelated(uint64_t *pcs, uint8_t *taken, uint64_t count, uint64_t *seed)
+{
+    uint64_t i = 0;
+    while (i < count)
+    {
+        uint64_t r = benchRandom(seed);
+        uint8_t a = r & 1, b = (r >> 1) & 1;
+        uint64_t site = 0x500000 + ((r >> 8) & 63) * 0x100; // 64 call sites
+
+        pcs[i] = site; taken[i] = a; if (++i == count) break;
+        pcs[i] = site + 0x10; taken[i] = b; if (++i == count) break;
+        pcs[i] = site + 0x20; taken[i] = a ^ b; if (++i == count) break;
+        pcs[i] = site + 0x30; taken[i] = a; ++i;
+    }
+}
+
+// 4096 static branches with random biases, some of them unbiased
+static void genRandom(uint64_t *pcs, uint8_t *taken, uint64_t count, uint64_t *seed)
+{
+    double bias[4096];
+    unsigned i;
+    for (i = 0; i < 4096; i++)
+    {
+        bias[i] = benchUniform(seed);
+    }
+
+    uint64_t j;
+    for (j = 0; j < count; j++)
+    {
+        unsigned site = benchRandom(seed) & 4095;
+        pcs[j] = 0x600000 + site * 4;
+        taken[j] = benchUniform(seed) < bias[site];
+    }
+}
+
+static void genStream(int stream, uint64_t *pcs, uint8_t *taken, uint64_t count, uint64_t seed)
+{
+    if (stream == 0)
+    {
+        genLoops(pcs, taken, count, &seed);
+    }
+    else if (stream == 1)
+    {
+        genCorrelated(pcs, taken, count, &seed);
+    }
+    else
+    {
+        genRandom(pcs, taken, count, &seed);
+    }
+}
+
+// The tournament predictor on the loops, through predict() and
+// predictBatch() both
+static bool checkLoops(Branch_Predictor_Config *config, uint64_t *pcs, uint8_t *taken,
+                       uint8_t *correct, uint64_t count, uint64_t seed)
+{
+    config->type = TOURNAMENT_PREDICTOR;
+    genStream(0, pcs, taken, count, seed);
+
+    Branch_Predictor *branch_predictor = initBranchPredictor(config);
+    Instruction instr;
+    instr.instr_type = BRANCH;
+    uint64_t num_correct = 0;
+    uint64_t i;
+    for (i = 0; i < count; i++)
+    {
+        instr.PC = pcs[i];
+        instr.taken = taken[i];
+        num_correct += predict(branch_predictor, &instr);
+    }
+    freeBranchPredictor(branch_predictor);
+
+    branch_predictor = initBranchPredictor(config);
+    uint64_t batch_correct = 0;
+    for (i = 0; i < count; i += 4096)
+    {
+        unsigned len = count - i < 4096 ? count - i : 4096;
+        batch_correct += predictBatch(branch_predictor, &pcs[i], &taken[i], len, &correct[i], NULL);
+    }
+    freeBranchPredictor(branch_predictor);
+
+    double percent = count ? 100.0 * num_correct / count : 0;
+    bool ok = batch_correct == num_correct && percent >= check_min_correct;
+    printf("%s %s: %.3f%% correct, %.3f%% needed%s\n", predictorName(config->type),
+           streamNames[0], percent, check_min_correct,
+           batch_correct != num_correct ? ", predictBatch() disagrees" : "");
+    printf("%s\n", ok ? "Check passed" : "Check FAILED");
+    return ok;
+}
+
+// Write a stream as a CPU trace Main can read; one EXE between branches
+static void writeStream(const char *file, const uint64_t *pcs, const uint8_t *taken, uint64_t count)
+{
+    FILE *fd = fopen(file, "w");
+    if (fd == NULL)
+    {
+        perror(file);
+        exit(1);
+    }
+
+    uint64_t i;
+    for (i = 0; i < count; i++)
+    {
+        fprintf(fd, "%"PRIu64" E\n", pcs[i] - 4);
+        fprintf(fd, "%"PRIu64" B %d\n", pcs[i], taken[i]);
+    }
+    fclose(fd);
+}
+
+int main(int argc, const char *argv[])
+{
+    uint64_t count = 10000000;
+    uint64_t seed = 42;
+    const char *write_stream = NULL;
+    const char *write_file = NULL;
+    bool check = false;
+
+    Branch_Predictor_Config predictor_config;
+    initPredictorConfig(&predictor_config);
+
+    int arg;
+    for (arg = 1; arg < argc; arg++)
+    {
+        if (strcmp(argv[arg], "--records") == 0 && arg + 1 < argc)
+        {
+            count = strtoull(argv[++arg], NULL, 10);
+        }
+        else if (strcmp(argv[arg], "--seed") == 0 && arg + 1 < argc)
+        {
+            seed = strtoull(argv[++arg], NULL, 10);
+        }
+        else if (strcmp(argv[arg], "--write") == 0 && arg + 2 < argc)
+        {
+            write_stream = argv[++arg];
+            write_file = argv[++arg];
+        }
+        else if (strcmp(argv[arg], "--check") == 0)
+        {
+            check = true;
+        }
+        else if (parsePredictorOption(&predictor_config, argc, argv, &arg))
+        {
+        }
+        else
+        {
+            printf("Usage: %s [--records N] [--seed S] [--predictor <name>] %s\n", argv[0],
+                   "[--write <stream> <trace-file>]");
+            printf("       %s --check [--records N] [--seed S]\n", argv[0]);
+            printf("  streams: loops, correlated, random\n");
+            return 0;
+        }
+    }
+
+    uint64_t *pcs = (uint64_t *)malloc(count * sizeof(uint64_t));
+    uint8_t *taken = (uint8_t *)malloc(count);
+    uint8_t *correct = (uint8_t *)malloc(count);
+
+    if (check)
+    {
+        return checkLoops(&predictor_config, pcs, taken, correct, count, seed) ? 0 : 1;
+    }
+
+    int stream;
+    if (write_stream != NULL)
+    {
+        for (stream = 0; stream < num_streams; stream++)
+        {
+            if (strcmp(write_stream, streamNames[stream]) == 0)
+            {
+                genStream(stream, pcs, taken, count, seed);
+                writeStream(write_file, pcs, taken, count);
+                return 0;
+            }
+        }
+        fprintf(stderr, "Unknown stream: %s\n", write_stream);
+        return 1;
+    }
+
+    for (stream = 0; stream < num_streams; stream++)
+    {
+        genStream(stream, pcs, taken, count, seed);
+
+        // One branch at a time through predict()
+        Branch_Predictor *branch_predictor = initBranchPredictor(&predictor_config);
+        Instruction instr;
+        instr.instr_type = BRANCH;
+
+        uint64_t num_correct = 0;
+        uint64_t start = benchNowNs();
+        uint64_t i;
+        for (i = 0; i < count; i++)
+        {
+            instr.PC = pcs[i];
+            instr.taken = taken[i];
+            num_correct += predict(branch_predictor, &instr);
+        }
+        uint64_t single_ns = benchNowNs() - start;
+
+        // The same stream through predictBatch()
+        freeBranchPredictor(branch_predictor);
+        branch_predictor = initBranchPredictor(&predictor_config);
+        start = benchNowNs();
+        uint64_t batch_correct = 0;
+        for (i = 0; i < count; i += 4096)
+        {
+            unsigned len = count - i < 4096 ? count - i : 4096;
+            batch_correct += predictBatch(branch_predictor, &pcs[i], &taken[i], len, &correct[i], NULL);
+        }
+        uint64_t batch_ns = benchNowNs() - start;
+
+        if (batch_correct != num_correct)
+        {
+            fprintf(stderr, "%s: predictBatch() disagrees with predict()\n", streamNames[stream]);
+            return 1;
+        }
+
+        printf("%-14s %-11s %12.0f rec/s %8.2f ns/predict %8.2f ns/batched %10ld KB peak RSS %8.3f%% correct\n",
+               predictorName(predictor_config.type), streamNames[stream],
+               count / (single_ns / 1e9), (double)single_ns / count, (double)batch_ns / count,
+               benchPeakRssKb(), 100.0 * num_correct / count);
+
+        freeBranchPredictor(branch_predictor);
+    }
+
+    return 0;
+}
@@ -1,291 +1,386 @@
 #include "Branch_Predictor.h"
 
+#include <string.h>
+
 const unsigned instShiftAmt = 2; // Number of bits to shift a PC by
+const unsigned prefetchDistance = 16; // How many branches ahead predictBatch() prefetches
 
-// You can play around with these settings.
-const unsigned localPredictorSize = 65536;
-const unsigned localCounterBits = 2;
-const unsigned localHistoryTableSize = 8192; 
-const unsigned globalPredictorSize = 16384;
-const unsigned globalCounterBits = 2;
-const unsigned choicePredictorSize = 16384; // Keep this the same as globalPredictorSize.
-const unsigned choiceCounterBits = 2;
-const unsigned gshareCounterBits = 2; //Do not change this
-const unsigned gsharePredictorSize = 65536;
-const float theta = 1.93*n + 14;
-
-Branch_Predictor *initBranchPredictor()
+void initPredictorConfig(Branch_Predictor_Config *config)
 {
-    Branch_Predictor *branch_predictor = (Branch_Predictor *)malloc(sizeof(Branch_Predictor));
-
     #ifdef TWO_BIT_LOCAL
-    branch_predictor->local_predictor_sets = localPredictorSize;
-    assert(checkPowerofTwo(branch_predictor->local_predictor_sets));
-
-    branch_predictor->index_mask = branch_predictor->local_predictor_sets - 1;
+    config->type = TWO_BIT_LOCAL_PREDICTOR;
+    #endif
+    #ifdef TOURNAMENT
+    config->type = TOURNAMENT_PREDICTOR;
+    #endif
+    #ifdef GSHARE
+    config->type = GSHARE_PREDICTOR;
+    #endif
+    #ifdef perceptron
+    config->type = PERCEPTRON_PREDICTOR;
+    #endif
 
-    // Initialize sat counters
-    branch_predictor->local_counters =
-        (Sat_Counter *)malloc(branch_predictor->local_predictor_sets * sizeof(Sat_Counter));
+    // You can play around with these settings.
+    config->local_predictor_size = 65536;
+    config->local_counter_bits = 2;
+    config->local_history_bits = 16; // At most log2(local_predictor_size)
+    config->local_history_table_size = 8192;
+    config->global_predictor_size = 16384;
+    config->global_counter_bits = 2;
+    config->choice_counter_bits = 2;
+    config->gshare_predictor_size = 65536;
+    config->gshare_counter_bits = 2; //Do not change this
+    config->perceptron_size = 131072;
+    config->perceptron_history = 62;
+    config->theta = 0;
+    config->pages = HUGE_PAGES; // Backing of the tables (see Arena.h)
+}
 
-    int i = 0;
-    for (i; i < branch_predictor->local_predictor_sets; i++)
+bool parsePredictorOption(Branch_Predictor_Config *config, int argc, const char *argv[], int *arg)
+{
+    if (*arg + 1 >= argc)
     {
-        initSatCounter(&(branch_predictor->local_counters[i]), localCounterBits);
+        return false;
     }
-    #endif
-	
-	#ifdef TOURNAMENT
-    assert(checkPowerofTwo(localPredictorSize));
-    assert(checkPowerofTwo(localHistoryTableSize));
-    assert(checkPowerofTwo(globalPredictorSize));
-    assert(checkPowerofTwo(choicePredictorSize));
-    assert(globalPredictorSize == choicePredictorSize);
-
-    branch_predictor->local_predictor_size = localPredictorSize;
-    branch_predictor->local_history_table_size = localHistoryTableSize;
-    branch_predictor->global_predictor_size = globalPredictorSize;
-    branch_predictor->choice_predictor_size = choicePredictorSize;
-   
-    // Initialize local counters 
-    branch_predictor->local_counters =
-        (Sat_Counter *)malloc(localPredictorSize * sizeof(Sat_Counter));
-
-    int i = 0;
-    for (i; i < localPredictorSize; i++)
+
+    if (strcmp(argv[*arg], "--predictor") == 0 && parsePredictorType(argv[*arg + 1], &config->type))
     {
-        initSatCounter(&(branch_predictor->local_counters[i]), localCounterBits);
+        ++*arg;
+        return true;
     }
+    return false;
+}
 
-    branch_predictor->local_predictor_mask = localPredictorSize - 1;
+void printPredictorUsage()
+{
+    Branch_Predictor_Config config;
+    initPredictorConfig(&config);
 
-    // Initialize local history table
-    branch_predictor->local_history_table = 
-        (unsigned *)malloc(localHistoryTableSize * sizeof(unsigned));
+    printf("  --predictor <name> two_bit_local, tournament, gshare or perceptron\n");
+    printf("                     (default %s)\n", predictorName(config.type));
+}
 
-    for (i = 0; i < localHistoryTableSize; i++)
+static bool checkTableSize(const char *table, unsigned size)
+{
+    if (!checkPowerofTwo(size))
     {
-        branch_predictor->local_history_table[i] = 0;
+        fprintf(stderr, "The %s size %u is not a power of two\n", table, size);
+        return false;
     }
+    return true;
+}
 
-    branch_predictor->local_history_table_mask = localHistoryTableSize - 1;
-
-    // Initialize global counters
-    branch_predictor->global_counters = 
-        (Sat_Counter *)malloc(globalPredictorSize * sizeof(Sat_Counter));
+static bool checkCounterBits(const char *table, unsigned counter_bits)
+{
+    if (counter_bits < 1 || counter_bits > 8)
+    {
+        fprintf(stderr, "The %s counters must have 1 to 8 bits, not %u\n", table, counter_bits);
+        return false;
+    }
+    return true;
+}
 
-    for (i = 0; i < globalPredictorSize; i++)
+bool checkPredictorConfig(const Branch_Predictor_Config *config)
+{
+    switch (config->type)
     {
-        initSatCounter(&(branch_predictor->global_counters[i]), globalCounterBits);
+        case TWO_BIT_LOCAL_PREDICTOR:
+            return checkTableSize("local predictor", config->local_predictor_size) &&
+                   checkCounterBits("local predictor", config->local_counter_bits);
+
+        case TOURNAMENT_PREDICTOR:
+            if (!checkTableSize("local predictor", config->local_predictor_size) ||
+                !checkTableSize("local history table", config->local_history_table_size) ||
+                !checkTableSize("global predictor", config->global_predictor_size) ||
+                !checkCounterBits("local predictor", config->local_counter_bits) ||
+                !checkCounterBits("global predictor", config->global_counter_bits) ||
+                !checkCounterBits("choice predictor", config->choice_counter_bits))
+            {
+                return false;
+            }
+            if (config->local_history_bits >= 32 ||
+                (1u << config->local_history_bits) > config->local_predictor_size)
+            {
+                fprintf(stderr, "A local history of %u bits does not fit %u local counters\n",
+                        config->local_history_bits, config->local_predictor_size);
+                return false;
+            }
+            return true;
+
+        case GSHARE_PREDICTOR:
+            return checkTableSize("gshare predictor", config->gshare_predictor_size) &&
+                   checkCounterBits("gshare predictor", config->gshare_counter_bits);
+
+        case PERCEPTRON_PREDICTOR:
+            if (!checkTableSize("perceptron", config->perceptron_size))
+            {
+                return false;
+            }
+            if (config->perceptron_history == 0)
+            {
+                fprintf(stderr, "The perceptron needs some history\n");
+                return false;
+            }
+            return true;
     }
 
-    branch_predictor->global_history_mask = globalPredictorSize - 1;
+    fprintf(stderr, "Unknown predictor type %d\n", (int)config->type);
+    return false;
+}
 
-    // Initialize choice counters
-    branch_predictor->choice_counters = 
-        (Sat_Counter *)malloc(choicePredictorSize * sizeof(Sat_Counter));
+// Room of a counter table in an arena
+static uint64_t counterTableBytes(unsigned size, unsigned counter_bits)
+{
+    return arenaBytes(counterTableWords(size, counter_bits) * sizeof(uint64_t));
+}
+
+// Counter table of the arena, all counters at zero
+static void initCounterTableInArena(Counter_Table *table, Arena *arena, unsigned size,
+                                    unsigned counter_bits)
+{
+    uint64_t *words = (uint64_t *)arenaAlloc(arena, counterTableWords(size, counter_bits) * sizeof(uint64_t));
+    initCounterTableIn(table, words, true, size, counter_bits, 0);
+}
 
-    for (i = 0; i < choicePredictorSize; i++)
+Branch_Predictor *initBranchPredictor(const Branch_Predictor_Config *config)
+{
+    if (!checkPredictorConfig(config))
     {
-        initSatCounter(&(branch_predictor->choice_counters[i]), choiceCounterBits);
+        return NULL;
     }
 
-    branch_predictor->choice_history_mask = choicePredictorSize - 1;
-
-    // global history register
-    branch_predictor->global_history = 0;
+    // Everything lives in one arena: the predictor, then its tables
+    uint64_t arena_size = arenaBytes(sizeof(Branch_Predictor));
+    switch (config->type)
+    {
+        case TWO_BIT_LOCAL_PREDICTOR:
+            arena_size += counterTableBytes(config->local_predictor_size, config->local_counter_bits);
+            break;
+
+        case TOURNAMENT_PREDICTOR:
+            arena_size += counterTableBytes(config->local_predictor_size, config->local_counter_bits) +
+                          arenaBytes(config->local_history_table_size * sizeof(unsigned)) +
+                          counterTableBytes(config->global_predictor_size, config->global_counter_bits) +
+                          counterTableBytes(config->global_predictor_size, config->choice_counter_bits);
+            break;
+
+        case GSHARE_PREDICTOR:
+            arena_size += counterTableBytes(config->gshare_predictor_size, config->gshare_counter_bits);
+            break;
+
+        case PERCEPTRON_PREDICTOR:
+            arena_size += arenaBytes(config->perceptron_history * sizeof(int64_t)) +
+                          arenaBytes((uint64_t)config->perceptron_size * config->perceptron_history *
+                                     sizeof(int64_t));
+            break;
+    }
 
-    // We assume choice predictor size is always equal to global predictor size.
-    branch_predictor->history_register_mask = choicePredictorSize - 1;
-    #endif
+    Arena arena;
+    if (!initArena(&arena, arena_size, config->pages))
+    {
+        return NULL;
+    }
+    // Starts zeroed: no tables, empty histories, no statistics
+    Branch_Predictor *branch_predictor = (Branch_Predictor *)arenaAlloc(&arena, sizeof(Branch_Predictor));
+    branch_predictor->type = config->type;
 
-	#ifdef GSHARE
-    assert(checkPowerofTwo(gsharePredictorSize));
-	
-    branch_predictor->gshare_counters = 
-        (Sat_Counter *)malloc(gsharePredictorSize * sizeof(Sat_Counter));
-	
-	int i = 0;
-    for (i; i < gsharePredictorSize; i++)
+    if (config->type == TWO_BIT_LOCAL_PREDICTOR)
     {
-        initSatCounter(&(branch_predictor->gshare_counters[i]), gshareCounterBits);
+        branch_predictor->local_predictor_sets = config->local_predictor_size;
+        branch_predictor->index_mask = branch_predictor->local_predictor_sets - 1;
+
+        // Initialize sat counters
+        initCounterTableInArena(&(branch_predictor->local_counters), &arena,
+                                branch_predictor->local_predictor_sets, config->local_counter_bits);
     }
 
-    branch_predictor->global_history_mask = gsharePredictorSize - 1;
-    
-	branch_predictor->global_history = 0;
-    #endif
+    if (config->type == TOURNAMENT_PREDICTOR)
+    {
+        branch_predictor->local_predictor_size = config->local_predictor_size;
+        branch_predictor->local_history_table_size = config->local_history_table_size;
+        branch_predictor->global_predictor_size = config->global_predictor_size;
+        // We assume choice predictor size is always equal to global predictor size.
+        branch_predictor->choice_predictor_size = config->global_predictor_size;
 
-	#ifdef perceptron
-	
-	assert(checkPowerofTwo(p_size));
-	branch_predictor->p_mask = p_size - 1;
+        // Initialize local counters
+        initCounterTableInArena(&(branch_predictor->local_counters), &arena,
+                                config->local_predictor_size, config->local_counter_bits);
 
-	int i;
-	int j;
+        branch_predictor->local_predictor_mask = config->local_predictor_size - 1;
 
-	for (i = 0;i < n;i++) {
-		branch_predictor->global_history[i] = 0;
-	}
+        // Initialize local history table, all zero
+        branch_predictor->local_history_table =
+            (unsigned *)arenaAlloc(&arena, config->local_history_table_size * sizeof(unsigned));
 
-	for (i = 0;i < p_size; i++) {
-		for (j = 0;j < n;j++) {
-			branch_predictor->P[i][j] = 0;
-		}
-	}
+        branch_predictor->local_history_table_mask = config->local_history_table_size - 1;
+
+        branch_predictor->local_history_bits = config->local_history_bits;
+        branch_predictor->local_history_mask = (1u << config->local_history_bits) - 1;
+
+        // Initialize global counters
+        initCounterTableInArena(&(branch_predictor->global_counters), &arena,
+                                config->global_predictor_size, config->global_counter_bits);
+
+        branch_predictor->global_history_mask = config->global_predictor_size - 1;
+
+        // Initialize choice counters
+        initCounterTableInArena(&(branch_predictor->choice_counters), &arena,
+                                branch_predictor->choice_predictor_size, config->choice_counter_bits);
+
+        branch_predictor->choice_history_mask = branch_predictor->choice_predictor_size - 1;
+        branch_predictor->history_register_mask = branch_predictor->choice_predictor_size - 1;
+    }
 
-	#endif
+    if (config->type == GSHARE_PREDICTOR)
+    {
+        initCounterTableInArena(&(branch_predictor->gshare_counters), &arena,
+                                config->gshare_predictor_size, config->gshare_counter_bits);
+
+        branch_predictor->global_history_mask = config->gshare_predictor_size - 1;
+    }
 
+    if (config->type == PERCEPTRON_PREDICTOR)
+    {
+        branch_predictor->p_size = config->perceptron_size;
+        branch_predictor->p_mask = config->perceptron_size - 1;
+        branch_predictor->n = config->perceptron_history;
+        branch_predictor->theta = config->theta > 0 ? config->theta :
+                                  1.93 * config->perceptron_history + 14;
+
+        // Weights and history start at zero
+        branch_predictor->perceptron_history =
+            (int64_t *)arenaAlloc(&arena, branch_predictor->n * sizeof(int64_t));
+        branch_predictor->P =
+            (int64_t *)arenaAlloc(&arena, (uint64_t)branch_predictor->p_size * branch_predictor->n *
+                                          sizeof(int64_t));
+    }
+
+    branch_predictor->arena = arena;
     return branch_predictor;
 }
 
-// sat counter functions
-inline void initSatCounter(Sat_Counter *sat_counter, unsigned counter_bits)
+void freeBranchPredictor(Branch_Predictor *branch_predictor)
 {
-    sat_counter->counter_bits = counter_bits;
-    sat_counter->counter = 0;
-    sat_counter->max_val = (1 << counter_bits) - 1;
+    // The predictor itself is in the arena
+    Arena arena = branch_predictor->arena;
+    freeArena(&arena);
 }
 
-inline void incrementCounter(Sat_Counter *sat_counter)
+void resetBranchPredictor(Branch_Predictor *branch_predictor)
 {
-    if (sat_counter->counter < sat_counter->max_val)
+    // Every table and history starts at zero
+    State_Region regions[max_state_regions];
+    unsigned num_regions = getPredictorState(branch_predictor, regions);
+    unsigned i;
+    for (i = 0; i < num_regions; i++)
     {
-        ++sat_counter->counter;
+        memset(regions[i].base, 0, regions[i].size);
     }
-}
 
-inline void decrementCounter(Sat_Counter *sat_counter)
-{
-    if (sat_counter->counter > 0) 
-    {
-        --sat_counter->counter;
-    }
+    memset(&(branch_predictor->stats), 0, sizeof(branch_predictor->stats));
 }
 
 // Branch Predictor functions
-bool predict(Branch_Predictor *branch_predictor, Instruction *instr)
-{
-    uint64_t branch_address = instr->PC;
 
-    #ifdef TWO_BIT_LOCAL    
+static inline __attribute__((always_inline))
+bool predictTwoBitLocal(Branch_Predictor *branch_predictor,
+                        uint64_t branch_address, bool taken)
+{
     // Step one, get prediction
-    unsigned local_index = getIndex(branch_address, 
+    unsigned local_index = getIndex(branch_address,
                                     branch_predictor->index_mask);
 
-    bool prediction = getPrediction(&(branch_predictor->local_counters[local_index]));
+    bool prediction = getCounterPrediction(&(branch_predictor->local_counters), local_index);
+    branch_predictor->provider = BIMODAL;
 
     // Step two, update counter
-    if (instr->taken)
-    {
-        // printf("Correct: %u -> ", branch_predictor->local_counters[local_index].counter);
-        incrementCounter(&(branch_predictor->local_counters[local_index]));
-        // printf("%u\n", branch_predictor->local_counters[local_index].counter);
-    }
-    else
-    {
-        // printf("Incorrect: %u -> ", branch_predictor->local_counters[local_index].counter);
-        decrementCounter(&(branch_predictor->local_counters[local_index]));
-        // printf("%u\n", branch_predictor->local_counters[local_index].counter);
-    }
+    updateCounter(&(branch_predictor->local_counters), local_index, taken);
 
-    return prediction == instr->taken;
-    #endif
+    return prediction == taken;
+}
 
-    #ifdef TOURNAMENT
+static inline __attribute__((always_inline))
+bool predictTournament(Branch_Predictor *branch_predictor,
+                       uint64_t branch_address, bool taken)
+{
     // Step one, get local prediction.
     unsigned local_history_table_idx = getIndex(branch_address,
                                            branch_predictor->local_history_table_mask);
-    
-    unsigned local_predictor_idx = 
-        branch_predictor->local_history_table[local_history_table_idx] & 
+
+    // The local pattern history selects the counter. When the history is
+    // shorter than the counter index, the low PC bits fill the upper bits
+    // (with local_history_bits == log2(local_predictor_size) this is Alpha 21264).
+    unsigned local_history = branch_predictor->local_history_table[local_history_table_idx];
+
+    unsigned local_predictor_idx =
+        ((local_history_table_idx << branch_predictor->local_history_bits) | local_history) &
         branch_predictor->local_predictor_mask;
 
-    bool local_prediction = 
-        getPrediction(&(branch_predictor->local_counters[local_predictor_idx]));
+    bool local_prediction =
+        getCounterPrediction(&(branch_predictor->local_counters), local_predictor_idx);
 
     // Step two, get global prediction.
-    unsigned global_predictor_idx = 
+    unsigned global_predictor_idx =
         branch_predictor->global_history & branch_predictor->global_history_mask;
 
-    bool global_prediction = 
-        getPrediction(&(branch_predictor->global_counters[global_predictor_idx]));
+    bool global_prediction =
+        getCounterPrediction(&(branch_predictor->global_counters), global_predictor_idx);
 
     // Step three, get choice prediction.
-    unsigned choice_predictor_idx = 
+    unsigned choice_predictor_idx =
         branch_predictor->global_history & branch_predictor->choice_history_mask;
 
-    bool choice_prediction = 
-        getPrediction(&(branch_predictor->choice_counters[choice_predictor_idx]));
+    bool choice_prediction =
+        getCounterPrediction(&(branch_predictor->choice_counters), choice_predictor_idx);
 
 
     // Step four, final prediction.
-    bool final_prediction;
-    if (choice_prediction)
-    {
-        final_prediction = global_prediction;
-    }
-    else
-    {
-        final_prediction = local_prediction;
-    }
+    bool final_prediction = (choice_prediction & global_prediction) |
+                            (!choice_prediction & local_prediction);
+    branch_predictor->provider = choice_prediction ? GLOBAL : LOCAL;
 
-    bool prediction_correct = final_prediction == instr->taken;
+    bool prediction_correct = final_prediction == taken;
     // Step five, update counters
-    if (local_prediction != global_prediction)
-    {
-        if (local_prediction == instr->taken)
-        {
-            // Should be more favorable towards local predictor.
-            decrementCounter(&(branch_predictor->choice_counters[choice_predictor_idx]));
-        }
-        else if (global_prediction == instr->taken)
-        {
-            // Should be more favorable towards global predictor.
-            incrementCounter(&(branch_predictor->choice_counters[choice_predictor_idx]));
-        }
-    }
+    // Only train the chooser when the two disagree; exactly one of them is
+    // right then, so move towards it (up favors global).
+    updateCounterIf(&(branch_predictor->choice_counters), choice_predictor_idx,
+                    global_prediction == taken, local_prediction != global_prediction);
 
-    if (instr->taken)
-    {
-        incrementCounter(&(branch_predictor->global_counters[global_predictor_idx]));
-        incrementCounter(&(branch_predictor->local_counters[local_predictor_idx]));
-    }
-    else
-    {
-        decrementCounter(&(branch_predictor->global_counters[global_predictor_idx]));
-        decrementCounter(&(branch_predictor->local_counters[local_predictor_idx]));
-    }
+    updateCounter(&(branch_predictor->global_counters), global_predictor_idx, taken);
+    updateCounter(&(branch_predictor->local_counters), local_predictor_idx, taken);
+
+    // Step six, update the local history of this branch
+    branch_predictor->local_history_table[local_history_table_idx] =
+        ((local_history << 1) | taken) & branch_predictor->local_history_mask;
+
+    // Step seven, update global history register
+    branch_predictor->global_history = branch_predictor->global_history << 1 | taken;
 
-    // Step six, update global history register
-    branch_predictor->global_history = branch_predictor->global_history << 1 | instr->taken;
-    // exit(0);
-    //
     return prediction_correct;
-    #endif
+}
 
-	#ifdef GSHARE
+static inline __attribute__((always_inline))
+bool predictGshare(Branch_Predictor *branch_predictor,
+                   uint64_t branch_address, bool taken)
+{
 	unsigned branch_idx = branch_address & branch_predictor->global_history_mask;
 	unsigned gh_idx = branch_predictor->global_history & branch_predictor->global_history_mask;
 	unsigned xor_bit = branch_idx ^ gh_idx;
-	
-	bool xor_prediction = getPrediction(&(branch_predictor->gshare_counters[xor_bit]));
-	bool prediction_correct = xor_prediction == instr->taken;
-	
-	if (instr->taken)
-    {
-        incrementCounter(&(branch_predictor->gshare_counters[xor_bit]));
-    }
-    else
-    {
-        decrementCounter(&(branch_predictor->gshare_counters[xor_bit]));
-    }
+
+	bool xor_prediction = getCounterPrediction(&(branch_predictor->gshare_counters), xor_bit);
+	branch_predictor->provider = GSHARE_TABLE;
+	bool prediction_correct = xor_prediction == taken;
+
+	updateCounter(&(branch_predictor->gshare_counters), xor_bit, taken);
 	// update global history register
-	branch_predictor->global_history = branch_predictor->global_history << 1 | instr->taken;
+	branch_predictor->global_history = branch_predictor->global_history << 1 | taken;
 	return prediction_correct;
-	#endif
+}
 
-	#ifdef perceptron
+static inline __attribute__((always_inline))
+bool predictPerceptron(Branch_Predictor *branch_predictor,
+                       uint64_t branch_address, bool taken)
+{
 	int i;
 	bool res;
 	bool prediction_correct;
@@ -293,9 +388,13 @@ bool predict(Branch_Predictor *branch_predictor, Instruction *instr)
 	unsigned hash;
 	hash = getIndex(branch_address, branch_predictor->p_mask);
 
-	float y = branch_predictor->P[hash][0];
+	int n = branch_predictor->n;
+	int64_t *global_history = branch_predictor->perceptron_history;
+	int64_t *P = &(branch_predictor->P[(uint64_t)hash * n]); // Row of this branch
+
+	float y = P[0];
 	for (i = 0; i < n; i++) {
-		y += branch_predictor->P[hash][i]*branch_predictor->global_history[i];
+		y += P[i]*global_history[i];
 	}
 
 	if (y < 0) {
@@ -305,50 +404,290 @@ bool predict(Branch_Predictor *branch_predictor, Instruction *instr)
 		res = true;
 	}
 
-	if (instr->taken) {
+	if (taken) {
 		sign = 1;
 	}
 	else {
 		sign = -1;
 	}
-	
-	prediction_correct = res == instr->taken;
 
-	if (!prediction_correct || (fabs(y) <= theta)) {
-		branch_predictor->P[hash][0] += sign;
+	prediction_correct = res == taken;
+	branch_predictor->provider = PERCEPTRON_TABLE;
+
+	if (!prediction_correct || (fabs(y) <= branch_predictor->theta)) {
+		P[0] += sign;
 		for (i = 0; i < n; i++) {
-			branch_predictor->P[hash][i] = branch_predictor->P[hash][i] + sign*branch_predictor->global_history[i];
+			P[i] = P[i] + sign*global_history[i];
 		}
 	}
 
-	for (i = n-1; i >= 0; i--) {
-		branch_predictor->global_history[i+1] = branch_predictor->global_history[i];
+	for (i = n-1; i > 0; i--) {
+		global_history[i] = global_history[i-1];
 	}
 
-	if (instr->taken) {
-		branch_predictor->global_history[0] = 1;
+	if (taken) {
+		global_history[0] = 1;
 	}
 	else {
-		branch_predictor->global_history[0] = -1;
+		global_history[0] = -1;
 	}
 
 	return prediction_correct;
-	
-	#endif
 }
 
-inline unsigned getIndex(uint64_t branch_addr, unsigned index_mask)
+// Predict one branch with a predictor of the given type and train on its
+// real direction. Shared by predictBranch() and predictBatch() so both see
+// exactly the same predictor; with a constant type the switch folds away.
+static inline __attribute__((always_inline))
+bool predictTyped(Branch_Predictor *branch_predictor, Predictor_Type type,
+                  uint64_t branch_address, bool taken)
 {
-    return (branch_addr >> instShiftAmt) & index_mask;
+    bool correct = false;
+    switch (type)
+    {
+        case TWO_BIT_LOCAL_PREDICTOR:
+            correct = predictTwoBitLocal(branch_predictor, branch_address, taken);
+            break;
+        case TOURNAMENT_PREDICTOR:
+            correct = predictTournament(branch_predictor, branch_address, taken);
+            break;
+        case GSHARE_PREDICTOR:
+            correct = predictGshare(branch_predictor, branch_address, taken);
+            break;
+        case PERCEPTRON_PREDICTOR:
+            correct = predictPerceptron(branch_predictor, branch_address, taken);
+            break;
+    }
+    return correct;
+}
+
+bool predictBranch(Branch_Predictor *branch_predictor, uint64_t PC, bool taken)
+{
+    bool correct = predictTyped(branch_predictor, branch_predictor->type, PC, taken);
+
+    ++branch_predictor->stats.branches;
+    branch_predictor->stats.mispredictions += !correct;
+    return correct;
+}
+
+bool predict(Branch_Predictor *branch_predictor, Instruction *instr)
+{
+    return predictBranch(branch_predictor, instr->PC, instr->taken);
+}
+
+// Prefetch the counters a future branch will touch. ahead_history is the
+// global history that branch will see, known in advance because the batch
+// carries the real directions.
+static inline __attribute__((always_inline))
+void prefetchBranch(Branch_Predictor *branch_predictor, Predictor_Type type,
+                    uint64_t branch_address, uint64_t ahead_history)
+{
+    if (type == TWO_BIT_LOCAL_PREDICTOR)
+    {
+        prefetchCounter(&(branch_predictor->local_counters),
+                        getIndex(branch_address, branch_predictor->index_mask));
+    }
+
+    if (type == TOURNAMENT_PREDICTOR)
+    {
+        unsigned local_history_table_idx = getIndex(branch_address,
+                                               branch_predictor->local_history_table_mask);
+        // The local history may still change before this branch is reached;
+        // a stale prefetch only costs the hint.
+        unsigned local_predictor_idx =
+            ((local_history_table_idx << branch_predictor->local_history_bits) |
+             branch_predictor->local_history_table[local_history_table_idx]) &
+            branch_predictor->local_predictor_mask;
+
+        prefetchCounter(&(branch_predictor->local_counters), local_predictor_idx);
+        prefetchCounter(&(branch_predictor->global_counters),
+                        ahead_history & branch_predictor->global_history_mask);
+        prefetchCounter(&(branch_predictor->choice_counters),
+                        ahead_history & branch_predictor->choice_history_mask);
+    }
+
+    if (type == GSHARE_PREDICTOR)
+    {
+        prefetchCounter(&(branch_predictor->gshare_counters),
+                        (branch_address ^ ahead_history) & branch_predictor->global_history_mask);
+    }
+
+    if (type == PERCEPTRON_PREDICTOR)
+    {
+        __builtin_prefetch(&(branch_predictor->P[(uint64_t)getIndex(branch_address, branch_predictor->p_mask) *
+                                                 branch_predictor->n]), 1, 3);
+    }
+}
+
+// predictBatch() for one type, inlined once per type
+static inline __attribute__((always_inline))
+uint64_t predictBatchTyped(Branch_Predictor *branch_predictor, Predictor_Type type,
+                           const uint64_t *pcs, const uint8_t *taken, unsigned count,
+                           uint8_t *correct_out, uint8_t *provider_out)
+{
+    uint64_t num_correct = 0;
+
+    // Global history as of branch i + prefetchDistance
+    uint64_t ahead_history = 0;
+    if (type == TOURNAMENT_PREDICTOR || type == GSHARE_PREDICTOR)
+    {
+        ahead_history = branch_predictor->global_history;
+    }
+
+    unsigned i;
+    for (i = 0; i < prefetchDistance && i < count; i++)
+    {
+        ahead_history = ahead_history << 1 | taken[i];
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if (i + prefetchDistance < count)
+        {
+            prefetchBranch(branch_predictor, type, pcs[i + prefetchDistance], ahead_history);
+            ahead_history = ahead_history << 1 | taken[i + prefetchDistance];
+        }
+
+        bool correct = predictTyped(branch_predictor, type, pcs[i], taken[i]);
+
+        correct_out[i] = correct;
+        num_correct += correct;
+
+        if (provider_out != NULL)
+        {
+            provider_out[i] = branch_predictor->provider;
+        }
+    }
+
+    branch_predictor->stats.branches += count;
+    branch_predictor->stats.mispredictions += count - num_correct;
+    return num_correct;
 }
 
-inline bool getPrediction(Sat_Counter *sat_counter)
+uint64_t predictBatch(Branch_Predictor *branch_predictor, const uint64_t *pcs,
+                      const uint8_t *taken, unsigned count, uint8_t *correct_out,
+                      uint8_t *provider_out)
 {
-    uint8_t counter = sat_counter->counter;
-    unsigned counter_bits = sat_counter->counter_bits;
+    switch (branch_predictor->type)
+    {
+        case TWO_BIT_LOCAL_PREDICTOR:
+            return predictBatchTyped(branch_predictor, TWO_BIT_LOCAL_PREDICTOR, pcs, taken, count,
+                                     correct_out, provider_out);
+        case TOURNAMENT_PREDICTOR:
+            return predictBatchTyped(branch_predictor, TOURNAMENT_PREDICTOR, pcs, taken, count,
+                                     correct_out, provider_out);
+        case GSHARE_PREDICTOR:
+            return predictBatchTyped(branch_predictor, GSHARE_PREDICTOR, pcs, taken, count,
+                                     correct_out, provider_out);
+        case PERCEPTRON_PREDICTOR:
+            return predictBatchTyped(branch_predictor, PERCEPTRON_PREDICTOR, pcs, taken, count,
+                                     correct_out, provider_out);
+    }
+    return 0;
+}
+
+void getPredictorStats(const Branch_Predictor *branch_predictor, Predictor_Stats *stats)
+{
+    *stats = branch_predictor->stats;
+}
+
+Predictor_Type getPredictorType(const Branch_Predictor *branch_predictor)
+{
+    return branch_predictor->type;
+}
+
+static const char *predictorNames[num_predictor_types] = {"two_bit_local", "tournament", "gshare",
+                                                          "perceptron"};
+
+const char *predictorName(Predictor_Type type)
+{
+    return predictorNames[type];
+}
 
-    // MSB determins the direction
-    return (counter >> (counter_bits - 1));
+bool parsePredictorType(const char *name, Predictor_Type *type)
+{
+    int i;
+    for (i = 0; i < num_predictor_types; i++)
+    {
+        if (strcmp(name, predictorNames[i]) == 0)
+        {
+            *type = (Predictor_Type)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *componentName(Predictor_Component component)
+{
+    static const char *names[num_components] = {"bimodal", "local", "global", "gshare", "perceptron"};
+
+    return names[component];
+}
+
+// Fill regions with every buffer that makes up the predictor state, in a
+// fixed order. Returns the number of regions.
+unsigned getPredictorState(Branch_Predictor *branch_predictor, State_Region *regions)
+{
+    unsigned num_regions = 0;
+
+    if (branch_predictor->type == TWO_BIT_LOCAL_PREDICTOR)
+    {
+        regions[num_regions].base = branch_predictor->local_counters.words;
+        regions[num_regions++].size =
+            counterTableWords(branch_predictor->local_counters.size,
+                              branch_predictor->local_counters.counter_bits) * sizeof(uint64_t);
+    }
+
+    if (branch_predictor->type == TOURNAMENT_PREDICTOR)
+    {
+        Counter_Table *tables[] = {&(branch_predictor->local_counters),
+                                   &(branch_predictor->global_counters),
+                                   &(branch_predictor->choice_counters)};
+        int i;
+        for (i = 0; i < 3; i++)
+        {
+            regions[num_regions].base = tables[i]->words;
+            regions[num_regions++].size =
+                counterTableWords(tables[i]->size, tables[i]->counter_bits) * sizeof(uint64_t);
+        }
+
+        regions[num_regions].base = branch_predictor->local_history_table;
+        regions[num_regions++].size =
+            branch_predictor->local_history_table_size * sizeof(unsigned);
+
+        regions[num_regions].base = &(branch_predictor->global_history);
+        regions[num_regions++].size = sizeof(branch_predictor->global_history);
+    }
+
+    if (branch_predictor->type == GSHARE_PREDICTOR)
+    {
+        regions[num_regions].base = branch_predictor->gshare_counters.words;
+        regions[num_regions++].size =
+            counterTableWords(branch_predictor->gshare_counters.size,
+                              branch_predictor->gshare_counters.counter_bits) * sizeof(uint64_t);
+
+        regions[num_regions].base = &(branch_predictor->global_history);
+        regions[num_regions++].size = sizeof(branch_predictor->global_history);
+    }
+
+    if (branch_predictor->type == PERCEPTRON_PREDICTOR)
+    {
+        regions[num_regions].base = branch_predictor->P;
+        regions[num_regions++].size =
+            (uint64_t)branch_predictor->p_size * branch_predictor->n * sizeof(int64_t);
+
+        regions[num_regions].base = branch_predictor->perceptron_history;
+        regions[num_regions++].size = branch_predictor->n * sizeof(int64_t);
+    }
+
+    assert(num_regions <= max_state_regions);
+    return num_regions;
+}
+
+inline unsigned getIndex(uint64_t branch_addr, unsigned index_mask)
+{
+    return (branch_addr >> instShiftAmt) & index_mask;
 }
 
 int checkPowerofTwo(unsigned x)
@@ -7,82 +7,91 @@
 #include <stdbool.h>
 #include <math.h>
 
+#include "bpsim.h"
+#include "Counter_Table.h"
 #include "Instruction.h"
 
-#define p_size 131072
-#define n 62
-
-// Predictor type
+// Default predictor type (can also be picked with -DTWO_BIT_LOCAL, -DTOURNAMENT, ...)
+#if !defined(TWO_BIT_LOCAL) && !defined(TOURNAMENT) && !defined(GSHARE) && !defined(perceptron)
 // #define TWO_BIT_LOCAL
 // #define TOURNAMENT
 // #define GSHARE
 #define perceptron
+#endif
 
-// saturating counter
-typedef struct Sat_Counter
-{
-    unsigned counter_bits;
-    uint8_t max_val;
-    uint8_t counter;
-}Sat_Counter;
+// Which part of a predictor made the final prediction
+typedef enum Predictor_Component{BIMODAL, LOCAL, GLOBAL, GSHARE_TABLE, PERCEPTRON_TABLE}Predictor_Component;
 
-typedef struct Branch_Predictor
+#define num_components 5
+
+// Only the tables of the configured type are allocated
+struct Branch_Predictor
 {
-    #ifdef TWO_BIT_LOCAL
+    Predictor_Type type;
+    Predictor_Component provider; // Component behind the latest prediction
+    Predictor_Stats stats;
+
+    // Two-bit local
     unsigned local_predictor_sets; // Number of entries in a local predictor
     unsigned index_mask;
 
-    Sat_Counter *local_counters;
-    #endif
+    // Two-bit local and tournament
+    Counter_Table local_counters;
 
-    #ifdef TOURNAMENT
+    // Tournament
     unsigned local_predictor_size;
     unsigned local_predictor_mask;
-    Sat_Counter *local_counters;
 
     unsigned local_history_table_size;
     unsigned local_history_table_mask;
     unsigned *local_history_table;
+    unsigned local_history_bits; // Length of a per-PC local history
+    unsigned local_history_mask;
 
     unsigned global_predictor_size;
-    unsigned global_history_mask;
-    Sat_Counter *global_counters;
+    Counter_Table global_counters;
 
     unsigned choice_predictor_size;
     unsigned choice_history_mask;
-    Sat_Counter *choice_counters;
+    Counter_Table choice_counters;
 
-    uint64_t global_history;
     unsigned history_register_mask;
-    #endif
 
-	#ifdef GSHARE
+    // Tournament and gshare
     unsigned global_history_mask;
-    Sat_Counter *gshare_counters;
     uint64_t global_history;
-    #endif
 
-	#ifdef perceptron
-	int64_t global_history[n];
-	int64_t P[p_size][n];
-	unsigned p_mask;
-	#endif
+    // Gshare
+    Counter_Table gshare_counters;
 
-}Branch_Predictor;
+    // Perceptron
+    unsigned p_size; // Rows of weights
+    unsigned p_mask;
+    unsigned n; // History length, weights per row
+    float theta;
+    int64_t *perceptron_history; // n entries, +1 taken, -1 not taken
+    int64_t *P; // p_size rows of n weights
 
-// Initialization function
-Branch_Predictor *initBranchPredictor();
+    Arena arena; // Holds the predictor and all its tables
+};
 
-// Counter functions
-void initSatCounter(Sat_Counter *sat_counter, unsigned counter_bits);
-void incrementCounter(Sat_Counter *sat_counter);
-void decrementCounter(Sat_Counter *sat_counter);
+// A contiguous piece of predictor state (see Checkpoint.h)
+typedef struct State_Region
+{
+    void *base;
+    uint64_t size; // In bytes
+}State_Region;
 
-// Branch predictor functions
+#define max_state_regions 8
+
+// Predict one instruction of a trace
 bool predict(Branch_Predictor *branch_predictor, Instruction *instr);
 
 unsigned getIndex(uint64_t branch_addr, unsigned index_mask);
-bool getPrediction(Sat_Counter *sat_counter);
+
+// State access (checkpointing, profiling)
+const char *componentName(Predictor_Component component);
+unsigned getPredictorState(Branch_Predictor *branch_predictor, State_Region *regions);
 
 // Utility
 int checkPowerofTwo(unsigned x);
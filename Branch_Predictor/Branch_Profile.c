@@ -0,0 +1,258 @@
+#include "Branch_Profile.h"
+
+#define initial_profile_slots 4096
+
+// An empty direct-mapped table. No branch finds its slot there by its PC:
+// only PC 0 hashes to slot 0, which holds PC 1.
+static Branch_Tally *allocTallies(uint64_t slots)
+{
+    Branch_Tally *tallies = (Branch_Tally *)calloc(slots, sizeof(Branch_Tally));
+    tallies[0].PC = 1;
+    return tallies;
+}
+
+Branch_Profile *initBranchProfile()
+{
+    Branch_Profile *profile = (Branch_Profile *)malloc(sizeof(Branch_Profile));
+
+    profile->entries = (Branch_Stats *)calloc(initial_profile_slots, sizeof(Branch_Stats));
+    profile->mask = initial_profile_slots - 1;
+    profile->num_entries = 0;
+
+    profile->tallies = allocTallies(initial_profile_slots);
+    profile->tally_mask = initial_profile_slots - 1;
+
+    return profile;
+}
+
+void freeBranchProfile(Branch_Profile *profile)
+{
+    free(profile->entries);
+    free(profile->tallies);
+    free(profile);
+}
+
+// Double the number of slots and re-insert every entry
+void growBranchProfile(Branch_Profile *profile)
+{
+    Branch_Stats *old_entries = profile->entries;
+    uint64_t old_slots = profile->mask + 1;
+
+    profile->mask = old_slots * 2 - 1;
+    profile->entries = (Branch_Stats *)calloc(old_slots * 2, sizeof(Branch_Stats));
+
+    uint64_t i;
+    for (i = 0; i < old_slots; i++)
+    {
+        if (old_entries[i].executions == 0)
+        {
+            continue;
+        }
+
+        uint64_t slot = hashBranch(old_entries[i].PC);
+        while (profile->entries[slot & profile->mask].executions != 0)
+        {
+            ++slot;
+        }
+        profile->entries[slot & profile->mask] = old_entries[i];
+    }
+
+    free(old_entries);
+
+    // The direct-mapped table too. Every branch there also has an entry, so
+    // the slots with nothing counted are left out.
+    Branch_Tally *old_tallies = profile->tallies;
+    uint64_t old_tally_slots = profile->tally_mask + 1;
+
+    profile->tally_mask = old_tally_slots * 2 - 1;
+    profile->tallies = allocTallies(old_tally_slots * 2);
+
+    for (i = 0; i < old_tally_slots; i++)
+    {
+        if (old_tallies[i].bytes != 0)
+        {
+            profile->tallies[hashBranch(old_tallies[i].PC) & profile->tally_mask] = old_tallies[i];
+        }
+    }
+
+    free(old_tallies);
+}
+
+// The entry of PC, added if it has none
+static Branch_Stats *findBranch(Branch_Profile *profile, uint64_t PC)
+{
+    uint64_t slot = hashBranch(PC);
+    Branch_Stats *entry;
+    for (;;)
+    {
+        entry = &profile->entries[slot & profile->mask];
+        if (entry->PC == PC && entry->executions != 0)
+        {
+            return entry;
+        }
+        if (entry->executions == 0)
+        {
+            break;
+        }
+        ++slot;
+    }
+
+    // Keep the load factor under 1/2
+    if ((profile->num_entries + 1) * 2 > profile->mask + 1)
+    {
+        growBranchProfile(profile);
+        return findBranch(profile, PC);
+    }
+    entry->PC = PC;
+    ++profile->num_entries;
+    return entry;
+}
+
+static void addBytes(Branch_Stats *entry, uint64_t bytes)
+{
+    entry->executions += (uint8_t)bytes;
+    entry->mispredictions += (uint8_t)(bytes >> 8);
+    entry->taken += (uint8_t)(bytes >> 16);
+    int c;
+    for (c = 0; c < num_components; c++)
+    {
+        entry->provided[c] += (uint8_t)(bytes >> (24 + 8 * c));
+    }
+}
+
+void addBranchTally(Branch_Profile *profile, Branch_Tally *tally)
+{
+    // The branch has an entry, the tables do not grow
+    addBytes(findBranch(profile, tally->PC), tally->bytes);
+    tally->bytes = 0;
+}
+
+void recordBranchSlow(Branch_Profile *profile, uint64_t PC, uint64_t bytes)
+{
+    // Executed once, a branch has an entry with executions != 0
+    addBytes(findBranch(profile, PC), bytes);
+
+    // Its next executions go to its slot, unless another branch has a tally there
+    Branch_Tally *tally = &profile->tallies[hashBranch(PC) & profile->tally_mask];
+    if (tally->bytes == 0)
+    {
+        tally->PC = PC;
+    }
+}
+
+// The reports read the entries alone
+static void addAllBranchTallies(Branch_Profile *profile)
+{
+    uint64_t i;
+    for (i = 0; i <= profile->tally_mask; i++)
+    {
+        if (profile->tallies[i].bytes != 0)
+        {
+            addBranchTally(profile, &profile->tallies[i]);
+        }
+    }
+}
+
+static int compareMispredictions(const void *a, const void *b)
+{
+    const Branch_Stats *x = *(const Branch_Stats **)a;
+    const Branch_Stats *y = *(const Branch_Stats **)b;
+
+    if (x->mispredictions != y->mispredictions)
+    {
+        return x->mispredictions < y->mispredictions ? 1 : -1;
+    }
+    return x->PC < y->PC ? -1 : x->PC > y->PC;
+}
+
+// Component that made most of the predictions of a branch
+static Predictor_Component mainProvider(const Branch_Stats *entry)
+{
+    int c, best = 0;
+    for (c = 1; c < num_components; c++)
+    {
+        if (entry->provided[c] > entry->provided[best])
+        {
+            best = c;
+        }
+    }
+    return (Predictor_Component)best;
+}
+
+void printHotBranches(Branch_Profile *profile, unsigned top_n)
+{
+    addAllBranchTallies(profile);
+
+    Branch_Stats **sorted = (Branch_Stats **)malloc(profile->num_entries * sizeof(Branch_Stats *));
+    uint64_t total_mispredictions = 0;
+    uint64_t i, j = 0;
+    for (i = 0; i <= profile->mask; i++)
+    {
+        if (profile->entries[i].executions != 0)
+        {
+            sorted[j++] = &profile->entries[i];
+            total_mispredictions += profile->entries[i].mispredictions;
+        }
+    }
+    qsort(sorted, profile->num_entries, sizeof(Branch_Stats *), compareMispredictions);
+
+    printf("Static branches: %"PRIu64"\n", profile->num_entries);
+    printf("%-18s %12s %12s %9s %8s %8s %8s %s\n", "PC", "executions", "mispredicts",
+           "miss rate", "share", "cumul.", "taken", "provider");
+
+    double cumulative = 0;
+    for (i = 0; i < top_n && i < profile->num_entries; i++)
+    {
+        Branch_Stats *entry = sorted[i];
+        double share = total_mispredictions ?
+            100.0 * entry->mispredictions / total_mispredictions : 0;
+        cumulative += share;
+
+        printf("%-18"PRIu64" %12"PRIu64" %12"PRIu64" %8.3f%% %7.3f%% %7.3f%% %7.3f%% %s\n",
+               entry->PC, entry->executions, entry->mispredictions,
+               100.0 * entry->mispredictions / entry->executions, share, cumulative,
+               100.0 * entry->taken / entry->executions, componentName(mainProvider(entry)));
+    }
+
+    free(sorted);
+}
+
+bool dumpBranchProfile(Branch_Profile *profile, const char *csv_file)
+{
+    addAllBranchTallies(profile);
+
+    FILE *fd = fopen(csv_file, "w");
+    if (fd == NULL)
+    {
+        perror(csv_file);
+        return false;
+    }
+
+    int c;
+    fprintf(fd, "pc,executions,mispredictions,taken_rate");
+    for (c = 0; c < num_components; c++)
+    {
+        fprintf(fd, ",%s", componentName((Predictor_Component)c));
+    }
+    fprintf(fd, "\n");
+
+    uint64_t i;
+    for (i = 0; i <= profile->mask; i++)
+    {
+        Branch_Stats *entry = &profile->entries[i];
+        if (entry->executions == 0)
+        {
+            continue;
+        }
+
+        fprintf(fd, "%"PRIu64",%"PRIu64",%"PRIu64",%f", entry->PC, entry->executions,
+                entry->mispredictions, (double)entry->taken / entry->executions);
+        for (c = 0; c < num_components; c++)
+        {
+            fprintf(fd, ",%"PRIu64, entry->provided[c]);
+        }
+        fprintf(fd, "\n");
+    }
+
+    return fclose(fd) == 0;
+}
@@ -0,0 +1,83 @@
+#ifndef __BRANCH_PROFILE_HH__
+#define __BRANCH_PROFILE_HH__
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Branch_Predictor.h"
+
+// Per static branch statistics, kept in an open-addressing (linear
+// probing) hash table keyed by PC. A slot with zero executions is empty.
+typedef struct Branch_Stats
+{
+    uint64_t PC;
+
+    uint64_t executions;
+    uint64_t mispredictions;
+    uint64_t taken;
+
+    uint64_t provided[num_components]; // Predictions made by each component
+}Branch_Stats;
+
+// The latest executions of the branch at PC, one byte per counter of
+// Branch_Stats so that they take a single add. They are added to its
+// Branch_Stats before the executions byte wraps around.
+typedef struct Branch_Tally
+{
+    uint64_t PC;
+    uint64_t bytes; // executions, mispredictions, taken, provided[num_components]
+}Branch_Tally;
+
+// In front of the hash table, a direct-mapped table of tallies with as
+// many slots, indexed by the same hash. A slot with nothing counted goes to
+// the next branch that finds it; a branch finding its slot in use by
+// another one is accounted in the hash table directly.
+typedef struct Branch_Profile
+{
+    Branch_Stats *entries;
+    uint64_t mask; // Number of slots - 1
+    uint64_t num_entries;
+
+    Branch_Tally *tallies;
+    uint64_t tally_mask;
+}Branch_Profile;
+
+Branch_Profile *initBranchProfile();
+void freeBranchProfile(Branch_Profile *profile);
+void growBranchProfile(Branch_Profile *profile);
+// Off the direct-mapped path
+void addBranchTally(Branch_Profile *profile, Branch_Tally *tally);
+void recordBranchSlow(Branch_Profile *profile, uint64_t PC, uint64_t bytes);
+
+// Reports
+void printHotBranches(Branch_Profile *profile, unsigned top_n);
+bool dumpBranchProfile(Branch_Profile *profile, const char *csv_file);
+
+static inline uint64_t hashBranch(uint64_t PC)
+{
+    return (PC * 0x9E3779B97F4A7C15ull) >> 32;
+}
+
+// Account one executed branch. Inline, it sits in the simulation loop.
+static inline void recordBranch(Branch_Profile *profile, uint64_t PC, bool taken,
+                                bool correct, Predictor_Component provider)
+{
+    uint64_t bytes = 1 | (uint64_t)!correct << 8 | (uint64_t)taken << 16 |
+                     1ull << (24 + 8 * provider);
+
+    Branch_Tally *tally = &profile->tallies[hashBranch(PC) & profile->tally_mask];
+    if (tally->PC != PC)
+    {
+        recordBranchSlow(profile, PC, bytes);
+        return;
+    }
+    tally->bytes += bytes;
+    if ((uint8_t)tally->bytes == UINT8_MAX)
+    {
+        addBranchTally(profile, tally);
+    }
+}
+
+#endif
@@ -0,0 +1,206 @@
+#include "Checkpoint.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char snapshotMagic[8] = "BPSNAP";
+
+// The run a snapshot belongs to, in header: the configuration, the trace
+// and the warmup
+static bool describeRun(Snapshot_Header *header, const Branch_Predictor_Config *config,
+                        const char *trace_file, uint64_t warmup_instructions)
+{
+    header->config = *config;
+    header->config.pages = SMALL_PAGES; // The backing does not change the state
+    header->warmup_instructions = warmup_instructions;
+
+    struct stat st;
+    char *path = realpath(trace_file, NULL);
+    bool ok = path != NULL && strlen(path) < snapshot_path_bytes && stat(path, &st) == 0;
+    if (ok)
+    {
+        strcpy(header->trace, path);
+        header->trace_size = st.st_size;
+        header->trace_mtime = st.st_mtim.tv_sec;
+        header->trace_mtime_ns = st.st_mtim.tv_nsec;
+    }
+    else
+    {
+        fprintf(stderr, "%s: cannot tell the trace of a snapshot\n", trace_file);
+    }
+    free(path);
+    return ok;
+}
+
+// Every setting that shapes the predictor state
+static bool sameConfig(const Branch_Predictor_Config *a, const Branch_Predictor_Config *b)
+{
+    return a->type == b->type &&
+           a->local_predictor_size == b->local_predictor_size &&
+           a->local_counter_bits == b->local_counter_bits &&
+           a->local_history_bits == b->local_history_bits &&
+           a->local_history_table_size == b->local_history_table_size &&
+           a->global_predictor_size == b->global_predictor_size &&
+           a->global_counter_bits == b->global_counter_bits &&
+           a->choice_counter_bits == b->choice_counter_bits &&
+           a->gshare_predictor_size == b->gshare_predictor_size &&
+           a->gshare_counter_bits == b->gshare_counter_bits &&
+           a->perceptron_size == b->perceptron_size &&
+           a->perceptron_history == b->perceptron_history &&
+           a->theta == b->theta;
+}
+
+bool saveCheckpoint(Branch_Predictor *branch_predictor, const Branch_Predictor_Config *config,
+                    const char *trace_file, const Trace_Position *position,
+                    const char *snapshot_file, uint64_t warmup_instructions)
+{
+    State_Region regions[max_state_regions];
+    unsigned num_regions = getPredictorState(branch_predictor, regions);
+
+    Snapshot_Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, snapshotMagic, sizeof(snapshotMagic));
+    header.version = snapshot_version;
+    header.num_regions = num_regions;
+    if (!describeRun(&header, config, trace_file, warmup_instructions))
+    {
+        return false;
+    }
+    header.position = *position;
+
+    // Lay the regions out one after another, each on a page boundary
+    uint64_t offset = snapshot_align;
+    unsigned i;
+    for (i = 0; i < num_regions; i++)
+    {
+        header.offset[i] = offset;
+        header.size[i] = regions[i].size;
+
+        offset += (regions[i].size + snapshot_align - 1) / snapshot_align * snapshot_align;
+    }
+
+    // Write to a temporary file first so a reader never sees half a snapshot
+    size_t tmp_len = strlen(snapshot_file) + 5;
+    char *tmp_file = (char *)malloc(tmp_len);
+    snprintf(tmp_file, tmp_len, "%s.tmp", snapshot_file);
+
+    int fd = open(tmp_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        perror(tmp_file);
+        free(tmp_file);
+        return false;
+    }
+
+    bool ok = pwrite(fd, &header, sizeof(header), 0) == sizeof(header);
+    for (i = 0; ok && i < num_regions; i++)
+    {
+        ok = pwrite(fd, regions[i].base, regions[i].size, header.offset[i]) ==
+             (ssize_t)regions[i].size;
+    }
+    ok = ok && ftruncate(fd, offset) == 0;
+    ok = (close(fd) == 0) && ok;
+    ok = ok && rename(tmp_file, snapshot_file) == 0;
+
+    if (!ok)
+    {
+        perror(snapshot_file);
+        unlink(tmp_file);
+    }
+
+    free(tmp_file);
+    return ok;
+}
+
+Snapshot_Status loadCheckpoint(Branch_Predictor *branch_predictor,
+                               const Branch_Predictor_Config *config, TraceParser *cpu_trace,
+                               const char *trace_file, const char *snapshot_file,
+                               uint64_t warmup_instructions)
+{
+    int fd = open(snapshot_file, O_RDONLY);
+    if (fd < 0)
+    {
+        return SNAPSHOT_MISSING;
+    }
+
+    struct stat st;
+    void *base = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (uint64_t)st.st_size >= sizeof(Snapshot_Header))
+    {
+        base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (base == MAP_FAILED)
+    {
+        fprintf(stderr, "%s: not a snapshot\n", snapshot_file);
+        return SNAPSHOT_MISMATCH;
+    }
+
+    const Snapshot_Header *header = (const Snapshot_Header *)base;
+
+    State_Region regions[max_state_regions];
+    unsigned num_regions = getPredictorState(branch_predictor, regions);
+
+    Snapshot_Header run;
+    memset(&run, 0, sizeof(run));
+    const char *mismatch = NULL;
+    if (memcmp(header->magic, snapshotMagic, sizeof(snapshotMagic)) != 0 ||
+        header->version != snapshot_version)
+    {
+        mismatch = "not a snapshot of this version";
+    }
+    else if (!describeRun(&run, config, trace_file, warmup_instructions))
+    {
+        mismatch = "the trace cannot be checked";
+    }
+    else if (!sameConfig(&header->config, &run.config))
+    {
+        mismatch = "taken with another predictor configuration";
+    }
+    else if (strncmp(header->trace, run.trace, snapshot_path_bytes) != 0 ||
+             header->trace_size != run.trace_size || header->trace_mtime != run.trace_mtime ||
+             header->trace_mtime_ns != run.trace_mtime_ns)
+    {
+        mismatch = "taken on another trace, or on this one before it changed";
+    }
+    else if (header->warmup_instructions != warmup_instructions)
+    {
+        mismatch = "taken after another number of warmup instructions";
+    }
+
+    unsigned i;
+    for (i = 0; mismatch == NULL && i < num_regions; i++)
+    {
+        if (header->num_regions != num_regions || header->size[i] != regions[i].size ||
+            header->offset[i] + header->size[i] > (uint64_t)st.st_size)
+        {
+            mismatch = "its state does not fit the predictor";
+        }
+    }
+
+    // Past the warmup, the last check
+    Trace_Position start;
+    tellTrace(cpu_trace, &start);
+    if (mismatch == NULL && !seekTrace(cpu_trace, &header->position))
+    {
+        mismatch = "its warmup does not end at a record of the trace";
+        seekTrace(cpu_trace, &start);
+    }
+
+    if (mismatch == NULL)
+    {
+        for (i = 0; i < num_regions; i++)
+        {
+            memcpy(regions[i].base, (const char *)base + header->offset[i], regions[i].size);
+        }
+    }
+    else
+    {
+        fprintf(stderr, "%s: %s\n", snapshot_file, mismatch);
+    }
+
+    munmap(base, st.st_size);
+    return mismatch == NULL ? SNAPSHOT_RESTORED : SNAPSHOT_MISMATCH;
+}
@@ -0,0 +1,61 @@
+#ifndef __CHECKPOINT_HH__
+#define __CHECKPOINT_HH__
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Branch_Predictor.h"
+#include "Trace.h"
+
+#define snapshot_version 3
+#define snapshot_align 4096 // Regions start on a page so they can be mmap()ed in place
+#define snapshot_path_bytes 1024
+
+// Snapshot file layout: this header, then every State_Region of the
+// predictor at its own page-aligned offset. Values are in host byte order.
+//
+// A snapshot is only restored into the run it was taken for: the same
+// predictor configuration, warmed up on as many instructions of the same
+// trace, known by its absolute path, size and modification time. It also
+// keeps where the warmup ends in the trace, so that a restored run seeks
+// there instead of reading the warmup again.
+typedef struct Snapshot_Header
+{
+    char magic[8]; // "BPSNAP"
+    uint32_t version;
+    uint32_t num_regions;
+
+    Branch_Predictor_Config config; // Of the predictor that wrote it; pages is not kept
+
+    char trace[snapshot_path_bytes];
+    uint64_t trace_size;
+    int64_t trace_mtime; // Seconds
+    int64_t trace_mtime_ns;
+    uint64_t warmup_instructions; // Instructions replayed before the snapshot
+    Trace_Position position; // Right after them
+
+    uint64_t offset[max_state_regions];
+    uint64_t size[max_state_regions];
+}Snapshot_Header;
+
+typedef enum Snapshot_Status{SNAPSHOT_RESTORED, SNAPSHOT_MISSING, SNAPSHOT_MISMATCH}Snapshot_Status;
+
+// Write the state of the predictor built from config, taken after
+// warmup_instructions instructions of trace_file, read up to position.
+bool saveCheckpoint(Branch_Predictor *branch_predictor, const Branch_Predictor_Config *config,
+                    const char *trace_file, const Trace_Position *position,
+                    const char *snapshot_file, uint64_t warmup_instructions);
+
+// Restore the state saved by the same run, and take cpu_trace, opened on
+// trace_file, past the warmup. The predictor is left untouched if there is
+// no snapshot, or if it is not one of this run (printing why): another
+// configuration, trace or warmup, a position the trace does not have, or
+// not a snapshot at all. cpu_trace is then back at its start if it moved.
+Snapshot_Status loadCheckpoint(Branch_Predictor *branch_predictor,
+                               const Branch_Predictor_Config *config, TraceParser *cpu_trace,
+                               const char *trace_file, const char *snapshot_file,
+                               uint64_t warmup_instructions);
+
+#endif
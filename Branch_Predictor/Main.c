@@ -1,26 +1,240 @@
 #include "Trace.h"
 #include "Branch_Predictor.h"
+#include "Branch_Profile.h"
+#include "Checkpoint.h"
+#include "Sampling.h"
+#include "Time_Series.h"
 
 extern TraceParser *initTraceParser(const char * trace_file);
+extern TraceParser *openTraceParser(const char * trace_file, unsigned decode_threads);
 extern bool getInstruction(TraceParser *cpu_trace);
+extern void closeTraceParser(TraceParser *cpu_trace);
 
-extern Branch_Predictor *initBranchPredictor();
+extern Branch_Predictor *initBranchPredictor(const Branch_Predictor_Config *config);
 extern bool predict(Branch_Predictor *branch_predictor, Instruction *instr);
+extern uint64_t predictBatch(Branch_Predictor *branch_predictor, const uint64_t *pcs,
+                             const uint8_t *taken, unsigned count, uint8_t *correct_out,
+                             uint8_t *provider_out);
+
+#define batch_size 4096 // Branches handed to predictBatch() at once
+
+// Branches waiting to be predicted
+typedef struct Branch_Batch
+{
+    uint64_t pcs[batch_size];
+    uint8_t taken[batch_size];
+    uint8_t correct[batch_size];
+    uint8_t provider[batch_size];
+    unsigned count;
+}Branch_Batch;
+
+// Predict every buffered branch, returns the number of correct predictions.
+// With a profile, the outcome of every branch is also recorded there.
+static uint64_t flushBatch(Branch_Predictor *branch_predictor, Branch_Batch *batch,
+                           Branch_Profile *profile)
+{
+    uint64_t num_correct = predictBatch(branch_predictor, batch->pcs, batch->taken,
+                                        batch->count, batch->correct,
+                                        profile != NULL ? batch->provider : NULL);
+    if (profile != NULL)
+    {
+        unsigned i;
+        for (i = 0; i < batch->count; i++)
+        {
+            recordBranch(profile, batch->pcs[i], batch->taken[i], batch->correct[i],
+                         (Predictor_Component)batch->provider[i]);
+        }
+    }
+    batch->count = 0;
+
+    return num_correct;
+}
+
+// Buffer a branch, returns the number of correct predictions if the batch filled up
+static uint64_t addBranch(Branch_Predictor *branch_predictor, Branch_Batch *batch,
+                          Instruction *instr, Branch_Profile *profile)
+{
+    batch->pcs[batch->count] = instr->PC;
+    batch->taken[batch->count] = instr->taken;
+    ++batch->count;
+
+    return batch->count == batch_size ? flushBatch(branch_predictor, batch, profile) : 0;
+}
+
+// Measured counters, also kept at the start of each sampled interval and
+// time series row
+typedef struct Branch_Counts
+{
+    uint64_t instructions;
+    uint64_t branches;
+    uint64_t correct;
+}Branch_Counts;
+
+// Turn a finished measured interval into a sample
+static void addIntervalSample(Sampler *sampler, uint64_t interval, const Branch_Counts *now,
+                              const Branch_Counts *start)
+{
+    uint64_t instructions = now->instructions - start->instructions;
+    uint64_t branches = now->branches - start->branches;
+    uint64_t correct = now->correct - start->correct;
+    if (sampler->config.mode == SAMPLE_NONE || instructions == 0)
+    {
+        return;
+    }
+
+    double metrics[2];
+    metrics[0] = 1000.0 * (branches - correct) / instructions; // MPKI
+    metrics[1] = branches ? 100.0 * correct / branches : 100.0; // Correctness
+
+    addSample(sampler, interval, metrics);
+}
+
+const char *seriesColumns[] = {"record", "instructions", "branches", "mispredictions",
+                               "mpki", "correctness"};
+
+// Write the row of the interval ending at record, then start the next one
+static void addBranchRow(Time_Series *series, uint64_t record, const Branch_Counts *now,
+                         Branch_Counts *start)
+{
+    double instructions = now->instructions - start->instructions;
+    double branches = now->branches - start->branches;
+    double mispredictions = branches - (now->correct - start->correct);
+    if (instructions > 0)
+    {
+        double row[6] = {record, instructions, branches, mispredictions,
+                         1000.0 * mispredictions / instructions,
+                         branches ? 100.0 * (branches - mispredictions) / branches : 100.0};
+        addSeriesRow(series, row);
+    }
+    *start = *now;
+}
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s [--warmup N] [--snapshot <file>] [--measure M] %s\n", prog, "<trace-file>");
+    printf("  --warmup N         train on the first N instructions without counting them\n");
+    printf("  --snapshot <file>  restore the warmed predictor from <file> if it holds a\n");
+    printf("                     snapshot of this predictor, trace and warmup, else save\n");
+    printf("                     one there if there is none\n");
+    printf("  --snapshot-overwrite  replace a snapshot <file> of another run\n");
+    printf("  --measure M        stop after measuring M instructions\n");
+    printf("  --profile-top N    report the N static branches with most mispredictions\n");
+    printf("  --profile-csv <file>  dump per-branch statistics as CSV\n");
+    printPredictorUsage();
+    printSamplingUsage();
+    printSeriesUsage();
+    printDecodeUsage();
+}
 
 int main(int argc, const char *argv[])
-{	
-    if (argc != 2)
+{
+    const char *trace_file = NULL;
+    const char *snapshot_file = NULL;
+    bool snapshot_overwrite = false;
+    uint64_t warmup = 0;
+    uint64_t measure = 0; // 0 means up to the end of the trace
+    unsigned profile_top = 0;
+    const char *profile_csv = NULL;
+    unsigned decode_threads = 0;
+
+    Branch_Predictor_Config predictor_config;
+    initPredictorConfig(&predictor_config);
+    Sampling_Config sampling;
+    initSamplingConfig(&sampling);
+    Series_Config series_config;
+    initSeriesConfig(&series_config);
+
+    int arg;
+    for (arg = 1; arg < argc; arg++)
     {
-        printf("Usage: %s %s\n", argv[0], "<trace-file>");
+        if (strcmp(argv[arg], "--warmup") == 0 && arg + 1 < argc)
+        {
+            warmup = strtoull(argv[++arg], NULL, 10);
+        }
+        else if (strcmp(argv[arg], "--snapshot") == 0 && arg + 1 < argc)
+        {
+            snapshot_file = argv[++arg];
+        }
+        else if (strcmp(argv[arg], "--snapshot-overwrite") == 0)
+        {
+            snapshot_overwrite = true;
+        }
+        else if (strcmp(argv[arg], "--measure") == 0 && arg + 1 < argc)
+        {
+            measure = strtoull(argv[++arg], NULL, 10);
+        }
+        else if (strcmp(argv[arg], "--profile-top") == 0 && arg + 1 < argc)
+        {
+            profile_top = atoi(argv[++arg]);
+        }
+        else if (strcmp(argv[arg], "--profile-csv") == 0 && arg + 1 < argc)
+        {
+            profile_csv = argv[++arg];
+        }
+        else if (parsePredictorOption(&predictor_config, argc, argv, &arg))
+        {
+        }
+        else if (parseSamplingOption(&sampling, argc, argv, &arg))
+        {
+        }
+        else if (parseSeriesOption(&series_config, argc, argv, &arg))
+        {
+        }
+        else if (parseDecodeOption(&decode_threads, argc, argv, &arg))
+        {
+        }
+        else if (argv[arg][0] != '-' && trace_file == NULL)
+        {
+            trace_file = argv[arg];
+        }
+        else
+        {
+            trace_file = NULL;
+            break;
+        }
+    }
+
+    if (trace_file == NULL)
+    {
+        usage(argv[0]);
 
         return 0;
     }
 
+    uint64_t end = measure > 0 ? warmup + measure : UINT64_MAX;
+
+    // Per-interval metrics: MPKI and correctness
+    Sampler *sampler = initSampler(&sampling, 2);
+    if (sampling.mode == SAMPLE_SIMPOINT)
+    {
+        // Profiling pass to find the phases of the measured part
+        TraceParser *profile_trace = openTraceParser(trace_file, decode_threads);
+        if (profile_trace == NULL)
+        {
+            return 1;
+        }
+        uint64_t record = 0;
+        while (record < end && getInstruction(profile_trace))
+        {
+            if (record >= warmup)
+            {
+                profileRecord(sampler, profile_trace->cur_instr->PC);
+            }
+            ++record;
+        }
+        closeTraceParser(profile_trace);
+        finishProfile(sampler);
+    }
+
     // Initialize a CPU trace parser
-    TraceParser *cpu_trace = initTraceParser(argv[1]);
+    TraceParser *cpu_trace = openTraceParser(trace_file, decode_threads);
 
     // Initialize a branch predictor
-    Branch_Predictor *branch_predictor = initBranchPredictor();
+    Branch_Predictor *branch_predictor = initBranchPredictor(&predictor_config);
+    if (cpu_trace == NULL || branch_predictor == NULL)
+    {
+        return 1;
+    }
 
     // Running the trace
     uint64_t num_of_instructions = 0;
@@ -28,30 +242,181 @@ int main(int argc, const char *argv[])
     uint64_t num_of_correct_predictions = 0;
     uint64_t num_of_incorrect_predictions = 0;
 
-    while (getInstruction(cpu_trace))
+    // Warmup, either restored from a snapshot or replayed. A snapshot of
+    // another run is only replaced when asked to.
+    Snapshot_Status snapshot = SNAPSHOT_MISSING;
+    if (warmup > 0 && snapshot_file != NULL)
+    {
+        snapshot = loadCheckpoint(branch_predictor, &predictor_config, cpu_trace, trace_file,
+                                  snapshot_file, warmup);
+    }
+    if (snapshot == SNAPSHOT_MISMATCH && !snapshot_overwrite)
+    {
+        fprintf(stderr, "Give --snapshot-overwrite to replace %s\n", snapshot_file);
+        return 1;
+    }
+    bool restored = snapshot == SNAPSHOT_RESTORED;
+    if (restored)
+    {
+        // The trace is already past the warmup
+        num_of_instructions = warmup;
+    }
+
+    // Per static branch statistics of the measured branches
+    Branch_Profile *profile = NULL;
+    if (profile_top > 0 || profile_csv != NULL)
+    {
+        profile = initBranchProfile();
+    }
+
+    // Branches are buffered and predicted in batches
+    Branch_Batch batch;
+    batch.count = 0;
+
+    bool more = true;
+    while (num_of_instructions < warmup && (more = getInstruction(cpu_trace)))
     {
-        // We are only interested in BRANCH instruction
         if (cpu_trace->cur_instr->instr_type == BRANCH)
         {
-            ++num_of_branches;
+            addBranch(branch_predictor, &batch, cpu_trace->cur_instr, NULL);
+        }
+        ++num_of_instructions;
+    }
 
-            if (predict(branch_predictor, cpu_trace->cur_instr))
+    if (!restored)
+    {
+        flushBatch(branch_predictor, &batch, NULL);
+
+        if (warmup > 0 && snapshot_file != NULL && num_of_instructions == warmup)
+        {
+            Trace_Position position;
+            tellTrace(cpu_trace, &position);
+            saveCheckpoint(branch_predictor, &predictor_config, trace_file, &position,
+                           snapshot_file, warmup);
+        }
+    }
+
+    // The measured part, possibly sampled. A batch never spans two actions
+    // or two time series rows.
+    Sample_Action action = SAMPLE_MEASURE;
+    Branch_Profile *measured_profile = profile; // Only measured branches are profiled
+    uint64_t until = 0;
+    Branch_Counts measured = {0, 0, 0};
+    Branch_Counts sample_start = measured;
+
+    Time_Series *series = openTimeSeries(&series_config, 6, seriesColumns);
+    uint64_t series_until = series != NULL ? series_config.interval : UINT64_MAX;
+    Branch_Counts series_start = measured;
+
+    while (more && num_of_instructions < end && getInstruction(cpu_trace))
+    {
+        uint64_t record = num_of_instructions - warmup;
+        if (record == until || record == series_until)
+        {
+            uint64_t num_correct = flushBatch(branch_predictor, &batch, measured_profile);
+            if (action == SAMPLE_MEASURE)
+            {
+                measured.correct += num_correct;
+            }
+
+            if (record == series_until)
             {
-                ++num_of_correct_predictions;
+                addBranchRow(series, record, &measured, &series_start);
+                series_until += series_config.interval;
             }
-            else
+
+            if (record == until)
             {
-                ++num_of_incorrect_predictions;
+                if (action == SAMPLE_MEASURE)
+                {
+                    addIntervalSample(sampler, (record - 1) / sampling.interval,
+                                      &measured, &sample_start);
+                }
+                sample_start = measured;
+
+                action = sampleAction(sampler, record, &until);
+                measured_profile = action == SAMPLE_MEASURE ? profile : NULL;
             }
         }
+
+        if (action == SAMPLE_SKIP)
+        {
+            ++num_of_instructions;
+            continue;
+        }
+
+        // We are only interested in BRANCH instruction
+        if (cpu_trace->cur_instr->instr_type == BRANCH)
+        {
+            uint64_t num_correct = addBranch(branch_predictor, &batch, cpu_trace->cur_instr,
+                                             measured_profile);
+            if (action == SAMPLE_MEASURE)
+            {
+                ++measured.branches;
+                measured.correct += num_correct;
+            }
+        }
+        measured.instructions += action == SAMPLE_MEASURE;
         ++num_of_instructions;
     }
 
+    uint64_t num_correct = flushBatch(branch_predictor, &batch, measured_profile);
+    if (action == SAMPLE_MEASURE)
+    {
+        measured.correct += num_correct;
+        addIntervalSample(sampler, (num_of_instructions - warmup - 1) / sampling.interval,
+                          &measured, &sample_start);
+    }
+
+    if (series != NULL)
+    {
+        addBranchRow(series, num_of_instructions - warmup, &measured, &series_start);
+        if (!closeTimeSeries(series))
+        {
+            fprintf(stderr, "Could not write %s\n", series_config.file);
+        }
+    }
+
+    num_of_branches = measured.branches;
+    num_of_correct_predictions = measured.correct;
+    num_of_incorrect_predictions = num_of_branches - num_of_correct_predictions;
+
 //    printf("Number of instructions: %"PRIu64"\n", num_of_instructions);
 //    printf("Number of branches: %"PRIu64"\n", num_of_branches);
     printf("Number of correct predictions: %"PRIu64"\n", num_of_correct_predictions);
     printf("Number of incorrect predictions: %"PRIu64"\n", num_of_incorrect_predictions);
 
-    float performance = (float)num_of_correct_predictions / (float)num_of_branches * 100;
-    printf("Predictor Correctness: %f%%\n", performance);
+    if (sampling.mode != SAMPLE_NONE)
+    {
+        double mean, half_width;
+        printf("Sampled intervals: %"PRIu64"\n", sampler->num_samples);
+
+        getEstimate(sampler, 0, &mean, &half_width);
+        printf("Estimated MPKI: %f (+/- %f, 95%% CI)\n", mean, half_width);
+
+        getEstimate(sampler, 1, &mean, &half_width);
+        printf("Predictor Correctness: %f%% (+/- %f%%, 95%% CI)\n", mean, half_width);
+    }
+    else
+    {
+        float performance = (float)num_of_correct_predictions / (float)num_of_branches * 100;
+        printf("Predictor Correctness: %f%%\n", performance);
+    }
+
+    if (profile != NULL)
+    {
+        if (profile_top > 0)
+        {
+            printHotBranches(profile, profile_top);
+        }
+        if (profile_csv != NULL)
+        {
+            dumpBranchProfile(profile, profile_csv);
+        }
+        freeBranchProfile(profile);
+    }
+
+    closeTraceParser(cpu_trace);
+    freeBranchPredictor(branch_predictor);
+    freeSampler(sampler);
 }
@@ -1,82 +1,286 @@
 #include "Trace.h"
 
+#include <sys/stat.h>
+
 TraceParser *initTraceParser(const char * trace_file)
 {
+    return openTraceParser(trace_file, 0);
+}
+
+// Decode on threads of their own from where fd or chunked stands, if asked to
+static void startDecoding(TraceParser *trace_parser)
+{
+    // Text traces decode to the records of a CPU stream
+    trace_parser->pipeline = NULL;
+    if (trace_parser->decode_threads > 0)
+    {
+        trace_parser->pipeline = openDecodePipeline(trace_parser->fd,
+                                                    trace_parser->binary ? trace_parser->kind
+                                                                         : CPU_STREAM,
+                                                    !trace_parser->binary, trace_parser->chunked,
+                                                    trace_parser->decode_threads);
+    }
+}
+
+TraceParser *openTraceParser(const char * trace_file, unsigned decode_threads)
+{
+    FILE *fd = openTraceFile(trace_file);
+    if (fd == NULL)
+    {
+        perror(trace_file);
+        return NULL;
+    }
+
     TraceParser *trace_parser = (TraceParser *)malloc(sizeof(TraceParser));
 
-    trace_parser->fd = fopen(trace_file, "r");
+    trace_parser->fd = fd;
     trace_parser->cur_instr = (Instruction *)malloc(sizeof(Instruction));
 
+    uint32_t flags;
+    trace_parser->chunked = openChunkReader(fd);
+    if (trace_parser->chunked != NULL)
+    {
+        trace_parser->binary = true;
+        trace_parser->kind = trace_parser->chunked->kind;
+    }
+    else
+    {
+        trace_parser->binary = readStreamHeader(fd, &trace_parser->kind, &flags);
+    }
+    trace_parser->skipped = 0;
+    trace_parser->pending = false;
+
+    trace_parser->start = trace_parser->chunked != NULL ? 0 : ftell(fd);
+    trace_parser->records_read = 0;
+    trace_parser->text_offset = trace_parser->start;
+    trace_parser->rejected_lines = 0;
+
+    trace_parser->decode_threads = decode_threads;
+    startDecoding(trace_parser);
+
     return trace_parser;
 }
 
-bool getInstruction(TraceParser *cpu_trace)
+void closeTraceParser(TraceParser *cpu_trace)
 {
-    char *line = NULL;
-    size_t len = 0;
-    ssize_t read;
-
-    if ((read = getline(&line, &len, cpu_trace->fd)) != -1)
+    if (cpu_trace->pipeline != NULL)
     {
-	char delim[] = " \n";
-
-        // This is the PC
-	char *ptr = strtok(line, delim);
-	cpu_trace->cur_instr->PC = convToUint64(ptr);
+        cpu_trace->rejected_lines += cpu_trace->pipeline->rejected_lines;
+        closeDecodePipeline(cpu_trace->pipeline);
+    }
+    if (cpu_trace->rejected_lines > 0)
+    {
+        fprintf(stderr, "Skipped %"PRIu64" malformed trace lines\n", cpu_trace->rejected_lines);
+    }
+    if (cpu_trace->chunked != NULL)
+    {
+        closeChunkReader(cpu_trace->chunked);
+    }
+    fclose(cpu_trace->fd);
+    free(cpu_trace->cur_instr);
+    free(cpu_trace);
+}
 
-        // This is the instruction type
-        ptr = strtok(NULL, delim);
-        if (strcmp(ptr, "B") == 0)
-	{
-            cpu_trace->cur_instr->instr_type = BRANCH;
-        }
-        else if (strcmp(ptr, "E") == 0)
+static bool nextRecord(TraceParser *cpu_trace, Stream_Record *record)
+{
+    if (cpu_trace->pipeline != NULL)
+    {
+        if (readDecodedRecord(cpu_trace->pipeline, record))
         {
-            cpu_trace->cur_instr->instr_type = EXE;
+            ++cpu_trace->records_read;
+            return true;
         }
-        else if (strcmp(ptr, "L") == 0)
+        if (cpu_trace->pipeline->corrupt)
         {
-            cpu_trace->cur_instr->instr_type = LOAD;
+            fprintf(stderr, "Corrupt chunk, the trace ends early\n");
         }
-        else if (strcmp(ptr, "S") == 0)
+        return false;
+    }
+    if (cpu_trace->chunked == NULL)
+    {
+        bool read = readFlatRecord(cpu_trace->fd, cpu_trace->kind, record);
+        cpu_trace->records_read += read;
+        return read;
+    }
+    if (readChunkRecord(cpu_trace->chunked, record))
+    {
+        ++cpu_trace->records_read;
+        return true;
+    }
+    if (cpu_trace->chunked->corrupt)
+    {
+        fprintf(stderr, "Corrupt chunk, the trace ends early\n");
+    }
+    return false;
+}
+
+// Of each Record_Type but SKIP_RECORD
+static const Instruction_Type instrTypes[] = {EXE, BRANCH, LOAD, STORE};
+
+// The next instruction of a binary stream, or of any trace decoded on
+// threads of its own. A branch stream gives the
+// instructions it left out back as EXE ones (at PC 0), so that instruction
+// counts, warm-up and measure points stay those of the original trace.
+static bool getBinaryInstruction(TraceParser *cpu_trace)
+{
+    while (cpu_trace->skipped == 0 && !cpu_trace->pending)
+    {
+        if (!nextRecord(cpu_trace, &cpu_trace->next_record))
         {
-            cpu_trace->cur_instr->instr_type = STORE;
+            return false;
         }
+        cpu_trace->skipped = cpu_trace->next_record.skipped;
+        cpu_trace->pending = cpu_trace->next_record.type != SKIP_RECORD;
+    }
 
-        // More info
-        if (strcmp(ptr, "B") == 0)
-        {
-            ptr = strtok(NULL, delim);
+    Instruction *instr = cpu_trace->cur_instr;
+    if (cpu_trace->skipped > 0)
+    {
+        --cpu_trace->skipped;
+        instr->PC = 0;
+        instr->instr_type = EXE;
+        return true;
+    }
 
-            cpu_trace->cur_instr->taken = atoi(ptr);
-        }
+    const Stream_Record *record = &cpu_trace->next_record;
+    cpu_trace->pending = false;
+    instr->PC = record->PC;
+    instr->instr_type = instrTypes[record->type];
+    instr->taken = record->taken;
+    instr->load_or_store_addr = record->addr;
+    instr->size = record->size;
+    return true;
+}
 
-        if (strcmp(ptr, "L") == 0 || strcmp(ptr, "S") == 0)
-        {
-            ptr = strtok(NULL, delim);
-            
-            cpu_trace->cur_instr->load_or_store_addr = convToUint64(ptr);
+bool getInstruction(TraceParser *cpu_trace)
+{
+    if (cpu_trace->binary || cpu_trace->pipeline != NULL)
+    {
+        return getBinaryInstruction(cpu_trace);
+    }
 
-            ptr = strtok(NULL, delim);
-            
-            cpu_trace->cur_instr->size = atoi(ptr);
+    // Parsed as on the decode threads (see parseTextRecord()); lines that
+    // are not records are left out and counted
+    char *line = NULL;
+    size_t len = 0;
+    ssize_t read;
+    Stream_Record record;
+
+    while ((read = getline(&line, &len, cpu_trace->fd)) != -1)
+    {
+        cpu_trace->text_offset += read;
+        if (!parseTextRecord(line, CPU_STREAM, &record))
+        {
+            cpu_trace->rejected_lines += !isBlankLine(line);
+            continue;
         }
 
+        Instruction *instr = cpu_trace->cur_instr;
+        instr->PC = record.PC;
+        instr->instr_type = instrTypes[record.type];
+        instr->taken = record.taken;
+        instr->load_or_store_addr = record.addr;
+        instr->size = record.size;
+
         free(line);
-        line = NULL;
-        // printInstruction(cpu_trace->cur_instr);
-	return true;
+        return true;
     }
 
-    // Release memory
+    // End of the trace, the parser stays open until closeTraceParser()
     free(line);
-
-    fclose(cpu_trace->fd);
-    free(cpu_trace->cur_instr);
-    free(cpu_trace);
     return false;
 }
 
+void tellTrace(const TraceParser *cpu_trace, Trace_Position *position)
+{
+    memset(position, 0, sizeof(Trace_Position));
+    if (cpu_trace->chunked != NULL)
+    {
+        position->record = cpu_trace->records_read;
+    }
+    else if (cpu_trace->binary)
+    {
+        position->record = cpu_trace->start + cpu_trace->records_read * flatRecordSize(cpu_trace->kind);
+    }
+    else
+    {
+        position->record = cpu_trace->pipeline != NULL ? decodedTextOffset(cpu_trace->pipeline)
+                                                       : cpu_trace->text_offset;
+    }
+    position->skipped = cpu_trace->skipped;
+    position->pending = cpu_trace->pending;
+    position->next_record = cpu_trace->next_record;
+}
+
+// Whether a text trace or a flat stream has a record at offset
+static bool isRecordStart(TraceParser *cpu_trace, uint64_t offset)
+{
+    struct stat st;
+    if (fstat(fileno(cpu_trace->fd), &st) != 0 || offset < cpu_trace->start ||
+        offset > (uint64_t)st.st_size)
+    {
+        return false;
+    }
+    if (cpu_trace->binary)
+    {
+        return (offset - cpu_trace->start) % flatRecordSize(cpu_trace->kind) == 0;
+    }
+
+    // A line starts after a newline
+    long at = ftell(cpu_trace->fd);
+    bool line_start = offset == cpu_trace->start ||
+                      (fseek(cpu_trace->fd, offset - 1, SEEK_SET) == 0 &&
+                       fgetc(cpu_trace->fd) == '\n');
+    return fseek(cpu_trace->fd, at, SEEK_SET) == 0 && line_start;
+}
+
+bool seekTrace(TraceParser *cpu_trace, const Trace_Position *position)
+{
+    Chunk_Reader *chunked = cpu_trace->chunked;
+    if (chunked == NULL ? !isRecordStart(cpu_trace, position->record)
+                        : chunked->index == NULL || position->record > chunked->total_records)
+    {
+        return false;
+    }
+
+    // The decode threads read on from where the trace stands
+    if (cpu_trace->pipeline != NULL)
+    {
+        cpu_trace->rejected_lines += cpu_trace->pipeline->rejected_lines;
+        closeDecodePipeline(cpu_trace->pipeline);
+        cpu_trace->pipeline = NULL;
+    }
+
+    // Containers go to the start of the chunk, then decode up to the record
+    bool ok;
+    if (chunked != NULL)
+    {
+        ok = seekChunk(chunked, position->record, &cpu_trace->records_read);
+    }
+    else
+    {
+        ok = fseek(cpu_trace->fd, position->record, SEEK_SET) == 0;
+        cpu_trace->text_offset = position->record;
+        if (cpu_trace->binary)
+        {
+            cpu_trace->records_read = (position->record - cpu_trace->start) /
+                                      flatRecordSize(cpu_trace->kind);
+        }
+    }
+    startDecoding(cpu_trace);
+
+    Stream_Record skipped;
+    while (ok && chunked != NULL && cpu_trace->records_read < position->record)
+    {
+        ok = nextRecord(cpu_trace, &skipped);
+    }
+
+    cpu_trace->skipped = position->skipped;
+    cpu_trace->pending = position->pending;
+    cpu_trace->next_record = position->next_record;
+    return ok;
+}
+
 // convert a string to a uint64_t number
 uint64_t convToUint64(char *ptr)
 {
@@ -7,17 +7,60 @@
 #include <string.h>
 
 #include "Instruction.h"
+#include "Binary_Trace.h"
+#include "Chunked_Trace.h"
+#include "Trace_Decode.h"
 
 typedef struct TraceParser
 {
     FILE *fd; // file descriptor for the trace file
 
     Instruction *cur_instr; // current instruction
+
+    // Binary streams, flat (see Binary_Trace.h) or chunked (Chunked_Trace.h)
+    bool binary;
+    Stream_Kind kind;
+    Chunk_Reader *chunked; // NULL if flat
+    Stream_Record next_record; // After the skipped instructions
+    uint32_t skipped; // Instructions left out before next_record, given back as EXE
+    bool pending; // next_record is still to come
+
+    Decode_Pipeline *pipeline; // NULL if decoded on the caller's thread
+    unsigned decode_threads;
+
+    // Where the records read so far end (see tellTrace())
+    uint64_t start; // Offset of the first record
+    uint64_t records_read; // Binary streams
+    uint64_t text_offset; // Text traces read on the caller's thread
+
+    uint64_t rejected_lines; // Text lines that are not records, left out
 }TraceParser;
 
+// Where a parser stands in its trace: the next record to read, by byte
+// offset in text traces and flat streams or by index in containers, and
+// what is left of the record read before it
+typedef struct Trace_Position
+{
+    uint64_t record;
+    uint32_t skipped;
+    bool pending;
+    Stream_Record next_record;
+}Trace_Position;
+
 // Define functions
+// NULL if the trace cannot be opened. Text traces, binary streams and
+// chunked containers are told apart by their first bytes.
 TraceParser *initTraceParser(const char * trace_file);
+// The same, decoding on decode_threads threads (see Trace_Decode.h), 0 for
+// none
+TraceParser *openTraceParser(const char * trace_file, unsigned decode_threads);
+void closeTraceParser(TraceParser *cpu_trace);
 bool getInstruction(TraceParser *cpu_trace);
+void tellTrace(const TraceParser *cpu_trace, Trace_Position *position);
+// Carry on reading from position, taken by tellTrace() on the same trace;
+// false if the trace has no record there or a container has no index to
+// find it
+bool seekTrace(TraceParser *cpu_trace, const Trace_Position *position);
 uint64_t convToUint64(char *ptr);
 void printInstruction(Instruction *instr);
 
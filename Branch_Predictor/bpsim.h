@@ -0,0 +1,92 @@
+#ifndef __BPSIM_HH__
+#define __BPSIM_HH__
+
+#include <stdbool.h>
+
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h> // uint64_t
+
+#include "Arena.h"
+
+// libbpsim: the branch predictors as a library.
+//
+// Every predictor is an independent instance built from an explicit
+// configuration; there is no global state, so any number of them can run
+// in one process (one thread per instance at a time). The header needs
+// nothing from the trace side, so it can sit next to cachesim.h.
+
+#ifndef BPSIM_API
+#define BPSIM_API __attribute__((visibility("default")))
+#endif
+
+typedef enum Predictor_Type{TWO_BIT_LOCAL_PREDICTOR, TOURNAMENT_PREDICTOR, GSHARE_PREDICTOR,
+                            PERCEPTRON_PREDICTOR}Predictor_Type;
+
+#define num_predictor_types 4
+
+// Table sizes are in entries and must be powers of two
+typedef struct Branch_Predictor_Config
+{
+    Predictor_Type type;
+
+    // Two-bit local and tournament
+    unsigned local_predictor_size;
+    unsigned local_counter_bits;
+    // Tournament
+    unsigned local_history_bits; // Length of each per-PC local history, at most log2(local_predictor_size)
+    unsigned local_history_table_size;
+    unsigned global_predictor_size; // Also the size of the choice predictor
+    unsigned global_counter_bits;
+    unsigned choice_counter_bits;
+    // Gshare
+    unsigned gshare_predictor_size;
+    unsigned gshare_counter_bits;
+    // Perceptron
+    unsigned perceptron_size; // Rows of weights
+    unsigned perceptron_history; // Global history length, the weights per row
+    float theta; // Training threshold, 0: 1.93 x perceptron_history + 14
+
+    Arena_Pages pages; // Backing of the tables
+}Branch_Predictor_Config;
+
+typedef struct Predictor_Stats
+{
+    uint64_t branches;
+    uint64_t mispredictions;
+}Predictor_Stats;
+
+typedef struct Branch_Predictor Branch_Predictor;
+
+// The defaults of the build (-DTWO_BIT_LOCAL, -DTOURNAMENT, ... pick the type)
+BPSIM_API void initPredictorConfig(Branch_Predictor_Config *config);
+// Prints what is wrong, if anything
+BPSIM_API bool checkPredictorConfig(const Branch_Predictor_Config *config);
+
+// NULL if the configuration is invalid or the memory cannot be had
+BPSIM_API Branch_Predictor *initBranchPredictor(const Branch_Predictor_Config *config);
+BPSIM_API void freeBranchPredictor(Branch_Predictor *branch_predictor);
+// Back to the state of a new predictor, statistics included
+BPSIM_API void resetBranchPredictor(Branch_Predictor *branch_predictor);
+
+// Predict the branch at PC and train on its real direction. Returns whether
+// the prediction was correct.
+BPSIM_API bool predictBranch(Branch_Predictor *branch_predictor, uint64_t PC, bool taken);
+// Predict count branches in order; correct_out[i] tells whether branch i
+// was predicted correctly and, unless provider_out is NULL, provider_out[i]
+// which component predicted it. Returns the number of correct predictions.
+BPSIM_API uint64_t predictBatch(Branch_Predictor *branch_predictor, const uint64_t *pcs,
+                                const uint8_t *taken, unsigned count, uint8_t *correct_out,
+                                uint8_t *provider_out);
+
+BPSIM_API void getPredictorStats(const Branch_Predictor *branch_predictor, Predictor_Stats *stats);
+BPSIM_API Predictor_Type getPredictorType(const Branch_Predictor *branch_predictor);
+
+BPSIM_API const char *predictorName(Predictor_Type type);
+// Parse two_bit_local, tournament, gshare or perceptron
+BPSIM_API bool parsePredictorType(const char *name, Predictor_Type *type);
+// Command line options of the predictor (--predictor <name>)
+BPSIM_API bool parsePredictorOption(Branch_Predictor_Config *config, int argc, const char *argv[],
+                                    int *arg);
+BPSIM_API void printPredictorUsage();
+
+#endif
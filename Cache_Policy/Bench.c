@@ -0,0 +1,388 @@
+#include "Trace.h"
+#include "Cache.h"
+#include "Bench.h"
+
+// Throughput benchmark of a replacement policy (--policy) on synthetic
+// memory streams. Every stream is generated from a fixed seed, so runs are
+// comparable across commits. `make bench` runs it once per policy.
+//
+// --check-kernels instead runs the streams through every specialized
+// kernel (see Cache.h) and the generic one, which must hit and miss alike
+// access by access, through accessBlock() and accessCacheBatch() both.
+// `make check` runs it.
+
+#define num_streams 4
+
+const char *streamNames[num_streams] = {"strided", "pointer_chase", "zipf", "scan_mixed"};
+
+#define check_batch 4096 // Accesses per accessCacheBatch() of --check-kernels
+
+#define zipf_blocks (1 << 20) // Distinct blocks of the Zipfian stream
+#define zipf_alpha 0.99
+
+// Cumulative distribution of a Zipf(alpha) over n ranks
+static double *zipfTable(unsigned n, double alpha)
+{
+    double *cdf = (double *)malloc(n * sizeof(double));
+    double sum = 0;
+    unsigned i;
+    for (i = 0; i < n; i++)
+    {
+        sum += 1.0 / pow(i + 1, alpha);
+        cdf[i] = sum;
+    }
+    for (i = 0; i < n; i++)
+    {
+        cdf[i] /= sum;
+    }
+    return cdf;
+}
+
+static unsigned zipfRank(const double *cdf, unsigned n, uint64_t *seed)
+{
+    double u = benchUniform(seed);
+    unsigned lo = 0, hi = n - 1;
+    while (lo < hi)
+    {
+        unsigned mid = (lo + hi) / 2;
+        if (cdf[mid] < u)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Spread ranks over the address space so hot blocks do not share sets
+static uint64_t scatterBlock(uint64_t block, unsigned bits)
+{
+    return (block * 0x9E3779B97F4A7C15ull) >> (64 - bits);
+}
+
+static void genStream(int stream, Request *reqs, uint64_t count, uint64_t seed)
+{
+    uint64_t i;
+    double *cdf = NULL;
+    if (stream == 2 || stream == 3)
+    {
+        cdf = zipfTable(zipf_blocks, zipf_alpha);
+    }
+
+    // Pointer chasing follows one random cycle through 2^17 blocks (8 MB)
+    unsigned chase_blocks = 1 << 17;
+    unsigned *next = NULL;
+    if (stream == 1)
+    {
+        next = (unsigned *)malloc(chase_blocks * sizeof(unsigned));
+        unsigned *order = (unsigned *)malloc(chase_blocks * sizeof(unsigned));
+        for (i = 0; i < chase_blocks; i++)
+        {
+            order[i] = i;
+        }
+        for (i = chase_blocks - 1; i > 0; i--)
+        {
+            unsigned j = benchRandom(&seed) % (i + 1);
+            unsigned tmp = order[i]; order[i] = order[j]; order[j] = tmp;
+        }
+        for (i = 0; i < chase_blocks; i++)
+        {
+            next[order[i]] = order[(i + 1) % chase_blocks];
+        }
+        free(order);
+    }
+
+    uint64_t node = 0;
+    uint64_t scan = 0;
+    for (i = 0; i < count; i++)
+    {
+        Request *req = &reqs[i];
+        req->core_id = 0;
+        req->req_type = benchUniform(&seed) < 0.2 ? STORE : LOAD;
+
+        if (stream == 0)
+        {
+            // 128 B stride over a 4 MB array
+            req->PC = 0x1000;
+            req->load_or_store_addr = 0x10000000 + (i * 128) % (4 << 20);
+        }
+        else if (stream == 1)
+        {
+            req->PC = 0x2000;
+            req->req_type = LOAD;
+            req->load_or_store_addr = 0x20000000 + node * 64;
+            node = next[node];
+        }
+        else if (stream == 2)
+        {
+            unsigned rank = zipfRank(cdf, zipf_blocks, &seed);
+            req->PC = 0x3000 + (rank & 15) * 4;
+            req->load_or_store_addr = 0x40000000 + scatterBlock(rank, 24) * 64;
+        }
+        else
+        {
+            // A Zipfian hot set interrupted by a long sequential scan
+            if (benchUniform(&seed) < 0.75)
+            {
+                unsigned rank = zipfRank(cdf, 1 << 14, &seed);
+                req->PC = 0x4000;
+                req->load_or_store_addr = 0x40000000 + scatterBlock(rank, 24) * 64;
+            }
+            else
+            {
+                req->PC = 0x4100;
+                req->load_or_store_addr = 0x80000000 + (scan++ % (1 << 20)) * 64;
+            }
+        }
+    }
+
+    free(cdf);
+    free(next);
+}
+
+// Write a stream as a memory trace Main can read
+static void writeStream(const char *file, const Request *reqs, uint64_t count)
+{
+    FILE *fd = fopen(file, "w");
+    if (fd == NULL)
+    {
+        perror(file);
+        exit(1);
+    }
+
+    uint64_t i;
+    for (i = 0; i < count; i++)
+    {
+        fprintf(fd, "%d %"PRIu64" %"PRIu64" %s\n", reqs[i].core_id, reqs[i].PC,
+                reqs[i].load_or_store_addr, reqs[i].req_type == STORE ? "S" : "L");
+    }
+    fclose(fd);
+}
+
+// The hits of every access, through accessBlock() and insertBlock()
+static void runBlocks(Cache *cache, const Request *reqs, uint64_t count, uint8_t *hits)
+{
+    uint64_t i;
+    for (i = 0; i < count; i++)
+    {
+        Request req = reqs[i];
+        hits[i] = accessBlock(cache, &req, i);
+        if (!hits[i])
+        {
+            uint64_t wb_addr;
+            insertBlock(cache, &req, i, &wb_addr);
+        }
+    }
+}
+
+// The same through accessCacheBatch(), in batches like the Python module's
+static void runBatches(Cache *cache, const uint64_t *pcs, const uint64_t *addrs,
+                       const uint8_t *stores, uint64_t count, uint8_t *hits)
+{
+    uint64_t i;
+    for (i = 0; i < count; i += check_batch)
+    {
+        unsigned n = count - i < check_batch ? count - i : check_batch;
+        accessCacheBatch(cache, pcs + i, addrs + i, stores + i, n, hits + i);
+    }
+}
+
+// Whether two caches, run alike, agree
+static bool sameRun(const Cache *a, const Cache *b, const uint8_t *a_hits, const uint8_t *b_hits,
+                    uint64_t count)
+{
+    Cache_Stats a_stats, b_stats;
+    getCacheStats(a, &a_stats);
+    getCacheStats(b, &b_stats);
+    return memcmp(a_hits, b_hits, count) == 0 && a->evictions == b->evictions &&
+           a->writebacks == b->writebacks && memcmp(&a_stats, &b_stats, sizeof(Cache_Stats)) == 0;
+}
+
+// Every specialized kernel of every policy that has them, against the
+// generic kernel, on every stream; the cache size of config
+static bool checkKernels(const Cache_Config *config, Request *reqs, uint64_t count, uint64_t seed)
+{
+    static const Replacement_Policy policies[] = {LRU_POLICY, LFU_POLICY, SRRIP_POLICY,
+                                                  SHIP_POLICY};
+    static const unsigned assocs[] = {4, 8, 16};
+
+    uint64_t *pcs = (uint64_t *)malloc(count * sizeof(uint64_t));
+    uint64_t *addrs = (uint64_t *)malloc(count * sizeof(uint64_t));
+    uint8_t *stores = (uint8_t *)malloc(count);
+    uint8_t *hits = (uint8_t *)malloc(count);
+    uint8_t *generic_hits = (uint8_t *)malloc(count);
+
+    unsigned failed = 0;
+    int stream;
+    for (stream = 0; stream < num_streams; stream++)
+    {
+        genStream(stream, reqs, count, seed);
+        uint64_t i;
+        for (i = 0; i < count; i++)
+        {
+            pcs[i] = reqs[i].PC;
+            addrs[i] = reqs[i].load_or_store_addr;
+            stores[i] = reqs[i].req_type == STORE;
+        }
+
+        unsigned p, a;
+        for (p = 0; p < sizeof(policies) / sizeof(policies[0]); p++)
+        {
+            for (a = 0; a < sizeof(assocs) / sizeof(assocs[0]); a++)
+            {
+                Cache_Config kernel_config = *config;
+                kernel_config.block_size = 64;
+                kernel_config.assoc = assocs[a];
+                kernel_config.num_sets = 0;
+                kernel_config.set_index = MODULO_INDEX;
+                kernel_config.policy = policies[p];
+                kernel_config.generic_kernel = false;
+                Cache_Config generic_config = kernel_config;
+                generic_config.generic_kernel = true;
+                if (!checkCacheConfig(&kernel_config))
+                {
+                    return false;
+                }
+
+                Cache *cache = initCache(&kernel_config);
+                Cache *generic = initCache(&generic_config);
+                const char *kernel = kernelName(cache);
+
+                runBlocks(cache, reqs, count, hits);
+                runBlocks(generic, reqs, count, generic_hits);
+                bool same_blocks = sameRun(cache, generic, hits, generic_hits, count);
+
+                resetCache(cache);
+                resetCache(generic);
+                runBatches(cache, pcs, addrs, stores, count, hits);
+                runBatches(generic, pcs, addrs, stores, count, generic_hits);
+                bool same_batches = sameRun(cache, generic, hits, generic_hits, count);
+
+                printf("%-6s %-7s %-14s %s\n", policyName(policies[p]), kernel, streamNames[stream],
+                       strcmp(kernel, "generic") == 0 ? "not specialized" :
+                       !same_blocks ? "DIFFERS through accessBlock()" :
+                       !same_batches ? "DIFFERS through accessCacheBatch()" : "same");
+                failed += !same_blocks || !same_batches || strcmp(kernel, "generic") == 0;
+
+                freeCache(cache);
+                freeCache(generic);
+            }
+        }
+    }
+
+    free(pcs);
+    free(addrs);
+    free(stores);
+    free(hits);
+    free(generic_hits);
+    printf("%s\n", failed == 0 ? "Every kernel matches the generic one" : "Kernels differ");
+    return failed == 0;
+}
+
+int main(int argc, const char *argv[])
+{
+    uint64_t count = 10000000;
+    uint64_t seed = 42;
+    const char *write_stream = NULL;
+    const char *write_file = NULL;
+    bool check_kernels = false;
+    Cache_Config cache_config;
+    initCacheConfig(&cache_config);
+
+    int arg;
+    for (arg = 1; arg < argc; arg++)
+    {
+        if (strcmp(argv[arg], "--records") == 0 && arg + 1 < argc)
+        {
+            count = strtoull(argv[++arg], NULL, 10);
+        }
+        else if (strcmp(argv[arg], "--seed") == 0 && arg + 1 < argc)
+        {
+            seed = strtoull(argv[++arg], NULL, 10);
+        }
+        else if (strcmp(argv[arg], "--write") == 0 && arg + 2 < argc)
+        {
+            write_stream = argv[++arg];
+            write_file = argv[++arg];
+        }
+        else if (strcmp(argv[arg], "--check-kernels") == 0)
+        {
+            check_kernels = true;
+        }
+        else if (parseCacheOption(&cache_config, argc, argv, &arg))
+        {
+        }
+        else
+        {
+            printf("Usage: %s [--records N] [--seed S] [--write <stream> <mem-file>] [cache options]\n",
+                   argv[0]);
+            printf("       %s --check-kernels [--records N] [--seed S] [--cache-size KB]\n",
+                   argv[0]);
+            printf("  streams: strided, pointer_chase, zipf, scan_mixed\n");
+            printCacheUsage();
+            return 0;
+        }
+    }
+    if (!checkCacheConfig(&cache_config))
+    {
+        return 1;
+    }
+
+    Request *reqs = (Request *)malloc(count * sizeof(Request));
+    if (check_kernels)
+    {
+        return checkKernels(&cache_config, reqs, count, seed) ? 0 : 1;
+    }
+
+    int stream;
+    if (write_stream != NULL)
+    {
+        for (stream = 0; stream < num_streams; stream++)
+        {
+            if (strcmp(write_stream, streamNames[stream]) == 0)
+            {
+                genStream(stream, reqs, count, seed);
+                writeStream(write_file, reqs, count);
+                return 0;
+            }
+        }
+        fprintf(stderr, "Unknown stream: %s\n", write_stream);
+        return 1;
+    }
+
+    for (stream = 0; stream < num_streams; stream++)
+    {
+        genStream(stream, reqs, count, seed);
+
+        Cache *cache = initCache(&cache_config);
+        uint64_t hits = 0;
+
+        uint64_t start = benchNowNs();
+        uint64_t i;
+        for (i = 0; i < count; i++)
+        {
+            if (accessBlock(cache, &reqs[i], i))
+            {
+                ++hits;
+            }
+            else
+            {
+                uint64_t wb_addr;
+                insertBlock(cache, &reqs[i], i, &wb_addr);
+            }
+        }
+        uint64_t elapsed_ns = benchNowNs() - start;
+
+        printf("%-6s %-7s %-14s %12.0f rec/s %8.2f ns/access %10ld KB peak RSS %8.3f%% hits\n",
+               policyName(cache_config.policy), kernelName(cache), streamNames[stream],
+               count / (elapsed_ns / 1e9), (double)elapsed_ns / count,
+               benchPeakRssKb(), 100.0 * hits / count);
+
+        freeCache(cache);
+    }
+
+    return 0;
+}
@@ -1,40 +1,224 @@
 #include "Cache.h"
 
-/* Constants */
-const unsigned block_size = 64; // Size of a cache line (in Bytes)
-// TODO, you should try different size of cache, for example, 128KB, 256KB, 512KB, 1MB, 2MB
-const unsigned cache_size = 512; // Size of a cache (in KB)
-// TODO, you should try different association configurations, for example 4, 8, 16
-const unsigned assoc = 8;
-const unsigned counter_bits = 2;
+void initCacheConfig(Cache_Config *config)
+{
+    config->block_size = 64; // Size of a cache line (in Bytes)
+    // TODO, you should try different size of cache, for example, 128KB, 256KB, 512KB, 1MB, 2MB
+    config->cache_size = 512; // Size of a cache (in KB)
+    // TODO, you should try different association configurations, for example 4, 8, 16
+    config->assoc = 8;
+    config->num_sets = 0;
+    config->set_index = MODULO_INDEX;
+    config->pages = HUGE_PAGES;
+    config->policy = SHIP_POLICY;
+    config->rrpv_bits = 2;
+    config->generic_kernel = false;
+}
+
+static bool readCacheConfig(Cache_Config *config, const char *file);
 
-Cache *initCache()
+bool parseCacheOption(Cache_Config *config, int argc, const char *argv[], int *arg)
 {
-    Cache *cache = (Cache *)malloc(sizeof(Cache));
+    const char *opt = argv[*arg];
+    if (*arg + 1 >= argc)
+    {
+        return false;
+    }
+    const char *val = argv[*arg + 1];
 
-    cache->blk_mask = block_size - 1;
+    if (strcmp(opt, "--block-size") == 0)
+    {
+        config->block_size = atoi(val);
+    }
+    else if (strcmp(opt, "--cache-size") == 0)
+    {
+        config->cache_size = atoi(val);
+        config->num_sets = 0;
+    }
+    else if (strcmp(opt, "--assoc") == 0)
+    {
+        config->assoc = atoi(val);
+    }
+    else if (strcmp(opt, "--sets") == 0)
+    {
+        config->num_sets = atoi(val);
+    }
+    else if (strcmp(opt, "--set-index") == 0 && strcmp(val, "mod") == 0)
+    {
+        config->set_index = MODULO_INDEX;
+    }
+    else if (strcmp(opt, "--set-index") == 0 && strcmp(val, "xor") == 0)
+    {
+        config->set_index = XOR_INDEX;
+    }
+    else if (strcmp(opt, "--huge-pages") == 0 && parseArenaPages(val, &config->pages))
+    {
+    }
+    else if (strcmp(opt, "--policy") == 0 && parsePolicy(val, &config->policy))
+    {
+    }
+    else if (strcmp(opt, "--rrpv-bits") == 0)
+    {
+        config->rrpv_bits = atoi(val);
+    }
+    else if (strcmp(opt, "--kernel") == 0 && strcmp(val, "auto") == 0)
+    {
+        config->generic_kernel = false;
+    }
+    else if (strcmp(opt, "--kernel") == 0 && strcmp(val, "generic") == 0)
+    {
+        config->generic_kernel = true;
+    }
+    else if (strcmp(opt, "--config") == 0 && readCacheConfig(config, val))
+    {
+    }
+    else
+    {
+        return false;
+    }
 
-    unsigned num_blocks = cache_size * 1024 / block_size;
-    cache->num_blocks = num_blocks;
-//    printf("Num of blocks: %u\n", cache->num_blocks);
+    ++*arg;
+    return true;
+}
 
-    // Initialize all cache blocks
-    cache->blocks = (Cache_Block *)malloc(num_blocks * sizeof(Cache_Block));
-    int i;
-    for (i = 0; i < num_blocks; i++)
+void printCacheUsage()
+{
+    printf("  --block-size N     block size in bytes, a power of two (default 64)\n");
+    printf("  --cache-size KB    cache size (default 512)\n");
+    printf("  --assoc N          ways per set (default 8)\n");
+    printf("  --sets N           number of sets, any number, instead of --cache-size\n");
+    printf("  --set-index <mod|xor>  set of a block: block number modulo the sets, or\n");
+    printf("                     the XOR of all its index-sized slices first\n");
+    printf("  --huge-pages <none|thp|hugetlb>  back the cache state with huge pages,\n");
+    printf("                     transparent or reserved (default thp)\n");
+    printf("  --policy <name>    replacement policy: lru, lfu, srrip, ship, hawkeye or\n");
+    printf("                     belady where the next uses are known (default ship)\n");
+    printf("  --rrpv-bits N      bits of the SRRIP and SHiP re-reference values (default 2)\n");
+    printf("  --kernel <auto|generic>  the access kernel specialized for the geometry,\n");
+    printf("                     if there is one, or always the generic one\n");
+    printf("  --config <file>    read these options from <file>, one per line without\n");
+    printf("                     the dashes: \"policy srrip\"\n");
+}
+
+// The options of a config file, one "name value" per line
+static bool readCacheConfig(Cache_Config *config, const char *file)
+{
+    FILE *fd = fopen(file, "r");
+    if (fd == NULL)
+    {
+        perror(file);
+        return false;
+    }
+
+    char line[256];
+    unsigned line_num = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), fd) != NULL)
+    {
+        ++line_num;
+        char *comment = strchr(line, '#');
+        if (comment != NULL)
+        {
+            *comment = '\0';
+        }
+        char *save;
+        char *name = strtok_r(line, " \t\r\n", &save);
+        char *val = strtok_r(NULL, " \t\r\n", &save);
+        if (name == NULL)
+        {
+            continue;
+        }
+
+        // As on the command line; a config file does not read others
+        char opt[64];
+        snprintf(opt, sizeof(opt), "--%s", name);
+        const char *args[2] = {opt, val};
+        int arg = 0;
+        ok = val != NULL && strcmp(name, "config") != 0 && parseCacheOption(config, 2, args, &arg);
+        if (!ok)
+        {
+            fprintf(stderr, "%s:%u: bad setting %s\n", file, line_num, name);
+        }
+    }
+    fclose(fd);
+    return ok;
+}
+
+unsigned getNumSets(const Cache_Config *config)
+{
+    if (config->num_sets > 0)
+    {
+        return config->num_sets;
+    }
+    uint64_t set_bytes = (uint64_t)config->block_size * config->assoc;
+    return set_bytes > 0 ? (uint64_t)config->cache_size * 1024 / set_bytes : 0;
+}
+
+bool checkCacheConfig(const Cache_Config *config)
+{
+    if (config->block_size < 4 || (config->block_size & (config->block_size - 1)) != 0)
+    {
+        fprintf(stderr, "Block size %u is not a power of two\n", config->block_size);
+        return false;
+    }
+    if (config->rrpv_bits < 1 || config->rrpv_bits > max_rrpv_bits)
+    {
+        fprintf(stderr, "Re-reference values must have 1 to %u bits, not %u\n", max_rrpv_bits,
+                config->rrpv_bits);
+        return false;
+    }
+    if (config->assoc == 0 || getNumSets(config) == 0)
+    {
+        fprintf(stderr, "The cache needs at least one set and one way\n");
+        return false;
+    }
+    if (config->num_sets == 0 &&
+        (uint64_t)getNumSets(config) * config->block_size * config->assoc !=
+        (uint64_t)config->cache_size * 1024)
+    {
+        fprintf(stderr, "%u KB is not a whole number of %u-way sets of %u B blocks, "
+                "give --sets instead\n", config->cache_size, config->assoc, config->block_size);
+        return false;
+    }
+    return true;
+}
+
+static void initState(Cache *cache, bool zeroed);
+static Cache_Kernel pickKernel(const Cache *cache);
+
+Cache *initCache(const Cache_Config *config)
+{
+    if (!checkCacheConfig(config))
+    {
+        return NULL;
+    }
+
+    unsigned block_size = config->block_size;
+    unsigned assoc = config->assoc;
+    unsigned num_sets = getNumSets(config);
+    unsigned num_blocks = num_sets * assoc;
+
+    // Everything lives in one arena: the cache, its blocks, the ways of
+    // every set, the sets, the SHCT and the Hawkeye state
+    unsigned shct_words = counterTableWords(1 << ship_signature_bits, ship_counter_bits);
+    Arena arena;
+    if (!initArena(&arena, arenaBytes(sizeof(Cache)) +
+                           arenaBytes((uint64_t)num_blocks * sizeof(Cache_Block)) +
+                           arenaBytes((uint64_t)num_blocks * sizeof(Cache_Block *)) +
+                           arenaBytes((uint64_t)num_sets * sizeof(Set)) +
+                           arenaBytes(shct_words * sizeof(uint64_t)) +
+                           hawkeyeBytes(num_sets, assoc), config->pages))
     {
-        cache->blocks[i].tag = UINTMAX_MAX; 
-        cache->blocks[i].valid = false;
-        cache->blocks[i].dirty = false;
-        cache->blocks[i].when_touched = 0;
-        cache->blocks[i].frequency = 0;
-		cache->blocks[i].outcome = false;
-		cache->blocks[i].sig = 0;
-		initSatCounter(&(cache->blocks[i].RRPV), counter_bits);
+        return NULL;
     }
+    Cache *cache = (Cache *)arenaAlloc(&arena, sizeof(Cache));
+
+    cache->blk_mask = block_size - 1;
+
+    cache->num_blocks = num_blocks;
+//    printf("Num of blocks: %u\n", cache->num_blocks);
 
     // Initialize Set-way variables
-    unsigned num_sets = cache_size * 1024 / (block_size * assoc);
     cache->num_sets = num_sets;
     cache->num_ways = assoc;
 //    printf("Num of sets: %u\n", cache->num_sets);
@@ -43,66 +227,353 @@ Cache *initCache()
     cache->set_shift = set_shift;
 //    printf("Set shift: %u\n", cache->set_shift);
 
-    unsigned set_mask = num_sets - 1;
-    cache->set_mask = set_mask;
-//    printf("Set mask: %u\n", cache->set_mask);
+    // A mask if the sets are a power of two, else a fast modulo
+    cache->set_index = config->set_index;
+    cache->index_bits = 1;
+    while ((1ull << cache->index_bits) < num_sets)
+    {
+        ++cache->index_bits;
+    }
+    cache->set_mask = num_sets - 1;
+    cache->set_magic = (num_sets & (num_sets - 1)) == 0 ? 0 : ~(__uint128_t)0 / num_sets + 1;
 
-    unsigned tag_shift = set_shift + log2(num_sets);
-    cache->tag_shift = tag_shift;
-//    printf("Tag shift: %u\n", cache->tag_shift);
+    // All cache blocks start zeroed: invalid, clean, never touched
+    cache->blocks = (Cache_Block *)arenaAlloc(&arena, (uint64_t)num_blocks * sizeof(Cache_Block));
+    Cache_Block **ways = (Cache_Block **)arenaAlloc(&arena, (uint64_t)num_blocks * sizeof(Cache_Block *));
+    cache->sets = (Set *)arenaAlloc(&arena, (uint64_t)num_sets * sizeof(Set));
 
-    // Initialize Sets
-    cache->sets = (Set *)malloc(num_sets * sizeof(Set));
+    // Combine sets and blocks, set after set
+    unsigned i;
     for (i = 0; i < num_sets; i++)
     {
-        cache->sets[i].ways = (Cache_Block **)malloc(assoc * sizeof(Cache_Block *));
+        cache->sets[i].ways = &ways[(uint64_t)i * assoc];
     }
+    cache->SHCT.words = (uint64_t *)arenaAlloc(&arena, shct_words * sizeof(uint64_t));
+    cache->hawkeye = initHawkeyeIn(&arena, num_sets, assoc);
+
+    cache->policy = config->policy;
+    cache->rrpv_bits = config->rrpv_bits;
+    cache->kernel = config->generic_kernel ? GENERIC_KERNEL : pickKernel(cache);
+    cache->arena = arena;
+
+    initState(cache, true);
+    setPolicy(cache, config->policy);
+    return cache;
+}
 
-    // Combine sets and blocks
-    for (i = 0; i < num_blocks; i++)
+// Empty blocks, counters and statistics; zeroed tells that the blocks and
+// the SHCT are already all zero
+static void initState(Cache *cache, bool zeroed)
+{
+    if (!zeroed)
+    {
+        memset(cache->blocks, 0, (uint64_t)cache->num_blocks * sizeof(Cache_Block));
+    }
+
+    unsigned i;
+    for (i = 0; i < cache->num_blocks; i++)
     {
         Cache_Block *blk = &(cache->blocks[i]);
-        
-        uint32_t set = i / assoc;
-        uint32_t way = i % assoc;
 
-        blk->set = set;
-        blk->way = way;
+        blk->set = i / cache->num_ways;
+        blk->way = i % cache->num_ways;
+        blk->tag = UINTMAX_MAX;
+        blk->next_use = no_next_use;
+		initSatCounter(&(blk->RRPV), cache->rrpv_bits);
 
-        cache->sets[set].ways[way] = blk;
+        cache->sets[blk->set].ways[blk->way] = blk;
     }
 
 	// Initialize sat counters
-	cache->SHCT =
-    	(Sat_Counter *)malloc(cache_size * sizeof(Sat_Counter));
+	initCounterTableIn(&(cache->SHCT), cache->SHCT.words, zeroed, 1 << ship_signature_bits,
+	                   ship_counter_bits, 2);
 
-	for (i = 0; i < cache_size; i++)
-	{
-    	initSatCounter(&(cache->SHCT[i]), counter_bits);
-		setTwoCounter(&(cache->SHCT[i]));
-	}
+    cache->evictions = 0;
+    cache->writebacks = 0;
+    cache->time = 0;
+    cache->hits = 0;
+}
 
-    return cache;
+void resetCache(Cache *cache)
+{
+    initState(cache, false);
+
+    // Hawkeye starts over untrained
+    if (cache->policy == HAWKEYE_POLICY)
+    {
+        setPolicy(cache, HAWKEYE_POLICY);
+    }
 }
 
-bool accessBlock(Cache *cache, Request *req, uint64_t access_time)
+void freeCache(Cache *cache)
+{
+    // The cache itself is in the arena
+    Arena arena = cache->arena;
+    freeArena(&arena);
+}
+
+// Switch to another policy; call before the first access
+void setPolicy(Cache *cache, Replacement_Policy policy)
+{
+    bool was_hawkeye = cache->policy == HAWKEYE_POLICY;
+    cache->policy = policy;
+    if (policy == HAWKEYE_POLICY)
+    {
+        resetHawkeye(cache->hawkeye);
+    }
+
+    // Cache-friendly blocks need room to age under Hawkeye; the others go
+    // back to the configured width
+    if (policy == HAWKEYE_POLICY || was_hawkeye)
+    {
+        unsigned bits = policy == HAWKEYE_POLICY ? hawkeye_rrpv_bits : cache->rrpv_bits;
+        unsigned i;
+        for (i = 0; i < cache->num_blocks; i++)
+        {
+            initSatCounter(&(cache->blocks[i].RRPV), bits);
+        }
+    }
+}
+
+Replacement_Policy getPolicy(const Cache *cache)
+{
+    return cache->policy;
+}
+
+static const char *policyNames[num_policies] = {"lru", "lfu", "srrip", "ship", "belady",
+                                                "hawkeye"};
+
+const char *policyName(Replacement_Policy policy)
+{
+    return policyNames[policy];
+}
+
+bool parsePolicy(const char *name, Replacement_Policy *policy)
+{
+    int i;
+    for (i = 0; i < num_policies; i++)
+    {
+        if (strcmp(name, policyNames[i]) == 0)
+        {
+            *policy = (Replacement_Policy)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// The kernels, by geometry: 64 B blocks and a power of two of sets
+static const Kernel_Shape kernelShapes[num_kernels] = {{0, 0}, {4, 6}, {8, 6}, {16, 6}};
+static const char *kernelNames[num_kernels] = {"generic", "4x64", "8x64", "16x64"};
+
+static Cache_Kernel pickKernel(const Cache *cache)
+{
+    if (cache->set_index != MODULO_INDEX || cache->set_magic != 0)
+    {
+        return GENERIC_KERNEL;
+    }
+
+    int k;
+    for (k = 1; k < num_kernels; k++)
+    {
+        if (kernelShapes[k].num_ways == cache->num_ways &&
+            kernelShapes[k].set_shift == cache->set_shift)
+        {
+            return (Cache_Kernel)k;
+        }
+    }
+    return GENERIC_KERNEL;
+}
+
+const char *kernelName(const Cache *cache)
+{
+    // Belady and Hawkeye are only generic
+    if (cache->policy == BELADY_POLICY || cache->policy == HAWKEYE_POLICY)
+    {
+        return kernelNames[GENERIC_KERNEL];
+    }
+    return kernelNames[cache->kernel];
+}
+
+// The geometry in a kernel: constants in a specialized one, the fields of
+// the cache in the generic one
+static inline __attribute__((always_inline))
+unsigned kernelWays(const Cache *cache, Cache_Kernel kernel)
+{
+    return kernel != GENERIC_KERNEL ? kernelShapes[kernel].num_ways : cache->num_ways;
+}
+
+static inline __attribute__((always_inline))
+unsigned kernelShift(const Cache *cache, Cache_Kernel kernel)
+{
+    return kernel != GENERIC_KERNEL ? kernelShapes[kernel].set_shift : cache->set_shift;
+}
+
+static inline __attribute__((always_inline))
+uint32_t kernelSet(const Cache *cache, Cache_Kernel kernel, uint64_t addr)
+{
+    if (kernel != GENERIC_KERNEL)
+    {
+        return (addr >> kernelShapes[kernel].set_shift) & cache->set_mask;
+    }
+    return getSet(cache, addr);
+}
+
+static inline __attribute__((always_inline))
+Cache_Block *findBlockTyped(Cache *cache, Cache_Kernel kernel, uint64_t addr);
+static inline __attribute__((always_inline))
+bool lruTyped(Cache *cache, Cache_Kernel kernel, uint64_t addr, Cache_Block **victim_blk,
+              uint64_t *wb_addr);
+static inline __attribute__((always_inline))
+bool lfuTyped(Cache *cache, Cache_Kernel kernel, uint64_t addr, Cache_Block **victim_blk,
+              uint64_t *wb_addr);
+static inline __attribute__((always_inline))
+bool srripTyped(Cache *cache, Cache_Kernel kernel, uint64_t addr, Cache_Block **victim_blk,
+                uint64_t *wb_addr);
+static inline __attribute__((always_inline))
+bool beladyTyped(Cache *cache, Cache_Kernel kernel, uint64_t addr, Cache_Block **victim_blk,
+                 uint64_t *wb_addr);
+static inline __attribute__((always_inline))
+bool hawkeyeTyped(Cache *cache, Cache_Kernel kernel, uint64_t addr, Cache_Block **victim_blk,
+                  uint64_t *wb_addr);
+
+// The policy hooks: the update of a block hit, the choice of a victim and
+// the update of a block inserted. Each takes the policy as an argument so
+// that accessTyped() and insertTyped(), inlined with a constant one and a
+// constant kernel, make a copy of the cache per policy and geometry with no
+// dispatch left inside.
+
+static inline __attribute__((always_inline))
+void hitUpdate(Cache *cache, Replacement_Policy policy, Cache_Block *blk, unsigned sig)
+{
+    switch (policy)
+    {
+        case SRRIP_POLICY:
+            setZeroCounter(&(blk->RRPV));
+            break;
+        case SHIP_POLICY:
+            blk->outcome = true;
+            blk->sig = shipSignature(blk->PC);
+            updateCounter(&(cache->SHCT), blk->sig, true);
+            setZeroCounter(&(blk->RRPV));
+            break;
+        case HAWKEYE_POLICY:
+            blk->sig = sig;
+            if (hawkeyeFriendly(cache->hawkeye, sig))
+            {
+                setZeroCounter(&(blk->RRPV));
+            }
+            else
+            {
+                blk->RRPV.counter = blk->RRPV.max_val;
+            }
+            break;
+        default: // LRU, LFU and Belady go by the fields every block keeps
+            break;
+    }
+}
+
+static inline __attribute__((always_inline))
+bool selectVictim(Cache *cache, Replacement_Policy policy, Cache_Kernel kernel, uint64_t addr,
+                  Cache_Block **victim, uint64_t *wb_addr)
+{
+    switch (policy)
+    {
+        case LRU_POLICY:
+            return lruTyped(cache, kernel, addr, victim, wb_addr);
+        case LFU_POLICY:
+            return lfuTyped(cache, kernel, addr, victim, wb_addr);
+        case SRRIP_POLICY:
+        case SHIP_POLICY:
+            return srripTyped(cache, kernel, addr, victim, wb_addr);
+        case BELADY_POLICY:
+            return beladyTyped(cache, kernel, addr, victim, wb_addr);
+        case HAWKEYE_POLICY:
+            return hawkeyeTyped(cache, kernel, addr, victim, wb_addr);
+    }
+    return false;
+}
+
+static inline __attribute__((always_inline))
+void insertUpdate(Cache *cache, Replacement_Policy policy, Cache_Block *victim, const Request *req,
+                  uint64_t blk_aligned_addr)
+{
+    if (policy == SRRIP_POLICY)
+    {
+        // A long re-reference interval, one short of distant
+        victim->RRPV.counter = victim->RRPV.max_val - 1;
+    }
+    else if (policy == SHIP_POLICY)
+    {
+        // Train on the outcome of the block leaving, then predict the new one
+        victim->sig = shipSignature(victim->PC);
+        if (victim->outcome != true)
+        {
+            updateCounter(&(cache->SHCT), victim->sig, false);
+        }
+        victim->outcome = false;
+        victim->sig = shipSignature(req->PC);
+        if (getCounter(&(cache->SHCT), victim->sig) == 0)
+        {
+            victim->RRPV.counter = victim->RRPV.max_val;
+        }
+        else
+        {
+            victim->RRPV.counter = victim->RRPV.max_val - 1;
+        }
+    }
+    else if (policy == HAWKEYE_POLICY)
+    {
+        victim->sig = hawkeyeSignature(req->PC);
+        if (hawkeyeFriendly(cache->hawkeye, victim->sig))
+        {
+            // Age the other cache-friendly blocks, short of cache-averse
+            uint64_t set_idx = getSet(cache, blk_aligned_addr);
+            Cache_Block **ways = cache->sets[set_idx].ways;
+            unsigned i;
+            for (i = 0; i < cache->num_ways; i++)
+            {
+                if (ways[i]->RRPV.counter + 1 < ways[i]->RRPV.max_val)
+                {
+                    incrementCounter(&(ways[i]->RRPV));
+                }
+            }
+            setZeroCounter(&(victim->RRPV));
+        }
+        else
+        {
+            victim->RRPV.counter = victim->RRPV.max_val;
+        }
+    }
+}
+
+static inline __attribute__((always_inline))
+bool accessTyped(Cache *cache, Replacement_Policy policy, Cache_Kernel kernel, Request *req,
+                 uint64_t access_time)
 {
     bool hit = false;
 
     uint64_t blk_aligned_addr = blkAlign(req->load_or_store_addr, cache->blk_mask);
 
-    Cache_Block *blk = findBlock(cache, blk_aligned_addr);
+    unsigned sig = 0;
+    if (policy == HAWKEYE_POLICY)
+    {
+        // OPTgen sees every access to the sampled sets
+        sig = hawkeyeSignature(req->PC);
+        hawkeyeAccess(cache->hawkeye, getSet(cache, blk_aligned_addr),
+                      blk_aligned_addr >> cache->set_shift, sig);
+    }
+
+    Cache_Block *blk = findBlockTyped(cache, kernel, blk_aligned_addr);
    
     if (blk != NULL) 
     {
         hit = true;
-		blk->outcome = true;
-		blk->sig = blk->PC & (cache_size - 1);
-		incrementCounter(&(cache->SHCT[blk->sig]));
-		setZeroCounter(&(blk->RRPV));
+        hitUpdate(cache, policy, blk, sig);
 
         // Update access time	
         blk->when_touched = access_time;
+        blk->next_use = req->next_use;
         // Increment frequency counter
         ++blk->frequency;
 
@@ -115,47 +586,28 @@ bool accessBlock(Cache *cache, Request *req, uint64_t access_time)
     return hit;
 }
 
-bool insertBlock(Cache *cache, Request *req, uint64_t access_time, uint64_t *wb_addr)
+static inline __attribute__((always_inline))
+bool insertTyped(Cache *cache, Replacement_Policy policy, Cache_Kernel kernel, Request *req,
+                 uint64_t access_time, uint64_t *wb_addr)
 {
     // Step one, find a victim block
     uint64_t blk_aligned_addr = blkAlign(req->load_or_store_addr, cache->blk_mask);
 
     Cache_Block *victim = NULL;
-    #ifdef LRU
-        bool wb_required = lru(cache, blk_aligned_addr, &victim, wb_addr);
-    #endif
-	#ifdef LFU
-		bool wb_required = lfu(cache, blk_aligned_addr, &victim, wb_addr);
-	#endif
-	#ifdef SRRIP
-		bool wb_required = srrip(cache, blk_aligned_addr, &victim, wb_addr);
-	#endif
+    bool wb_required = selectVictim(cache, policy, kernel, blk_aligned_addr, &victim, wb_addr);
     assert(victim != NULL);
 
     // Step two, insert the new block
-    #ifdef SRRIP
-	victim->sig = victim->PC & (cache_size - 1);
-	if (victim->outcome != true)
-	{
-		decrementCounter(&(cache->SHCT[victim->sig]));
-	}
-	victim->outcome = false;
-	victim->sig = req->PC & (cache_size - 1);
-	if (checkZero(&(cache->SHCT[victim->sig])))
-	{
-		setTwoCounter(&(victim->RRPV));
-		incrementCounter(&(victim->RRPV));
-	}
-	else
-	{
-		setTwoCounter(&(victim->RRPV));
-	}
-	#endif
-    uint64_t tag = req->load_or_store_addr >> cache->tag_shift;
+    insertUpdate(cache, policy, victim, req, blk_aligned_addr);
+
+    uint64_t tag = req->load_or_store_addr >> kernelShift(cache, kernel);
     victim->tag = tag;
     victim->valid = true;
+    victim->PC = req->PC;
+    victim->core_id = req->core_id;
 
     victim->when_touched = access_time;
+    victim->next_use = req->next_use;
     ++victim->frequency;
 
     if (req->req_type == STORE)
@@ -167,27 +619,244 @@ bool insertBlock(Cache *cache, Request *req, uint64_t access_time, uint64_t *wb_
 //    printf("Inserted: %"PRIu64"\n", req->load_or_store_addr);
 }
 
+// accessTyped() and insertTyped() in the kernel of the cache, for the
+// policies that have specialized ones
+static inline __attribute__((always_inline))
+bool accessKernel(Cache *cache, Replacement_Policy policy, Request *req, uint64_t access_time)
+{
+    switch (cache->kernel)
+    {
+        case WAYS_4_KERNEL:
+            return accessTyped(cache, policy, WAYS_4_KERNEL, req, access_time);
+        case WAYS_8_KERNEL:
+            return accessTyped(cache, policy, WAYS_8_KERNEL, req, access_time);
+        case WAYS_16_KERNEL:
+            return accessTyped(cache, policy, WAYS_16_KERNEL, req, access_time);
+        default:
+            return accessTyped(cache, policy, GENERIC_KERNEL, req, access_time);
+    }
+}
+
+static inline __attribute__((always_inline))
+bool insertKernel(Cache *cache, Replacement_Policy policy, Request *req, uint64_t access_time,
+                  uint64_t *wb_addr)
+{
+    switch (cache->kernel)
+    {
+        case WAYS_4_KERNEL:
+            return insertTyped(cache, policy, WAYS_4_KERNEL, req, access_time, wb_addr);
+        case WAYS_8_KERNEL:
+            return insertTyped(cache, policy, WAYS_8_KERNEL, req, access_time, wb_addr);
+        case WAYS_16_KERNEL:
+            return insertTyped(cache, policy, WAYS_16_KERNEL, req, access_time, wb_addr);
+        default:
+            return insertTyped(cache, policy, GENERIC_KERNEL, req, access_time, wb_addr);
+    }
+}
+
+bool accessBlock(Cache *cache, Request *req, uint64_t access_time)
+{
+    switch (cache->policy)
+    {
+        case LRU_POLICY:
+            return accessKernel(cache, LRU_POLICY, req, access_time);
+        case LFU_POLICY:
+            return accessKernel(cache, LFU_POLICY, req, access_time);
+        case SRRIP_POLICY:
+            return accessKernel(cache, SRRIP_POLICY, req, access_time);
+        case SHIP_POLICY:
+            return accessKernel(cache, SHIP_POLICY, req, access_time);
+        case BELADY_POLICY:
+            return accessTyped(cache, BELADY_POLICY, GENERIC_KERNEL, req, access_time);
+        case HAWKEYE_POLICY:
+            return accessTyped(cache, HAWKEYE_POLICY, GENERIC_KERNEL, req, access_time);
+    }
+    return false;
+}
+
+bool insertBlock(Cache *cache, Request *req, uint64_t access_time, uint64_t *wb_addr)
+{
+    switch (cache->policy)
+    {
+        case LRU_POLICY:
+            return insertKernel(cache, LRU_POLICY, req, access_time, wb_addr);
+        case LFU_POLICY:
+            return insertKernel(cache, LFU_POLICY, req, access_time, wb_addr);
+        case SRRIP_POLICY:
+            return insertKernel(cache, SRRIP_POLICY, req, access_time, wb_addr);
+        case SHIP_POLICY:
+            return insertKernel(cache, SHIP_POLICY, req, access_time, wb_addr);
+        case BELADY_POLICY:
+            return insertTyped(cache, BELADY_POLICY, GENERIC_KERNEL, req, access_time, wb_addr);
+        case HAWKEYE_POLICY:
+            return insertTyped(cache, HAWKEYE_POLICY, GENERIC_KERNEL, req, access_time, wb_addr);
+    }
+    return false;
+}
+
+// accessCache() with a constant policy and kernel
+static inline __attribute__((always_inline))
+bool accessCacheTyped(Cache *cache, Replacement_Policy policy, Cache_Kernel kernel, uint64_t PC,
+                      uint64_t addr, bool store, int core_id)
+{
+    Request req;
+    req.req_type = store ? STORE : LOAD;
+    req.load_or_store_addr = addr;
+    req.PC = PC;
+    req.core_id = core_id;
+    req.next_use = no_next_use;
+
+    bool hit = accessTyped(cache, policy, kernel, &req, cache->time);
+    if (hit)
+    {
+        ++cache->hits;
+    }
+    else
+    {
+        uint64_t wb_addr;
+        insertTyped(cache, policy, kernel, &req, cache->time, &wb_addr);
+    }
+    ++cache->time;
+
+    return hit;
+}
+
+static inline __attribute__((always_inline))
+bool accessCacheKernel(Cache *cache, Replacement_Policy policy, uint64_t PC, uint64_t addr,
+                       bool store, int core_id)
+{
+    switch (cache->kernel)
+    {
+        case WAYS_4_KERNEL:
+            return accessCacheTyped(cache, policy, WAYS_4_KERNEL, PC, addr, store, core_id);
+        case WAYS_8_KERNEL:
+            return accessCacheTyped(cache, policy, WAYS_8_KERNEL, PC, addr, store, core_id);
+        case WAYS_16_KERNEL:
+            return accessCacheTyped(cache, policy, WAYS_16_KERNEL, PC, addr, store, core_id);
+        default:
+            return accessCacheTyped(cache, policy, GENERIC_KERNEL, PC, addr, store, core_id);
+    }
+}
+
+bool accessCache(Cache *cache, uint64_t PC, uint64_t addr, bool store, int core_id)
+{
+    switch (cache->policy)
+    {
+        case LRU_POLICY:
+            return accessCacheKernel(cache, LRU_POLICY, PC, addr, store, core_id);
+        case LFU_POLICY:
+            return accessCacheKernel(cache, LFU_POLICY, PC, addr, store, core_id);
+        case SRRIP_POLICY:
+            return accessCacheKernel(cache, SRRIP_POLICY, PC, addr, store, core_id);
+        case SHIP_POLICY:
+            return accessCacheKernel(cache, SHIP_POLICY, PC, addr, store, core_id);
+        case BELADY_POLICY:
+            return accessCacheTyped(cache, BELADY_POLICY, GENERIC_KERNEL, PC, addr, store,
+                                    core_id);
+        case HAWKEYE_POLICY:
+            return accessCacheTyped(cache, HAWKEYE_POLICY, GENERIC_KERNEL, PC, addr, store,
+                                    core_id);
+    }
+    return false;
+}
+
+// accessCacheBatch() for one policy and kernel, inlined once per kernel
+static inline __attribute__((always_inline))
+uint64_t accessCacheBatchTyped(Cache *cache, Replacement_Policy policy, Cache_Kernel kernel,
+                               const uint64_t *pcs, const uint64_t *addrs, const uint8_t *stores,
+                               unsigned count, uint8_t *hit_out)
+{
+    uint64_t num_hits = 0;
+    unsigned i;
+    for (i = 0; i < count; i++)
+    {
+        bool hit = accessCacheTyped(cache, policy, kernel, pcs[i], addrs[i],
+                                    stores != NULL && stores[i], 0);
+
+        hit_out[i] = hit;
+        num_hits += hit;
+    }
+    return num_hits;
+}
+
+static inline __attribute__((always_inline))
+uint64_t accessCacheBatchKernel(Cache *cache, Replacement_Policy policy, const uint64_t *pcs,
+                                const uint64_t *addrs, const uint8_t *stores, unsigned count,
+                                uint8_t *hit_out)
+{
+    switch (cache->kernel)
+    {
+        case WAYS_4_KERNEL:
+            return accessCacheBatchTyped(cache, policy, WAYS_4_KERNEL, pcs, addrs, stores, count,
+                                         hit_out);
+        case WAYS_8_KERNEL:
+            return accessCacheBatchTyped(cache, policy, WAYS_8_KERNEL, pcs, addrs, stores, count,
+                                         hit_out);
+        case WAYS_16_KERNEL:
+            return accessCacheBatchTyped(cache, policy, WAYS_16_KERNEL, pcs, addrs, stores, count,
+                                         hit_out);
+        default:
+            return accessCacheBatchTyped(cache, policy, GENERIC_KERNEL, pcs, addrs, stores, count,
+                                         hit_out);
+    }
+}
+
+uint64_t accessCacheBatch(Cache *cache, const uint64_t *pcs, const uint64_t *addrs,
+                          const uint8_t *stores, unsigned count, uint8_t *hit_out)
+{
+    switch (cache->policy)
+    {
+        case LRU_POLICY:
+            return accessCacheBatchKernel(cache, LRU_POLICY, pcs, addrs, stores, count, hit_out);
+        case LFU_POLICY:
+            return accessCacheBatchKernel(cache, LFU_POLICY, pcs, addrs, stores, count, hit_out);
+        case SRRIP_POLICY:
+            return accessCacheBatchKernel(cache, SRRIP_POLICY, pcs, addrs, stores, count, hit_out);
+        case SHIP_POLICY:
+            return accessCacheBatchKernel(cache, SHIP_POLICY, pcs, addrs, stores, count, hit_out);
+        case BELADY_POLICY:
+            return accessCacheBatchTyped(cache, BELADY_POLICY, GENERIC_KERNEL, pcs, addrs, stores,
+                                         count, hit_out);
+        case HAWKEYE_POLICY:
+            return accessCacheBatchTyped(cache, HAWKEYE_POLICY, GENERIC_KERNEL, pcs, addrs, stores,
+                                         count, hit_out);
+    }
+    return 0;
+}
+
+void getCacheStats(const Cache *cache, Cache_Stats *stats)
+{
+    stats->accesses = cache->time;
+    stats->hits = cache->hits;
+    stats->misses = cache->time - cache->hits;
+    stats->evictions = cache->evictions;
+    stats->writebacks = cache->writebacks;
+}
+
 // Helper Functions
 inline uint64_t blkAlign(uint64_t addr, uint64_t mask)
 {
     return addr & ~mask;
 }
 
-Cache_Block *findBlock(Cache *cache, uint64_t addr)
+static inline __attribute__((always_inline))
+Cache_Block *findBlockTyped(Cache *cache, Cache_Kernel kernel, uint64_t addr)
 {
 //    printf("Addr: %"PRIu64"\n", addr);
 
-    // Extract tag
-    uint64_t tag = addr >> cache->tag_shift;
+    // Extract tag, the whole block number
+    uint64_t tag = addr >> kernelShift(cache, kernel);
 //    printf("Tag: %"PRIu64"\n", tag);
 
     // Extract set index
-    uint64_t set_idx = (addr >> cache->set_shift) & cache->set_mask;
+    uint64_t set_idx = kernelSet(cache, kernel, addr);
 //    printf("Set: %"PRIu64"\n", set_idx);
 
     Cache_Block **ways = cache->sets[set_idx].ways;
-    int i;
-    for (i = 0; i < cache->num_ways; i++)
+    unsigned num_ways = kernelWays(cache, kernel);
+    unsigned i;
+    #pragma GCC unroll 16
+    for (i = 0; i < num_ways; i++)
     {
         if (tag == ways[i]->tag && ways[i]->valid == true)
         {
@@ -198,15 +867,19 @@ Cache_Block *findBlock(Cache *cache, uint64_t addr)
     return NULL;
 }
 
-bool lru(Cache *cache, uint64_t addr, Cache_Block **victim_blk, uint64_t *wb_addr)
+static inline __attribute__((always_inline))
+bool lruTyped(Cache *cache, Cache_Kernel kernel, uint64_t addr, Cache_Block **victim_blk,
+              uint64_t *wb_addr)
 {
-    uint64_t set_idx = (addr >> cache->set_shift) & cache->set_mask;
+    uint64_t set_idx = kernelSet(cache, kernel, addr);
     //    printf("Set: %"PRIu64"\n", set_idx);
     Cache_Block **ways = cache->sets[set_idx].ways;
+    unsigned num_ways = kernelWays(cache, kernel);
 
     // Step one, try to find an invalid block.
-    int i;
-    for (i = 0; i < cache->num_ways; i++)
+    unsigned i;
+    #pragma GCC unroll 16
+    for (i = 0; i < num_ways; i++)
     {
         if (ways[i]->valid == false)
         {
@@ -217,7 +890,7 @@ bool lru(Cache *cache, uint64_t addr, Cache_Block **victim_blk, uint64_t *wb_add
 
     // Step two, if there is no invalid block. Locate the LRU block
     Cache_Block *victim = ways[0];
-    for (i = 1; i < cache->num_ways; i++)
+    for (i = 1; i < num_ways; i++)
     {
         if (ways[i]->when_touched < victim->when_touched)
         {
@@ -226,10 +899,13 @@ bool lru(Cache *cache, uint64_t addr, Cache_Block **victim_blk, uint64_t *wb_add
     }
 
     // Step three, need to write-back the victim block
-    *wb_addr = (victim->tag << cache->tag_shift) | (victim->set << cache->set_shift);
-//    uint64_t ori_addr = (victim->tag << cache->tag_shift) | (victim->set << cache->set_shift);
+    *wb_addr = victim->tag << kernelShift(cache, kernel);
+//    uint64_t ori_addr = victim->tag << cache->set_shift;
 //    printf("Evicted: %"PRIu64"\n", ori_addr);
 
+    ++cache->evictions;
+    cache->writebacks += victim->dirty;
+
     // Step three, invalidate victim
     victim->tag = UINTMAX_MAX;
     victim->valid = false;
@@ -242,15 +918,19 @@ bool lru(Cache *cache, uint64_t addr, Cache_Block **victim_blk, uint64_t *wb_add
     return true; // Need to write-back
 }
 
-bool lfu(Cache *cache, uint64_t addr, Cache_Block **victim_blk, uint64_t *wb_addr)
+static inline __attribute__((always_inline))
+bool lfuTyped(Cache *cache, Cache_Kernel kernel, uint64_t addr, Cache_Block **victim_blk,
+              uint64_t *wb_addr)
 {
-    uint64_t set_idx = (addr >> cache->set_shift) & cache->set_mask;
+    uint64_t set_idx = kernelSet(cache, kernel, addr);
     //    printf("Set: %"PRIu64"\n", set_idx);
     Cache_Block **ways = cache->sets[set_idx].ways;
+    unsigned num_ways = kernelWays(cache, kernel);
 
     // Step one, try to find an invalid block.
-    int i;
-    for (i = 0; i < cache->num_ways; i++)
+    unsigned i;
+    #pragma GCC unroll 16
+    for (i = 0; i < num_ways; i++)
     {
         if (ways[i]->valid == false)
         {
@@ -261,7 +941,7 @@ bool lfu(Cache *cache, uint64_t addr, Cache_Block **victim_blk, uint64_t *wb_add
 
     // Step two, if there is no invalid block. Locate the LRU block
     Cache_Block *victim = ways[0];
-    for (i = 1; i < cache->num_ways; i++)
+    for (i = 1; i < num_ways; i++)
     {
         if (ways[i]->frequency < victim->frequency)
         {
@@ -270,10 +950,13 @@ bool lfu(Cache *cache, uint64_t addr, Cache_Block **victim_blk, uint64_t *wb_add
     }
 
     // Step three, need to write-back the victim block
-    *wb_addr = (victim->tag << cache->tag_shift) | (victim->set << cache->set_shift);
-//    uint64_t ori_addr = (victim->tag << cache->tag_shift) | (victim->set << cache->set_shift);
+    *wb_addr = victim->tag << kernelShift(cache, kernel);
+//    uint64_t ori_addr = victim->tag << cache->set_shift;
 //    printf("Evicted: %"PRIu64"\n", ori_addr);
 
+    ++cache->evictions;
+    cache->writebacks += victim->dirty;
+
     // Step three, invalidate victim
     victim->tag = UINTMAX_MAX;
     victim->valid = false;
@@ -286,15 +969,19 @@ bool lfu(Cache *cache, uint64_t addr, Cache_Block **victim_blk, uint64_t *wb_add
     return true; // Need to write-back
 }
 
-bool srrip(Cache *cache, uint64_t addr, Cache_Block **victim_blk, uint64_t *wb_addr)
+static inline __attribute__((always_inline))
+bool srripTyped(Cache *cache, Cache_Kernel kernel, uint64_t addr, Cache_Block **victim_blk,
+                uint64_t *wb_addr)
 {
-    uint64_t set_idx = (addr >> cache->set_shift) & cache->set_mask;
+    uint64_t set_idx = kernelSet(cache, kernel, addr);
     //    printf("Set: %"PRIu64"\n", set_idx);
     Cache_Block **ways = cache->sets[set_idx].ways;
+    unsigned num_ways = kernelWays(cache, kernel);
 
     // Step one, try to find an invalid block.
-    int i;
-    for (i = 0; i < cache->num_ways; i++)
+    unsigned i;
+    #pragma GCC unroll 16
+    for (i = 0; i < num_ways; i++)
     {
         if (ways[i]->valid == false)
         {
@@ -307,9 +994,10 @@ bool srrip(Cache *cache, uint64_t addr, Cache_Block **victim_blk, uint64_t *wb_a
 	bool found = false;
     for (;;)
 	{
-        for (i = 0; i < cache->num_ways; i++)
+        #pragma GCC unroll 16
+        for (i = 0; i < num_ways; i++)
         {
-            if (checkThree(&(ways[i]->RRPV)))
+            if (ways[i]->RRPV.counter == ways[i]->RRPV.max_val)
             {
                 victim = ways[i];
 				found = true;
@@ -317,17 +1005,21 @@ bool srrip(Cache *cache, uint64_t addr, Cache_Block **victim_blk, uint64_t *wb_a
             }
         }
 		if (found) {break;}
-        for (i = 0; i < cache->num_ways; i++)
+        #pragma GCC unroll 16
+        for (i = 0; i < num_ways; i++)
         {
 			incrementCounter(&(ways[i]->RRPV));
         }
     }
 	
     // Step three, need to write-back the victim block
-    *wb_addr = (victim->tag << cache->tag_shift) | (victim->set << cache->set_shift);
-//    uint64_t ori_addr = (victim->tag << cache->tag_shift) | (victim->set << cache->set_shift);
+    *wb_addr = victim->tag << kernelShift(cache, kernel);
+//    uint64_t ori_addr = victim->tag << cache->set_shift;
 //    printf("Evicted: %"PRIu64"\n", ori_addr);
 
+    ++cache->evictions;
+    cache->writebacks += victim->dirty;
+
     // Step three, invalidate victim
     victim->tag = UINTMAX_MAX;
     victim->valid = false;
@@ -340,6 +1032,142 @@ bool srrip(Cache *cache, uint64_t addr, Cache_Block **victim_blk, uint64_t *wb_a
     return true; // Need to write-back
 }
 
+// Belady's MIN: replace the block referenced again furthest in the future.
+// Needs Request::next_use, see Next_Use.h.
+static inline __attribute__((always_inline))
+bool beladyTyped(Cache *cache, Cache_Kernel kernel, uint64_t addr, Cache_Block **victim_blk,
+                 uint64_t *wb_addr)
+{
+    uint64_t set_idx = kernelSet(cache, kernel, addr);
+    Cache_Block **ways = cache->sets[set_idx].ways;
+    unsigned num_ways = kernelWays(cache, kernel);
+
+    // Step one, try to find an invalid block.
+    unsigned i;
+    #pragma GCC unroll 16
+    for (i = 0; i < num_ways; i++)
+    {
+        if (ways[i]->valid == false)
+        {
+            *victim_blk = ways[i];
+            return false; // No need to write-back
+        }
+    }
+
+    // Step two, locate the block with the furthest next use
+    Cache_Block *victim = ways[0];
+    for (i = 1; i < num_ways; i++)
+    {
+        if (ways[i]->next_use > victim->next_use)
+        {
+            victim = ways[i];
+        }
+    }
+
+    // Step three, need to write-back the victim block
+    *wb_addr = victim->tag << kernelShift(cache, kernel);
+
+    ++cache->evictions;
+    cache->writebacks += victim->dirty;
+
+    // Step three, invalidate victim
+    victim->tag = UINTMAX_MAX;
+    victim->valid = false;
+    victim->dirty = false;
+    victim->frequency = 0;
+    victim->when_touched = 0;
+
+    *victim_blk = victim;
+
+    return true; // Need to write-back
+}
+
+// Hawkeye: replace a cache-averse block (RRPV at its maximum) if there is
+// one, else the oldest cache-friendly block, and detrain the PC that
+// predicted it friendly
+static inline __attribute__((always_inline))
+bool hawkeyeTyped(Cache *cache, Cache_Kernel kernel, uint64_t addr, Cache_Block **victim_blk,
+                  uint64_t *wb_addr)
+{
+    uint64_t set_idx = kernelSet(cache, kernel, addr);
+    Cache_Block **ways = cache->sets[set_idx].ways;
+    unsigned num_ways = kernelWays(cache, kernel);
+
+    // Step one, try to find an invalid block.
+    unsigned i;
+    #pragma GCC unroll 16
+    for (i = 0; i < num_ways; i++)
+    {
+        if (ways[i]->valid == false)
+        {
+            *victim_blk = ways[i];
+            return false; // No need to write-back
+        }
+    }
+
+    // Step two, locate the block with the highest RRPV
+    Cache_Block *victim = ways[0];
+    for (i = 1; i < num_ways; i++)
+    {
+        if (ways[i]->RRPV.counter > victim->RRPV.counter)
+        {
+            victim = ways[i];
+        }
+    }
+    if (victim->RRPV.counter < victim->RRPV.max_val)
+    {
+        hawkeyeDetrain(cache->hawkeye, set_idx, victim->sig);
+    }
+
+    // Step three, need to write-back the victim block
+    *wb_addr = victim->tag << kernelShift(cache, kernel);
+
+    ++cache->evictions;
+    cache->writebacks += victim->dirty;
+
+    // Step three, invalidate victim
+    victim->tag = UINTMAX_MAX;
+    victim->valid = false;
+    victim->dirty = false;
+    victim->frequency = 0;
+    victim->when_touched = 0;
+
+    *victim_blk = victim;
+
+    return true; // Need to write-back
+}
+
+// The generic kernel, outside the access path
+Cache_Block *findBlock(Cache *cache, uint64_t addr)
+{
+    return findBlockTyped(cache, GENERIC_KERNEL, addr);
+}
+
+bool lru(Cache *cache, uint64_t addr, Cache_Block **victim_blk, uint64_t *wb_addr)
+{
+    return lruTyped(cache, GENERIC_KERNEL, addr, victim_blk, wb_addr);
+}
+
+bool lfu(Cache *cache, uint64_t addr, Cache_Block **victim_blk, uint64_t *wb_addr)
+{
+    return lfuTyped(cache, GENERIC_KERNEL, addr, victim_blk, wb_addr);
+}
+
+bool srrip(Cache *cache, uint64_t addr, Cache_Block **victim_blk, uint64_t *wb_addr)
+{
+    return srripTyped(cache, GENERIC_KERNEL, addr, victim_blk, wb_addr);
+}
+
+bool belady(Cache *cache, uint64_t addr, Cache_Block **victim_blk, uint64_t *wb_addr)
+{
+    return beladyTyped(cache, GENERIC_KERNEL, addr, victim_blk, wb_addr);
+}
+
+bool hawkeye(Cache *cache, uint64_t addr, Cache_Block **victim_blk, uint64_t *wb_addr)
+{
+    return hawkeyeTyped(cache, GENERIC_KERNEL, addr, victim_blk, wb_addr);
+}
+
 inline void initSatCounter(Sat_Counter *sat_counter, unsigned counter_bits)
 {
     sat_counter->counter_bits = counter_bits;
@@ -10,12 +10,11 @@
 #include <stdint.h>
 
 #include "Cache_Blk.h"
+#include "cachesim.h"
+#include "Counter_Table.h"
+#include "Hawkeye.h"
 #include "Request.h"
 
-//#define LRU
-//#define LFU
-#define SRRIP
-
 /* Cache */
 typedef struct Set
 {
@@ -23,7 +22,29 @@ typedef struct Set
 }Set;
 
 
-typedef struct Cache
+#define ship_signature_bits 14 // log2 of the SHCT size
+#define ship_counter_bits 2
+
+// Access kernels. Every policy but Belady and Hawkeye has a copy of the
+// access and insert path specialized for a few common geometries, with
+// the ways and the block size constant and the sets a power of two picked
+// by a mask: the shifts are immediates and the way loops that stop at a
+// match unroll fully. The searches for the least recent or least frequent
+// way are left to the compiler, which keeps them branch-free. initCache()
+// picks a kernel, else the generic one reads the geometry from the cache;
+// `Bench --check-kernels` holds them all to the generic one.
+typedef enum Cache_Kernel{GENERIC_KERNEL, WAYS_4_KERNEL, WAYS_8_KERNEL, WAYS_16_KERNEL}Cache_Kernel;
+
+#define num_kernels 4
+
+// The geometry of a kernel; num_ways 0 for the generic one
+typedef struct Kernel_Shape
+{
+    unsigned num_ways;
+    unsigned set_shift;
+}Kernel_Shape;
+
+struct Cache
 {
     uint64_t blk_mask;
     unsigned num_blocks;
@@ -34,19 +55,33 @@ typedef struct Cache
     unsigned num_sets; // Number of sets
     unsigned num_ways; // Number of ways within a set
 
-    unsigned set_shift;
-    unsigned set_mask; // To extract set index
-    unsigned tag_shift; // To extract tag
+    unsigned set_shift; // To extract the block number, which is also the tag
+    Set_Index set_index;
+    unsigned index_bits; // Bits of the block number folded together by XOR_INDEX
+    uint64_t set_mask; // To extract set index, if num_sets is a power of two
+    __uint128_t set_magic; // Else for fastMod()
 
     Set *sets; // All the sets of a cache
 
-	Sat_Counter *SHCT;
+	Counter_Table SHCT; // SHiP signature history counters
 	//Sat_Counter *srrip;
+
+    uint64_t evictions; // Valid blocks replaced
+    uint64_t writebacks; // Dirty blocks replaced
+
+    uint64_t time; // Accesses through accessCache() so far
+    uint64_t hits; // Of those
+
+    Replacement_Policy policy;
+    unsigned rrpv_bits;
+    Cache_Kernel kernel; // Of the geometry, whatever the policy
+    Hawkeye *hawkeye; // Hawkeye state, used with HAWKEYE_POLICY
+
+    Arena arena; // Holds the cache, its blocks, sets, SHCT and Hawkeye state
     
-}Cache;
+};
 
 // Function Definitions
-Cache *initCache();
 bool accessBlock(Cache *cache, Request *req, uint64_t access_time);
 bool insertBlock(Cache *cache, Request *req, uint64_t access_time, uint64_t *wb_addr);
 
@@ -54,9 +89,43 @@ bool insertBlock(Cache *cache, Request *req, uint64_t access_time, uint64_t *wb_
 uint64_t blkAlign(uint64_t addr, uint64_t mask);
 Cache_Block *findBlock(Cache *cache, uint64_t addr);
 
+// x % d without a division, given magic = UINT128_MAX / d + 1 (Lemire,
+// Kaser and Kurz, "Faster Remainder by Direct Computation", 2019)
+static inline uint32_t fastMod(uint64_t x, __uint128_t magic, uint32_t d)
+{
+    __uint128_t low = magic * x;
+    __uint128_t bottom = ((low & UINT64_MAX) * d) >> 64;
+    __uint128_t top = (low >> 64) * d;
+    return (bottom + top) >> 64;
+}
+
+static inline uint32_t getSet(const Cache *cache, uint64_t addr)
+{
+    uint64_t block = addr >> cache->set_shift;
+    if (cache->set_index == XOR_INDEX)
+    {
+        // Fold the whole block number, so that strides of num_sets spread out
+        uint64_t folded = 0;
+        for (; block != 0; block >>= cache->index_bits)
+        {
+            folded ^= block & ((1ull << cache->index_bits) - 1);
+        }
+        block = folded;
+    }
+    return cache->set_magic == 0 ? block & cache->set_mask :
+                                   fastMod(block, cache->set_magic, cache->num_sets);
+}
+
+static inline unsigned shipSignature(uint64_t PC)
+{
+    return (PC * 0x9E3779B97F4A7C15ull) >> (64 - ship_signature_bits);
+}
+
 // Replacement Policies
 bool lru(Cache *cache, uint64_t addr, Cache_Block **victim_blk, uint64_t *wb_addr);
 bool lfu(Cache *cache, uint64_t addr, Cache_Block **victim_blk, uint64_t *wb_addr);
 bool srrip(Cache *cache, uint64_t addr, Cache_Block **victim_blk, uint64_t *wb_addr);
+bool belady(Cache *cache, uint64_t addr, Cache_Block **victim_blk, uint64_t *wb_addr);
+bool hawkeye(Cache *cache, uint64_t addr, Cache_Block **victim_blk, uint64_t *wb_addr);
 
 #endif
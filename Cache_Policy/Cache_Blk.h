@@ -36,6 +36,9 @@ typedef struct Cache_Block
 	bool outcome;
 	unsigned RRPV_idx;
 	Sat_Counter RRPV;
+
+    // Belady
+    uint64_t next_use; // Record of the next reference to this block
 	
 }Cache_Block;
 
@@ -0,0 +1,63 @@
+#ifndef __CACHE_CONFIG_HH__
+#define __CACHE_CONFIG_HH__
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Arena.h"
+
+// The functions libcachesim exports (see cachesim.h)
+#ifndef CACHESIM_API
+#define CACHESIM_API __attribute__((visibility("default")))
+#endif
+
+// Cache geometry and replacement policy, picked at run time, on the
+// command line or in a config file of the same options (see
+// parseCacheOption()).
+//
+// The number of sets is cache_size / (block_size x assoc) unless given
+// directly, and need not be a power of two: 12- and 20-way slices usually
+// are not. Kept apart from Cache.h so that code using the Branch_Predictor
+// trace, whose LOAD and STORE clash with Request.h, can configure a cache.
+
+// How a block number picks its set
+typedef enum Set_Index{MODULO_INDEX, XOR_INDEX}Set_Index;
+
+// Replacement policies, by name: lru, lfu, srrip, ship, belady and hawkeye.
+// SRRIP inserts at a long re-reference interval; SHiP picks the same
+// victims but inserts at a distant one the blocks of PCs whose blocks went
+// unreused.
+typedef enum Replacement_Policy{LRU_POLICY, LFU_POLICY, SRRIP_POLICY, SHIP_POLICY, BELADY_POLICY,
+                                HAWKEYE_POLICY}Replacement_Policy;
+
+#define num_policies 6
+#define max_rrpv_bits 8
+
+typedef struct Cache_Config
+{
+    unsigned block_size; // In bytes, a power of two
+    unsigned cache_size; // In KB
+    unsigned assoc;
+    unsigned num_sets; // 0: from cache_size
+    Set_Index set_index;
+    Arena_Pages pages; // Backing of the cache state
+
+    // BELADY_POLICY needs the next use of every request, see Next_Use.h
+    Replacement_Policy policy;
+    unsigned rrpv_bits; // Re-reference prediction values of SRRIP and SHiP
+
+    bool generic_kernel; // Even if the geometry has a specialized kernel, see Cache.h
+}Cache_Config;
+
+CACHESIM_API void initCacheConfig(Cache_Config *config);
+// Also --config <file>, a file of the same options one per line, without
+// their dashes ("policy srrip"); # starts a comment
+CACHESIM_API bool parseCacheOption(Cache_Config *config, int argc, const char *argv[], int *arg);
+CACHESIM_API void printCacheUsage();
+// Prints what is wrong, if anything
+CACHESIM_API bool checkCacheConfig(const Cache_Config *config);
+CACHESIM_API unsigned getNumSets(const Cache_Config *config);
+
+#endif
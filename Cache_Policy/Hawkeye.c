@@ -0,0 +1,133 @@
+#include "Hawkeye.h"
+
+// Sampled sets of a cache of num_sets sets
+static unsigned sampledSets(unsigned num_sets)
+{
+    return num_sets < hawkeye_sampled_sets ? num_sets : hawkeye_sampled_sets;
+}
+
+uint64_t hawkeyeBytes(unsigned num_sets, unsigned assoc)
+{
+    uint64_t slots = (uint64_t)sampledSets(num_sets) * history_factor * assoc;
+    return arenaBytes(sizeof(Hawkeye)) +
+           arenaBytes(sampledSets(num_sets) * sizeof(uint64_t)) +
+           arenaBytes(slots * sizeof(uint32_t)) +
+           arenaBytes(slots * sizeof(Hawkeye_Entry)) +
+           arenaBytes(counterTableWords(1 << hawkeye_predictor_bits, hawkeye_counter_bits) *
+                      sizeof(uint64_t));
+}
+
+Hawkeye *initHawkeyeIn(Arena *arena, unsigned num_sets, unsigned assoc)
+{
+    Hawkeye *hawkeye = (Hawkeye *)arenaAlloc(arena, sizeof(Hawkeye));
+
+    hawkeye->num_sampled = sampledSets(num_sets);
+    hawkeye->assoc = assoc;
+    hawkeye->history_len = history_factor * assoc;
+    hawkeye->sample_stride = num_sets / hawkeye->num_sampled;
+
+    uint64_t slots = (uint64_t)hawkeye->num_sampled * hawkeye->history_len;
+    hawkeye->set_time = (uint64_t *)arenaAlloc(arena, hawkeye->num_sampled * sizeof(uint64_t));
+    hawkeye->occupancy = (uint32_t *)arenaAlloc(arena, slots * sizeof(uint32_t));
+    hawkeye->entries = (Hawkeye_Entry *)arenaAlloc(arena, slots * sizeof(Hawkeye_Entry));
+    hawkeye->predictor.words = (uint64_t *)arenaAlloc(arena,
+        counterTableWords(1 << hawkeye_predictor_bits, hawkeye_counter_bits) * sizeof(uint64_t));
+
+    resetHawkeye(hawkeye);
+    return hawkeye;
+}
+
+void resetHawkeye(Hawkeye *hawkeye)
+{
+    uint64_t slots = (uint64_t)hawkeye->num_sampled * hawkeye->history_len;
+    memset(hawkeye->set_time, 0, hawkeye->num_sampled * sizeof(uint64_t));
+    memset(hawkeye->occupancy, 0, slots * sizeof(uint32_t));
+    memset(hawkeye->entries, 0, slots * sizeof(Hawkeye_Entry));
+
+    // Start weakly cache-friendly
+    initCounterTableIn(&(hawkeye->predictor), hawkeye->predictor.words, false,
+                       1 << hawkeye_predictor_bits, hawkeye_counter_bits,
+                       1 << (hawkeye_counter_bits - 1));
+}
+
+// OPTgen: would MIN have kept a block used at time last_time until now?
+// If so, the block occupies a way for every time step in between.
+static bool optgenHit(Hawkeye *hawkeye, uint32_t *occupancy, uint64_t last_time, uint64_t now)
+{
+    uint64_t t;
+    for (t = last_time; t < now; t++)
+    {
+        if (occupancy[t % hawkeye->history_len] >= hawkeye->assoc)
+        {
+            return false;
+        }
+    }
+    for (t = last_time; t < now; t++)
+    {
+        ++occupancy[t % hawkeye->history_len];
+    }
+    return true;
+}
+
+void hawkeyeAccess(Hawkeye *hawkeye, unsigned set, uint64_t block, unsigned sig)
+{
+    if (!hawkeyeSampled(hawkeye, set))
+    {
+        return;
+    }
+    unsigned sampled = set / hawkeye->sample_stride;
+
+    uint32_t *occupancy = &hawkeye->occupancy[sampled * hawkeye->history_len];
+    Hawkeye_Entry *entries = &hawkeye->entries[sampled * hawkeye->history_len];
+    uint64_t now = hawkeye->set_time[sampled]++;
+
+    // The slot of the current time step starts empty
+    occupancy[now % hawkeye->history_len] = 0;
+
+    // Find the block, or else the least recent entry to replace
+    Hawkeye_Entry *entry = NULL;
+    Hawkeye_Entry *oldest = &entries[0];
+    unsigned i;
+    for (i = 0; i < hawkeye->history_len; i++)
+    {
+        if (entries[i].valid && entries[i].block == block)
+        {
+            entry = &entries[i];
+            break;
+        }
+        if (!entries[i].valid ||
+            (oldest->valid && entries[i].last_time < oldest->last_time))
+        {
+            oldest = &entries[i];
+        }
+    }
+
+    if (entry != NULL && now - entry->last_time < hawkeye->history_len)
+    {
+        // Reused within the window: train with what MIN would have done
+        updateCounter(&(hawkeye->predictor), entry->sig,
+                      optgenHit(hawkeye, occupancy, entry->last_time, now));
+    }
+    else
+    {
+        if (entry != NULL)
+        {
+            // Reused too late, MIN would have evicted it
+            updateCounter(&(hawkeye->predictor), entry->sig, false);
+        }
+        else
+        {
+            // The entry it replaces was never reused in time: a scan, say
+            if (oldest->valid)
+            {
+                updateCounter(&(hawkeye->predictor), oldest->sig, false);
+            }
+            entry = oldest;
+        }
+        entry->block = block;
+        entry->valid = true;
+    }
+
+    entry->last_time = now;
+    entry->sig = sig;
+}
@@ -0,0 +1,90 @@
+#ifndef __HAWKEYE_HH__
+#define __HAWKEYE_HH__
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Arena.h"
+#include "Counter_Table.h"
+
+// Hawkeye (Jain and Lin, ISCA 2016).
+//
+// OPTgen reconstructs, for a few sampled sets, what Belady's MIN would have
+// done with the recent past: a block reused within a window of
+// history_factor x assoc accesses to its set would have hit under MIN if
+// every time step between its two uses had a free way. The PC of the
+// previous access is then trained as cache-friendly, otherwise as
+// cache-averse. The trained PC predictor decides the RRPV of every block,
+// sampled set or not.
+
+#define hawkeye_sampled_sets 64
+#define history_factor 8
+#define hawkeye_predictor_bits 11 // log2 of the PC predictor size
+#define hawkeye_counter_bits 3
+#define hawkeye_rrpv_bits 3
+
+// A recently accessed block of a sampled set
+typedef struct Hawkeye_Entry
+{
+    uint64_t block;
+    uint64_t last_time; // Set time of its last access
+    unsigned sig; // Signature of the PC of its last access
+    bool valid;
+}Hawkeye_Entry;
+
+typedef struct Hawkeye
+{
+    unsigned num_sampled; // Sampled sets
+    unsigned assoc;
+    unsigned history_len; // Window of OPTgen, in accesses to a set
+    unsigned sample_stride; // Every sample_stride-th set is sampled
+
+    // Per sampled set
+    uint64_t *set_time; // Accesses to the set so far
+    uint32_t *occupancy; // Per set, history_len slots indexed by time % history_len; up to assoc
+    Hawkeye_Entry *entries; // Per set, history_len entries
+
+    Counter_Table predictor; // Indexed by PC signature, MSB set is cache-friendly
+}Hawkeye;
+
+// Room the state of a num_sets x assoc cache takes in an arena; the
+// cache reserves it whatever its policy, it is a fixed size
+uint64_t hawkeyeBytes(unsigned num_sets, unsigned assoc);
+// Carve the state out of arena, untrained
+Hawkeye *initHawkeyeIn(Arena *arena, unsigned num_sets, unsigned assoc);
+// Forget all training
+void resetHawkeye(Hawkeye *hawkeye);
+
+static inline unsigned hawkeyeSignature(uint64_t PC)
+{
+    return (PC * 0x9E3779B97F4A7C15ull) >> (64 - hawkeye_predictor_bits);
+}
+
+// Train on an access of block (every access, hit or miss, in any set)
+void hawkeyeAccess(Hawkeye *hawkeye, unsigned set, uint64_t block, unsigned sig);
+
+static inline bool hawkeyeFriendly(const Hawkeye *hawkeye, unsigned sig)
+{
+    return getCounterPrediction(&(hawkeye->predictor), sig);
+}
+
+static inline bool hawkeyeSampled(const Hawkeye *hawkeye, unsigned set)
+{
+    return set % hawkeye->sample_stride == 0 &&
+           set / hawkeye->sample_stride < hawkeye_sampled_sets;
+}
+
+// A cache-friendly block of a sampled set was evicted anyway, its PC was
+// too optimistic. Other sets do not train, they would swamp OPTgen.
+static inline void hawkeyeDetrain(Hawkeye *hawkeye, unsigned set, unsigned sig)
+{
+    if (hawkeyeSampled(hawkeye, set))
+    {
+        updateCounter(&(hawkeye->predictor), sig, false);
+    }
+}
+
+#endif
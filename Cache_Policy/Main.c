@@ -1,61 +1,501 @@
 #include "Trace.h"
 #include "Cache.h"
+#include "Miss_Class.h"
+#include "Miss_Status.h"
+#include "Next_Use.h"
+#include "Sampling.h"
+#include "Time_Series.h"
+#include "Victim_Cache.h"
 
 extern TraceParser *initTraceParser(const char * mem_file);
+extern TraceParser *openTraceParser(const char * mem_file, unsigned decode_threads);
 extern bool getRequest(TraceParser *mem_trace);
+extern void closeTraceParser(TraceParser *mem_trace);
 
-extern Cache* initCache();
 extern bool accessBlock(Cache *cache, Request *req, uint64_t access_time);
 extern bool insertBlock(Cache *cache, Request *req, uint64_t access_time, uint64_t *wb_addr);
 
+#define max_cores 64 // Cores reported apart; the last one also gathers any beyond
+#define default_mshrs 8
+
+// Measured counters, also kept at the start of each time series row
+typedef struct Cache_Counts
+{
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    uint64_t writebacks;
+    uint64_t miss_types[num_miss_types]; // With --classify
+}Cache_Counts;
+
+// The miss classes are only written with --classify
+const char *seriesColumns[] = {"record", "requests", "hits", "misses", "hit_rate", "mpki",
+                               "evictions", "writebacks", "compulsory", "capacity", "conflict"};
+
+// Write the row of the interval ending at record, then start the next one
+static void addCacheRow(Time_Series *series, uint64_t record, const Cache_Counts *now,
+                        Cache_Counts *start)
+{
+    double hits = now->hits - start->hits;
+    double misses = now->misses - start->misses;
+    if (hits + misses > 0)
+    {
+        // The trace only holds memory instructions, so MPKI is per 1000 requests
+        double row[11] = {record, hits + misses, hits, misses,
+                          100.0 * hits / (hits + misses), 1000.0 * misses / (hits + misses),
+                          now->evictions - start->evictions, now->writebacks - start->writebacks,
+                          now->miss_types[COMPULSORY] - start->miss_types[COMPULSORY],
+                          now->miss_types[CAPACITY] - start->miss_types[CAPACITY],
+                          now->miss_types[CONFLICT] - start->miss_types[CONFLICT]};
+        addSeriesRow(series, row);
+    }
+    *start = *now;
+}
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s [options] %s\n", prog, "<mem-file>");
+    printf("  --classify         split misses into compulsory, capacity and conflict\n");
+    printf("                     misses, per core (and per time series row)\n");
+    printf("  --optimal          also simulate Belady's MIN and report the gap to it\n");
+    printf("  --optimal-memory MB  memory for next-use indices, more spills to disk\n");
+    printf("                     (default 1024)\n");
+    printf("  --victim-entries N  a fully-associative victim cache of N blocks behind the\n");
+    printf("                     cache, swapped on a hit (default 0, none; at most %u)\n",
+           max_victim_entries);
+    printf("  --mshr-window W    merge a miss into the MSHR of a miss to the same block\n");
+    printf("                     up to W requests before (default 0, no MSHRs)\n");
+    printf("  --mshrs N          MSHRs for --mshr-window (default %u, at most %u)\n",
+           default_mshrs, max_mshrs);
+    printf("                     Both report the conflict misses they recover\n");
+    printCacheUsage();
+    printSamplingUsage();
+    printSeriesUsage();
+    printDecodeUsage();
+}
+
 int main(int argc, const char *argv[])
 {	
-    if (argc != 2)
+    const char *mem_file = NULL;
+    bool classify = false;
+    bool optimal = false;
+    uint64_t optimal_memory = 1024; // In MB
+    unsigned victim_entries = 0;
+    unsigned num_mshrs = default_mshrs;
+    uint64_t mshr_window = 0;
+    unsigned decode_threads = 0;
+
+    Cache_Config cache_config;
+    initCacheConfig(&cache_config);
+    Sampling_Config sampling;
+    initSamplingConfig(&sampling);
+    Series_Config series_config;
+    initSeriesConfig(&series_config);
+
+    int arg;
+    for (arg = 1; arg < argc; arg++)
     {
-        printf("Usage: %s %s\n", argv[0], "<mem-file>");
+        if (strcmp(argv[arg], "--classify") == 0)
+        {
+            classify = true;
+        }
+        else if (strcmp(argv[arg], "--optimal") == 0)
+        {
+            optimal = true;
+        }
+        else if (strcmp(argv[arg], "--optimal-memory") == 0 && arg + 1 < argc)
+        {
+            optimal_memory = strtoull(argv[++arg], NULL, 10);
+        }
+        else if (strcmp(argv[arg], "--victim-entries") == 0 && arg + 1 < argc)
+        {
+            victim_entries = strtoul(argv[++arg], NULL, 10);
+        }
+        else if (strcmp(argv[arg], "--mshr-window") == 0 && arg + 1 < argc)
+        {
+            mshr_window = strtoull(argv[++arg], NULL, 10);
+        }
+        else if (strcmp(argv[arg], "--mshrs") == 0 && arg + 1 < argc)
+        {
+            num_mshrs = strtoul(argv[++arg], NULL, 10);
+        }
+        else if (parseCacheOption(&cache_config, argc, argv, &arg))
+        {
+        }
+        else if (parseSamplingOption(&sampling, argc, argv, &arg))
+        {
+        }
+        else if (parseSeriesOption(&series_config, argc, argv, &arg))
+        {
+        }
+        else if (parseDecodeOption(&decode_threads, argc, argv, &arg))
+        {
+        }
+        else if (argv[arg][0] != '-' && mem_file == NULL)
+        {
+            mem_file = argv[arg];
+        }
+        else
+        {
+            mem_file = NULL;
+            break;
+        }
+    }
+
+    if (mem_file == NULL)
+    {
+        usage(argv[0]);
 
         return 0;
     }
+    if (!checkCacheConfig(&cache_config))
+    {
+        return 1;
+    }
+    if (victim_entries > max_victim_entries)
+    {
+        fprintf(stderr, "The victim cache holds at most %u blocks\n", max_victim_entries);
+        return 1;
+    }
+    if (num_mshrs == 0 || num_mshrs > max_mshrs)
+    {
+        fprintf(stderr, "There must be 1 to %u MSHRs\n", max_mshrs);
+        return 1;
+    }
+
+    // Per-interval metric: hit rate
+    Sampler *sampler = initSampler(&sampling, 1);
+    if (sampling.mode == SAMPLE_SIMPOINT)
+    {
+        // Profiling pass to find the phases of the trace
+        TraceParser *profile_trace = openTraceParser(mem_file, decode_threads);
+        if (profile_trace == NULL)
+        {
+            return 1;
+        }
+        while (getRequest(profile_trace))
+        {
+            profileRecord(sampler, profile_trace->cur_req->PC);
+        }
+        closeTraceParser(profile_trace);
+        finishProfile(sampler);
+    }
 
     // Initialize a CPU trace parser
-    TraceParser *mem_trace = initTraceParser(argv[1]);
+    TraceParser *mem_trace = openTraceParser(mem_file, decode_threads);
 
     // Initialize a Cache
-    Cache *cache = initCache();
+    Cache *cache = initCache(&cache_config);
+    if (mem_trace == NULL || cache == NULL)
+    {
+        return 1;
+    }
     
     // Running the trace
     uint64_t num_of_reqs = 0;
     uint64_t hits = 0;
     uint64_t misses = 0;
     uint64_t num_evicts = 0;
+    uint64_t num_writebacks = 0; // To memory, past the victim cache if any
+
+    // The same cache replacing with Belady's MIN, an upper bound of any policy
+    Cache *opt_cache = NULL;
+    Next_Use *next_use = NULL;
+    uint64_t opt_hits = 0;
+    if (optimal || cache_config.policy == BELADY_POLICY)
+    {
+        next_use = computeNextUse(mem_file, cache->set_shift, optimal_memory << 20);
+        if (next_use == NULL)
+        {
+            return 1;
+        }
+    }
+    if (optimal)
+    {
+        Cache_Config opt_config = cache_config;
+        opt_config.policy = BELADY_POLICY;
+        opt_cache = initCache(&opt_config);
+    }
+
+    // Behind the cache, for the misses it takes: the victim cache, then the
+    // MSHRs of the misses that go to memory
+    Victim_Cache *victim_cache = victim_entries > 0 ? initVictimCache(victim_entries) : NULL;
+    MSHR_Table *mshr_table = mshr_window > 0 ? initMSHRTable(num_mshrs, mshr_window) : NULL;
+    uint64_t victim_hits = 0;
+    uint64_t mshr_merges = 0;
+    uint64_t mshr_stalls = 0; // Misses with every MSHR held
+    uint64_t recovered_conflicts[2] = {0, 0}; // By the victim cache, by the MSHRs
+
+    // Miss classification against a shadow fully-associative cache, also
+    // for the conflict misses the victim cache and the MSHRs recover
+    Miss_Classifier *classifier = classify || victim_cache != NULL || mshr_table != NULL ?
+                                  initMissClassifier(cache->num_blocks) : NULL;
+    uint64_t core_reqs[max_cores] = {0};
+    uint64_t core_misses[max_cores][num_miss_types] = {{0}};
+    uint64_t miss_types[num_miss_types] = {0};
+
+    // Time series of the measured requests, one row every interval
+    Time_Series *series = openTimeSeries(&series_config, classify ? 11 : 8, seriesColumns);
+    uint64_t series_until = series != NULL ? series_config.interval : UINT64_MAX;
+    Cache_Counts series_start = {0, 0, 0, 0, {0}};
+
+    // Sampling state; functional warming updates the cache without counting
+    Sample_Action action = SAMPLE_MEASURE;
+    uint64_t until = 0;
+    uint64_t interval_hits = 0;
+    uint64_t interval_reqs = 0;
 
     uint64_t cycles = 0;
     while (getRequest(mem_trace))
     {
+        if (num_of_reqs == series_until)
+        {
+            Cache_Counts now = {hits, misses, num_evicts, num_writebacks,
+                                {miss_types[0], miss_types[1], miss_types[2]}};
+            addCacheRow(series, num_of_reqs, &now, &series_start);
+            series_until += series_config.interval;
+        }
+
+        if (num_of_reqs == until)
+        {
+            if (action == SAMPLE_MEASURE && sampling.mode != SAMPLE_NONE && interval_reqs > 0)
+            {
+                double hit_rate = (double)interval_hits / (double)interval_reqs * 100;
+                addSample(sampler, (num_of_reqs - 1) / sampling.interval, &hit_rate);
+            }
+            interval_hits = interval_reqs = 0;
+
+            action = sampleAction(sampler, num_of_reqs, &until);
+        }
+
+        if (action == SAMPLE_SKIP)
+        {
+            ++num_of_reqs;
+            ++cycles;
+            continue;
+        }
+
+        bool measured = action == SAMPLE_MEASURE;
+
+        if (next_use != NULL)
+        {
+            mem_trace->cur_req->next_use = getNextUse(next_use, num_of_reqs);
+        }
+        if (opt_cache != NULL)
+        {
+            if (accessBlock(opt_cache, mem_trace->cur_req, cycles))
+            {
+                opt_hits += measured;
+            }
+            else
+            {
+                uint64_t wb_addr;
+                insertBlock(opt_cache, mem_trace->cur_req, cycles, &wb_addr);
+            }
+        }
+
+        // The shadow cache sees every simulated access, warming included
+        Miss_Type miss_type = COMPULSORY;
+        unsigned core = 0;
+        if (classifier != NULL)
+        {
+            miss_type = classifyAccess(classifier,
+                                       mem_trace->cur_req->load_or_store_addr >> cache->set_shift);
+            core = mem_trace->cur_req->core_id < max_cores ? mem_trace->cur_req->core_id
+                                                           : max_cores - 1;
+            core_reqs[core] += measured;
+        }
+
         // Step one, accessBlock()
         if (accessBlock(cache, mem_trace->cur_req, cycles))
         {
             // Cache hit
-            hits++;
+            hits += measured;
+            interval_hits += measured;
         }
         else
         {
             // Cache miss!
-            misses++;
+            misses += measured;
+            if (classifier != NULL)
+            {
+                miss_types[miss_type] += measured;
+                core_misses[core][miss_type] += measured;
+            }
+
+            // The victim cache may have the block, else it goes to memory
+            uint64_t block = mem_trace->cur_req->load_or_store_addr >> cache->set_shift;
+            Victim_Entry *victim_entry = NULL;
+            bool victim_dirty = false;
+            if (victim_cache != NULL && (victim_entry = findVictim(victim_cache, block)) != NULL)
+            {
+                victim_dirty = victim_entry->dirty;
+                victim_hits += measured;
+                recovered_conflicts[0] += measured && miss_type == CONFLICT;
+            }
+            else if (mshr_table != NULL)
+            {
+                MSHR_Result result = trackMiss(mshr_table, block, cycles);
+                mshr_merges += measured && result == MSHR_MERGED;
+                mshr_stalls += measured && result == MSHR_FULL;
+                recovered_conflicts[1] += measured && result == MSHR_MERGED &&
+                                          miss_type == CONFLICT;
+            }
+
             // Step two, insertBlock()
 //            printf("Inserting: %"PRIu64"\n", mem_trace->cur_req->load_or_store_addr);
             uint64_t wb_addr;
-            if (insertBlock(cache, mem_trace->cur_req, cycles, &wb_addr))
+            uint64_t writebacks = cache->writebacks;
+            bool evicted = insertBlock(cache, mem_trace->cur_req, cycles, &wb_addr);
+            if (evicted)
             {
-                num_evicts++;
+                num_evicts += measured;
 //                printf("Evicted: %"PRIu64"\n", wb_addr);
             }
+            bool evicted_dirty = cache->writebacks != writebacks;
+
+            // The evicted block goes to the victim cache, swapped with the
+            // block it gave back; only a dirty block it pushes out goes to
+            // memory
+            if (victim_cache == NULL)
+            {
+                num_writebacks += measured && evicted_dirty;
+            }
+            else
+            {
+                if (victim_dirty)
+                {
+                    findBlock(cache, mem_trace->cur_req->load_or_store_addr)->dirty = true;
+                }
+                if (evicted)
+                {
+                    bool pushed_dirty = putVictim(victim_cache, victim_entry,
+                                                  wb_addr >> cache->set_shift, evicted_dirty,
+                                                  cycles);
+                    num_writebacks += measured && pushed_dirty;
+                }
+                else if (victim_entry != NULL)
+                {
+                    victim_entry->valid = false;
+                }
+            }
         }
 
+        interval_reqs += measured;
         ++num_of_reqs;
         ++cycles;
     }
 
-    double hit_rate = (double)hits / ((double)hits + (double)misses);
-    printf("Hit rate: %lf%%\n", hit_rate * 100);
+    if (action == SAMPLE_MEASURE && sampling.mode != SAMPLE_NONE && interval_reqs > 0)
+    {
+        double hit_rate = (double)interval_hits / (double)interval_reqs * 100;
+        addSample(sampler, (num_of_reqs - 1) / sampling.interval, &hit_rate);
+    }
+
+    if (series != NULL)
+    {
+        Cache_Counts now = {hits, misses, num_evicts, num_writebacks,
+                            {miss_types[0], miss_types[1], miss_types[2]}};
+        addCacheRow(series, num_of_reqs, &now, &series_start);
+        if (!closeTimeSeries(series))
+        {
+            fprintf(stderr, "Could not write %s\n", series_config.file);
+        }
+    }
+
+    if (sampling.mode != SAMPLE_NONE)
+    {
+        double mean, half_width;
+        getEstimate(sampler, 0, &mean, &half_width);
+
+        printf("Sampled intervals: %"PRIu64"\n", sampler->num_samples);
+        printf("Hit rate: %lf%% (+/- %lf%%, 95%% CI)\n", mean, half_width);
+    }
+    else
+    {
+        double hit_rate = (double)hits / ((double)hits + (double)misses);
+        printf("Hit rate: %lf%%\n", hit_rate * 100);
+    }
+
+    if (opt_cache != NULL)
+    {
+        uint64_t opt_misses = hits + misses - opt_hits;
+        printf("Optimal hit rate: %lf%%\n", 100.0 * opt_hits / ((double)hits + (double)misses));
+        printf("Gap to optimal: %lf%% hit rate, %"PRIu64" misses (%+.3lf%%)\n",
+               100.0 * ((double)opt_hits - (double)hits) / ((double)hits + (double)misses),
+               misses - opt_misses,
+               opt_misses ? 100.0 * ((double)misses - (double)opt_misses) / opt_misses : 0);
+
+        freeCache(opt_cache);
+    }
+    if (next_use != NULL)
+    {
+        freeNextUse(next_use);
+    }
+
+    // Misses the victim cache and the MSHRs save a memory access
+    uint64_t conflicts = miss_types[CONFLICT];
+    if (victim_cache != NULL)
+    {
+        printf("Victim cache: %u blocks, %"PRIu64" hits (%lf%% of misses)\n",
+               victim_entries, victim_hits, misses ? 100.0 * victim_hits / misses : 0);
+        printf("Hit rate with the victim cache: %lf%%\n",
+               100.0 * (hits + victim_hits) / ((double)hits + (double)misses));
+        printf("Conflict misses recovered by the victim cache: %"PRIu64" of %"PRIu64" (%lf%%)\n",
+               recovered_conflicts[0], conflicts,
+               conflicts ? 100.0 * recovered_conflicts[0] / conflicts : 0);
+
+        freeVictimCache(victim_cache);
+    }
+    if (mshr_table != NULL)
+    {
+        printf("MSHRs: %u for %"PRIu64" requests, %"PRIu64" misses merged, %"PRIu64" stalled\n",
+               num_mshrs, mshr_window, mshr_merges, mshr_stalls);
+        printf("Conflict misses recovered by the MSHRs: %"PRIu64" of %"PRIu64" (%lf%%)\n",
+               recovered_conflicts[1], conflicts,
+               conflicts ? 100.0 * recovered_conflicts[1] / conflicts : 0);
+
+        freeMSHRTable(mshr_table);
+    }
+    if (victim_cache != NULL || mshr_table != NULL)
+    {
+        printf("Misses to memory: %"PRIu64"\n", misses - victim_hits - mshr_merges);
+        printf("Writebacks to memory: %"PRIu64"\n", num_writebacks);
+    }
+
+    if (classify)
+    {
+        printf("%-6s %12s %12s %12s %12s %12s\n", "Core", "Requests", "Misses",
+               missTypeName(COMPULSORY), missTypeName(CAPACITY), missTypeName(CONFLICT));
+        unsigned c;
+        int t;
+        for (c = 0; c < max_cores; c++)
+        {
+            if (core_reqs[c] == 0)
+            {
+                continue;
+            }
+            uint64_t core_total = core_misses[c][0] + core_misses[c][1] + core_misses[c][2];
+            printf("%-6u %12"PRIu64" %12"PRIu64, c, core_reqs[c], core_total);
+            for (t = 0; t < num_miss_types; t++)
+            {
+                printf(" %11.3f%%", core_total ? 100.0 * core_misses[c][t] / core_total : 0);
+            }
+            printf("\n");
+        }
+        printf("%-6s %12"PRIu64" %12"PRIu64, "All", hits + misses, misses);
+        for (t = 0; t < num_miss_types; t++)
+        {
+            printf(" %11.3f%%", misses ? 100.0 * miss_types[t] / misses : 0);
+        }
+        printf("\n");
+    }
+    if (classifier != NULL)
+    {
+        freeMissClassifier(classifier);
+    }
+
+    closeTraceParser(mem_trace);
+    freeCache(cache);
+    freeSampler(sampler);
 }
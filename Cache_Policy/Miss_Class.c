@@ -0,0 +1,220 @@
+#include "Miss_Class.h"
+
+#define initial_touched 4096
+
+static inline uint64_t hashBlock(uint64_t block)
+{
+    return (block * 0x9E3779B97F4A7C15ull) >> 32;
+}
+
+Miss_Classifier *initMissClassifier(unsigned num_blocks)
+{
+    Miss_Classifier *classifier = (Miss_Classifier *)malloc(sizeof(Miss_Classifier));
+
+    classifier->touched = (uint64_t *)calloc(initial_touched, sizeof(uint64_t));
+    classifier->touched_mask = initial_touched - 1;
+    classifier->num_touched = 0;
+
+    classifier->nodes = (Shadow_Node *)malloc(num_blocks * sizeof(Shadow_Node));
+    classifier->num_blocks = num_blocks;
+    classifier->num_valid = 0;
+    classifier->head = no_node;
+    classifier->tail = no_node;
+
+    // At least twice as many slots as blocks
+    uint64_t num_slots = 1;
+    while (num_slots < 2 * (uint64_t)num_blocks)
+    {
+        num_slots *= 2;
+    }
+    classifier->slots = (uint32_t *)malloc(num_slots * sizeof(uint32_t));
+    memset(classifier->slots, 0xff, num_slots * sizeof(uint32_t));
+    classifier->slot_mask = num_slots - 1;
+
+    return classifier;
+}
+
+void freeMissClassifier(Miss_Classifier *classifier)
+{
+    free(classifier->touched);
+    free(classifier->nodes);
+    free(classifier->slots);
+    free(classifier);
+}
+
+// Double the first-touch set and re-insert every block
+static void growTouched(Miss_Classifier *classifier)
+{
+    uint64_t *old_touched = classifier->touched;
+    uint64_t old_slots = classifier->touched_mask + 1;
+
+    classifier->touched = (uint64_t *)calloc(old_slots * 2, sizeof(uint64_t));
+    classifier->touched_mask = old_slots * 2 - 1;
+
+    uint64_t i;
+    for (i = 0; i < old_slots; i++)
+    {
+        if (old_touched[i] == 0)
+        {
+            continue;
+        }
+        uint64_t slot = hashBlock(old_touched[i] - 1);
+        while (classifier->touched[slot & classifier->touched_mask] != 0)
+        {
+            ++slot;
+        }
+        classifier->touched[slot & classifier->touched_mask] = old_touched[i];
+    }
+
+    free(old_touched);
+}
+
+// Returns true if block was not touched before
+static bool firstTouch(Miss_Classifier *classifier, uint64_t block)
+{
+    uint64_t key = block + 1;
+    uint64_t slot = hashBlock(block);
+    uint64_t *entry;
+    while (*(entry = &classifier->touched[slot & classifier->touched_mask]) != 0)
+    {
+        if (*entry == key)
+        {
+            return false;
+        }
+        ++slot;
+    }
+
+    *entry = key;
+    // Keep the load factor under 1/2
+    if (++classifier->num_touched * 2 > classifier->touched_mask + 1)
+    {
+        growTouched(classifier);
+    }
+    return true;
+}
+
+// Slot holding block in the shadow hash table, or the empty slot ending its probe
+static uint64_t findSlot(const Miss_Classifier *classifier, uint64_t block)
+{
+    uint64_t slot = hashBlock(block) & classifier->slot_mask;
+    uint32_t node;
+    while ((node = classifier->slots[slot]) != no_node &&
+           classifier->nodes[node].block != block)
+    {
+        slot = (slot + 1) & classifier->slot_mask;
+    }
+    return slot;
+}
+
+// Remove the entry at slot, shifting back the entries probed past it
+static void removeSlot(Miss_Classifier *classifier, uint64_t slot)
+{
+    uint64_t hole = slot;
+    for (;;)
+    {
+        slot = (slot + 1) & classifier->slot_mask;
+        uint32_t node = classifier->slots[slot];
+        if (node == no_node)
+        {
+            break;
+        }
+
+        // Move the entry into the hole unless its home slot lies in (hole, slot]
+        uint64_t home = hashBlock(classifier->nodes[node].block) & classifier->slot_mask;
+        if (((slot - home) & classifier->slot_mask) >= ((slot - hole) & classifier->slot_mask))
+        {
+            classifier->slots[hole] = node;
+            hole = slot;
+        }
+    }
+    classifier->slots[hole] = no_node;
+}
+
+static void unlinkNode(Miss_Classifier *classifier, uint32_t node)
+{
+    Shadow_Node *n = &classifier->nodes[node];
+    if (n->prev != no_node)
+    {
+        classifier->nodes[n->prev].next = n->next;
+    }
+    else
+    {
+        classifier->head = n->next;
+    }
+    if (n->next != no_node)
+    {
+        classifier->nodes[n->next].prev = n->prev;
+    }
+    else
+    {
+        classifier->tail = n->prev;
+    }
+}
+
+static void pushFront(Miss_Classifier *classifier, uint32_t node)
+{
+    Shadow_Node *n = &classifier->nodes[node];
+    n->prev = no_node;
+    n->next = classifier->head;
+    if (classifier->head != no_node)
+    {
+        classifier->nodes[classifier->head].prev = node;
+    }
+    else
+    {
+        classifier->tail = node;
+    }
+    classifier->head = node;
+}
+
+// Access the shadow cache, returns true on a hit
+static bool accessShadow(Miss_Classifier *classifier, uint64_t block)
+{
+    uint64_t slot = findSlot(classifier, block);
+    uint32_t node = classifier->slots[slot];
+    if (node != no_node)
+    {
+        unlinkNode(classifier, node);
+        pushFront(classifier, node);
+        return true;
+    }
+
+    // Miss: take a free node, or replace the least recent block
+    if (classifier->num_valid < classifier->num_blocks)
+    {
+        node = classifier->num_valid++;
+    }
+    else
+    {
+        node = classifier->tail;
+        unlinkNode(classifier, node);
+        removeSlot(classifier, findSlot(classifier, classifier->nodes[node].block));
+        slot = findSlot(classifier, block);
+    }
+
+    classifier->nodes[node].block = block;
+    classifier->slots[slot] = node;
+    pushFront(classifier, node);
+    return false;
+}
+
+Miss_Type classifyAccess(Miss_Classifier *classifier, uint64_t block)
+{
+    bool first = firstTouch(classifier, block);
+    bool shadow_hit = accessShadow(classifier, block);
+
+    if (first)
+    {
+        return COMPULSORY;
+    }
+    return shadow_hit ? CONFLICT : CAPACITY;
+}
+
+const char *missTypeName(Miss_Type type)
+{
+    if (type == COMPULSORY)
+    {
+        return "compulsory";
+    }
+    return type == CAPACITY ? "capacity" : "conflict";
+}
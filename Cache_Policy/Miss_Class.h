@@ -0,0 +1,58 @@
+#ifndef __MISS_CLASS_HH__
+#define __MISS_CLASS_HH__
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h> // uint64_t
+
+// Three-C miss classification.
+//
+// A miss is compulsory on the first touch of a block, a capacity miss if a
+// fully-associative LRU cache of the same size misses too, and a conflict
+// miss otherwise. First touches are tracked by a hash set of blocks, the
+// fully-associative cache is a shadow LRU list of preallocated nodes linked
+// by index and found through a hash table; neither allocates per access.
+
+typedef enum Miss_Type{COMPULSORY, CAPACITY, CONFLICT}Miss_Type;
+
+#define num_miss_types 3
+#define no_node UINT32_MAX
+
+typedef struct Shadow_Node
+{
+    uint64_t block;
+    uint32_t prev; // Towards the most recent
+    uint32_t next; // Towards the least recent
+}Shadow_Node;
+
+typedef struct Miss_Classifier
+{
+    // Blocks touched so far; keys are block + 1, 0 is empty
+    uint64_t *touched;
+    uint64_t touched_mask;
+    uint64_t num_touched;
+
+    // Shadow fully-associative LRU cache
+    Shadow_Node *nodes;
+    unsigned num_blocks; // Capacity
+    unsigned num_valid;
+    uint32_t head; // Most recent
+    uint32_t tail; // Least recent
+
+    uint32_t *slots; // block -> node, no_node is empty
+    uint64_t slot_mask;
+}Miss_Classifier;
+
+Miss_Classifier *initMissClassifier(unsigned num_blocks);
+void freeMissClassifier(Miss_Classifier *classifier);
+// Account an access to block (hit or miss in the real cache) and return the
+// class its miss would have
+Miss_Type classifyAccess(Miss_Classifier *classifier, uint64_t block);
+const char *missTypeName(Miss_Type type);
+
+#endif
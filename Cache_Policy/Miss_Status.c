@@ -0,0 +1,45 @@
+#include "Miss_Status.h"
+
+MSHR_Table *initMSHRTable(unsigned num_mshrs, uint64_t window)
+{
+    MSHR_Table *table = (MSHR_Table *)malloc(sizeof(MSHR_Table));
+
+    // All free from the start
+    table->mshrs = (MSHR *)calloc(num_mshrs, sizeof(MSHR));
+    table->num_mshrs = num_mshrs;
+    table->window = window;
+
+    return table;
+}
+
+void freeMSHRTable(MSHR_Table *table)
+{
+    free(table->mshrs);
+    free(table);
+}
+
+MSHR_Result trackMiss(MSHR_Table *table, uint64_t block, uint64_t time)
+{
+    MSHR *free_mshr = NULL;
+    unsigned i;
+    for (i = 0; i < table->num_mshrs; i++)
+    {
+        MSHR *mshr = &table->mshrs[i];
+        if (mshr->until <= time)
+        {
+            free_mshr = mshr;
+        }
+        else if (mshr->block == block)
+        {
+            return MSHR_MERGED;
+        }
+    }
+
+    if (free_mshr == NULL)
+    {
+        return MSHR_FULL;
+    }
+    free_mshr->block = block;
+    free_mshr->until = time + table->window;
+    return MSHR_ALLOCATED;
+}
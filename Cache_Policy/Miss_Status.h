@@ -0,0 +1,41 @@
+#ifndef __MISS_STATUS_HH__
+#define __MISS_STATUS_HH__
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h> // uint64_t
+
+// Miss status holding registers. Every miss that goes to memory holds an
+// MSHR for window accesses, the time its fill would take. Another miss to
+// the same block in that time merges into it and needs no memory access
+// of its own: the trace replays misses back to back, so a block refetched
+// this soon was evicted before its first fill could have come back. A miss
+// that finds every MSHR held would stall; it is counted and not tracked.
+
+#define max_mshrs 256
+
+typedef enum MSHR_Result{MSHR_ALLOCATED, MSHR_MERGED, MSHR_FULL}MSHR_Result;
+
+typedef struct MSHR
+{
+    uint64_t block; // Block number
+    uint64_t until; // Held before this time
+}MSHR;
+
+typedef struct MSHR_Table
+{
+    MSHR *mshrs;
+    unsigned num_mshrs;
+    uint64_t window;
+}MSHR_Table;
+
+MSHR_Table *initMSHRTable(unsigned num_mshrs, uint64_t window);
+void freeMSHRTable(MSHR_Table *table);
+// A miss to block at time, merged into a held MSHR or holding a free one
+MSHR_Result trackMiss(MSHR_Table *table, uint64_t block, uint64_t time);
+
+#endif
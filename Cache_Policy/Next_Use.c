@@ -0,0 +1,251 @@
+#include "Next_Use.h"
+#include "Trace.h"
+
+#include <unistd.h>
+
+extern TraceParser *initTraceParser(const char * mem_file);
+extern bool getRequest(TraceParser *mem_trace);
+extern void closeTraceParser(TraceParser *mem_trace);
+
+#define initial_blocks 4096
+
+// Open-addressing (linear probing) map from block to the earliest record
+// seen so far in the backward pass; keys are block + 1, 0 is empty
+typedef struct Use_Map
+{
+    uint64_t *keys;
+    uint64_t *records;
+    uint64_t mask;
+    uint64_t num_entries;
+}Use_Map;
+
+static inline uint64_t hashBlock(uint64_t block)
+{
+    return (block * 0x9E3779B97F4A7C15ull) >> 32;
+}
+
+static void initUseMap(Use_Map *map, uint64_t num_slots)
+{
+    map->keys = (uint64_t *)calloc(num_slots, sizeof(uint64_t));
+    map->records = (uint64_t *)malloc(num_slots * sizeof(uint64_t));
+    map->mask = num_slots - 1;
+    map->num_entries = 0;
+}
+
+// Slot of block, or the empty slot where it would go
+static inline uint64_t findUse(const Use_Map *map, uint64_t block)
+{
+    uint64_t slot = hashBlock(block) & map->mask;
+    while (map->keys[slot] != 0 && map->keys[slot] != block + 1)
+    {
+        slot = (slot + 1) & map->mask;
+    }
+    return slot;
+}
+
+static void growUseMap(Use_Map *map)
+{
+    Use_Map old = *map;
+    initUseMap(map, (old.mask + 1) * 2);
+
+    uint64_t i;
+    for (i = 0; i <= old.mask; i++)
+    {
+        if (old.keys[i] != 0)
+        {
+            uint64_t slot = findUse(map, old.keys[i] - 1);
+            map->keys[slot] = old.keys[i];
+            map->records[slot] = old.records[i];
+        }
+    }
+    map->num_entries = old.num_entries;
+
+    free(old.keys);
+    free(old.records);
+}
+
+// Returns the previous record of block (the next one in trace order) and
+// replaces it with record
+static inline uint64_t swapUse(Use_Map *map, uint64_t block, uint64_t record)
+{
+    uint64_t slot = findUse(map, block);
+    if (map->keys[slot] == 0)
+    {
+        map->keys[slot] = block + 1;
+        map->records[slot] = record;
+        // Keep the load factor under 1/2
+        if (++map->num_entries * 2 > map->mask + 1)
+        {
+            growUseMap(map);
+        }
+        return no_next_use;
+    }
+
+    uint64_t next = map->records[slot];
+    map->records[slot] = record;
+    return next;
+}
+
+static bool writeChunk(Next_Use *next_use, uint64_t start, uint64_t size)
+{
+    const char *buf = (const char *)next_use->chunk;
+    size_t left = size * sizeof(uint64_t);
+    off_t offset = start * sizeof(uint64_t);
+    while (left > 0)
+    {
+        ssize_t written = pwrite(next_use->fd, buf, left, offset);
+        if (written <= 0)
+        {
+            perror("next use spill file");
+            return false;
+        }
+        buf += written;
+        left -= written;
+        offset += written;
+    }
+    return true;
+}
+
+static bool readChunk(Next_Use *next_use, uint64_t start, uint64_t size)
+{
+    char *buf = (char *)next_use->chunk;
+    size_t left = size * sizeof(uint64_t);
+    off_t offset = start * sizeof(uint64_t);
+    while (left > 0)
+    {
+        ssize_t got = pread(next_use->fd, buf, left, offset);
+        if (got <= 0)
+        {
+            perror("next use spill file");
+            return false;
+        }
+        buf += got;
+        left -= got;
+        offset += got;
+    }
+
+    next_use->chunk_start = start;
+    next_use->chunk_size = size;
+    return true;
+}
+
+// Spill the full chunk, creating the spill file on the first call
+static bool spillChunk(Next_Use *next_use)
+{
+    if (next_use->fd < 0)
+    {
+        const char *dir = getenv("TMPDIR") != NULL ? getenv("TMPDIR") : "/tmp";
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/next_use.XXXXXX", dir);
+        next_use->fd = mkstemp(path);
+        if (next_use->fd < 0)
+        {
+            perror(path);
+            return false;
+        }
+        unlink(path);
+    }
+
+    return writeChunk(next_use, next_use->chunk_start, next_use->chunk_size);
+}
+
+// Backward pass over the records held in chunk
+static void reverseChunk(Next_Use *next_use, Use_Map *map)
+{
+    uint64_t i = next_use->chunk_size;
+    while (i-- > 0)
+    {
+        next_use->chunk[i] = swapUse(map, next_use->chunk[i], next_use->chunk_start + i);
+    }
+}
+
+Next_Use *computeNextUse(const char *mem_file, unsigned block_shift, uint64_t memory_bytes)
+{
+    TraceParser *mem_trace = initTraceParser(mem_file);
+    if (mem_trace == NULL)
+    {
+        return NULL;
+    }
+
+    Next_Use *next_use = (Next_Use *)malloc(sizeof(Next_Use));
+    next_use->chunk_records = memory_bytes / sizeof(uint64_t) > 0 ?
+                              memory_bytes / sizeof(uint64_t) : 1;
+    next_use->chunk = (uint64_t *)malloc(next_use->chunk_records * sizeof(uint64_t));
+    next_use->chunk_start = 0;
+    next_use->chunk_size = 0;
+    next_use->fd = -1;
+
+    // Forward pass: the block of every record
+    bool ok = true;
+    uint64_t record = 0;
+    while (getRequest(mem_trace))
+    {
+        if (next_use->chunk_size == next_use->chunk_records)
+        {
+            ok = ok && spillChunk(next_use);
+            next_use->chunk_start += next_use->chunk_size;
+            next_use->chunk_size = 0;
+        }
+        uint64_t block = mem_trace->cur_req->load_or_store_addr >> block_shift;
+        next_use->chunk[next_use->chunk_size++] = block;
+        ++record;
+    }
+    closeTraceParser(mem_trace);
+    next_use->num_records = record;
+
+    // Backward pass, from the chunk still in memory down to the first one
+    Use_Map map;
+    initUseMap(&map, initial_blocks);
+    while (ok)
+    {
+        reverseChunk(next_use, &map);
+        if (next_use->chunk_start == 0)
+        {
+            break;
+        }
+        ok = writeChunk(next_use, next_use->chunk_start, next_use->chunk_size) &&
+             readChunk(next_use, next_use->chunk_start - next_use->chunk_records,
+                       next_use->chunk_records);
+    }
+    free(map.keys);
+    free(map.records);
+
+    if (!ok)
+    {
+        freeNextUse(next_use);
+        return NULL;
+    }
+    return next_use;
+}
+
+void freeNextUse(Next_Use *next_use)
+{
+    if (next_use->fd >= 0)
+    {
+        close(next_use->fd);
+    }
+    free(next_use->chunk);
+    free(next_use);
+}
+
+uint64_t getNextUse(Next_Use *next_use, uint64_t record)
+{
+    if (record >= next_use->num_records)
+    {
+        return no_next_use;
+    }
+
+    if (record < next_use->chunk_start ||
+        record >= next_use->chunk_start + next_use->chunk_size)
+    {
+        uint64_t start = record - record % next_use->chunk_records;
+        uint64_t size = next_use->num_records - start < next_use->chunk_records ?
+                        next_use->num_records - start : next_use->chunk_records;
+        if (!readChunk(next_use, start, size))
+        {
+            exit(1);
+        }
+    }
+
+    return next_use->chunk[record - next_use->chunk_start];
+}
@@ -0,0 +1,40 @@
+#ifndef __NEXT_USE_HH__
+#define __NEXT_USE_HH__
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h> // uint64_t
+
+// Next-use indices for Belady's MIN.
+//
+// A forward pass over the trace records the block of every request, then a
+// backward pass turns it into, for every request, the record of the next
+// request to the same block. Records are handled in chunks of at most
+// memory_bytes; if the trace has more than one chunk the chunks are spilled
+// to an unlinked temporary file and the backward pass rewrites them in place
+// from the last to the first.
+
+typedef struct Next_Use
+{
+    uint64_t num_records;
+
+    uint64_t *chunk; // One chunk of records
+    uint64_t chunk_records; // Capacity of the chunk
+    uint64_t chunk_start; // First record held in chunk
+    uint64_t chunk_size; // Records held in chunk
+
+    int fd; // Spill file, -1 while every record fits in chunk
+}Next_Use;
+
+// Returns NULL if the trace or the spill file cannot be read or written
+Next_Use *computeNextUse(const char *mem_file, unsigned block_shift, uint64_t memory_bytes);
+void freeNextUse(Next_Use *next_use);
+
+// Next use of record; cheap when records are asked for in order
+uint64_t getNextUse(Next_Use *next_use, uint64_t record);
+
+#endif
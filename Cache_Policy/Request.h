@@ -6,6 +6,8 @@
 
 typedef enum Request_Type{LOAD, STORE}Request_Type;
 
+#define no_next_use UINT64_MAX // The block is never requested again
+
 // Instruction Format
 typedef struct Request
 {
@@ -18,6 +20,9 @@ typedef struct Request
 
     int core_id; // The core of PC is running on
 
+    // Offline oracle
+    uint64_t next_use; // Record of the next request to the same block (no_next_use if none)
+
 }Request;
 
 #endif
@@ -0,0 +1,279 @@
+#include "Stack_Distance.h"
+
+#define initial_blocks 4096
+
+static inline uint64_t hashBlock(uint64_t block)
+{
+    return (block * 0x9E3779B97F4A7C15ull) >> 32;
+}
+
+Stack_Distance *initStackDistance()
+{
+    Stack_Distance *stack = (Stack_Distance *)calloc(1, sizeof(Stack_Distance));
+
+    stack->blocks_capacity = initial_blocks;
+    stack->blocks = (uint64_t *)malloc(initial_blocks * sizeof(uint64_t));
+    stack->last_access = (uint64_t *)malloc(initial_blocks * sizeof(uint64_t));
+    stack->histogram = (uint64_t *)calloc(initial_blocks, sizeof(uint64_t));
+
+    stack->slot_mask = initial_blocks * 2 - 1;
+    stack->slots = (uint32_t *)calloc(initial_blocks * 2, sizeof(uint32_t));
+
+    stack->capacity = initial_blocks * 2;
+    stack->tree = (uint32_t *)calloc(stack->capacity + 1, sizeof(uint32_t));
+    stack->owner = (uint32_t *)malloc(stack->capacity * sizeof(uint32_t));
+
+    return stack;
+}
+
+void freeStackDistance(Stack_Distance *stack)
+{
+    free(stack->blocks);
+    free(stack->last_access);
+    free(stack->histogram);
+    free(stack->slots);
+    free(stack->tree);
+    free(stack->owner);
+    free(stack);
+}
+
+// Fenwick tree, positions are 0-based outside and 1-based inside
+static inline void treeAdd(Stack_Distance *stack, uint64_t pos, int delta)
+{
+    for (++pos; pos <= stack->capacity; pos += pos & -pos)
+    {
+        stack->tree[pos] += delta;
+    }
+}
+
+// Number of marks at positions <= pos
+static inline uint64_t treePrefix(const Stack_Distance *stack, uint64_t pos)
+{
+    uint64_t sum = 0;
+    for (++pos; pos > 0; pos -= pos & -pos)
+    {
+        sum += stack->tree[pos];
+    }
+    return sum;
+}
+
+// Renumber the last accesses 0 .. num_blocks - 1 in order and rebuild the
+// tree with room for as many new positions
+static void compactStack(Stack_Distance *stack)
+{
+    uint64_t capacity = stack->num_blocks * 2 > stack->capacity ?
+                        stack->num_blocks * 2 : stack->capacity;
+    uint32_t *owner = (uint32_t *)malloc(capacity * sizeof(uint32_t));
+
+    uint64_t pos, live = 0;
+    for (pos = 0; pos < stack->now; pos++)
+    {
+        uint32_t idx = stack->owner[pos];
+        if (stack->last_access[idx] == pos)
+        {
+            stack->last_access[idx] = live;
+            owner[live++] = idx;
+        }
+    }
+    assert(live == stack->num_blocks);
+
+    free(stack->owner);
+    stack->owner = owner;
+    stack->capacity = capacity;
+    stack->now = live;
+
+    // Linear-time build: mark every live position, then push partial sums up
+    free(stack->tree);
+    stack->tree = (uint32_t *)calloc(capacity + 1, sizeof(uint32_t));
+    for (pos = 1; pos <= capacity; pos++)
+    {
+        stack->tree[pos] += pos <= live;
+        uint64_t parent = pos + (pos & -pos);
+        if (parent <= capacity)
+        {
+            stack->tree[parent] += stack->tree[pos];
+        }
+    }
+}
+
+// Double the hash table and re-insert every block
+static void growSlots(Stack_Distance *stack)
+{
+    uint64_t num_slots = (stack->slot_mask + 1) * 2;
+    free(stack->slots);
+    stack->slots = (uint32_t *)calloc(num_slots, sizeof(uint32_t));
+    stack->slot_mask = num_slots - 1;
+
+    uint64_t i;
+    for (i = 0; i < stack->num_blocks; i++)
+    {
+        uint64_t slot = hashBlock(stack->blocks[i]);
+        while (stack->slots[slot & stack->slot_mask] != 0)
+        {
+            ++slot;
+        }
+        stack->slots[slot & stack->slot_mask] = i + 1;
+    }
+}
+
+// Index of a new block
+static uint32_t addBlock(Stack_Distance *stack, uint64_t block)
+{
+    if (stack->num_blocks == stack->blocks_capacity)
+    {
+        uint64_t capacity = stack->blocks_capacity * 2;
+        stack->blocks = (uint64_t *)realloc(stack->blocks, capacity * sizeof(uint64_t));
+        stack->last_access = (uint64_t *)realloc(stack->last_access, capacity * sizeof(uint64_t));
+        stack->histogram = (uint64_t *)realloc(stack->histogram, capacity * sizeof(uint64_t));
+        memset(stack->histogram + stack->blocks_capacity, 0,
+               stack->blocks_capacity * sizeof(uint64_t));
+        stack->blocks_capacity = capacity;
+    }
+
+    uint32_t idx = stack->num_blocks++;
+    stack->blocks[idx] = block;
+
+    // Keep the load factor under 1/2
+    if (stack->num_blocks * 2 > stack->slot_mask + 1)
+    {
+        growSlots(stack);
+    }
+    else
+    {
+        uint64_t slot = hashBlock(block);
+        while (stack->slots[slot & stack->slot_mask] != 0)
+        {
+            ++slot;
+        }
+        stack->slots[slot & stack->slot_mask] = idx + 1;
+    }
+
+    return idx;
+}
+
+// Account an access to block, returns its stack distance (cold_miss on the
+// first access)
+uint64_t accessStack(Stack_Distance *stack, uint64_t block)
+{
+    if (stack->now == stack->capacity)
+    {
+        compactStack(stack);
+    }
+
+    // Find the block
+    uint64_t slot = hashBlock(block);
+    uint32_t entry;
+    while ((entry = stack->slots[slot & stack->slot_mask]) != 0 &&
+           stack->blocks[entry - 1] != block)
+    {
+        ++slot;
+    }
+
+    uint64_t distance;
+    uint32_t idx;
+    if (entry == 0)
+    {
+        idx = addBlock(stack, block);
+        distance = cold_miss;
+        ++stack->cold_misses;
+    }
+    else
+    {
+        // Every block has exactly one mark; the ones after its previous
+        // access were touched since
+        idx = entry - 1;
+        uint64_t last = stack->last_access[idx];
+        distance = (stack->num_blocks - treePrefix(stack, last));
+        treeAdd(stack, last, -1);
+        ++stack->histogram[distance];
+    }
+
+    stack->last_access[idx] = stack->now;
+    stack->owner[stack->now] = idx;
+    treeAdd(stack, stack->now, 1);
+    ++stack->now;
+    ++stack->accesses;
+
+    return distance;
+}
+
+double stackHitRate(const Stack_Distance *stack, uint64_t size)
+{
+    uint64_t hits = 0;
+    uint64_t d;
+    for (d = 0; d < size && d < stack->num_blocks; d++)
+    {
+        hits += stack->histogram[d];
+    }
+    return stack->accesses ? (double)hits / stack->accesses : 0;
+}
+
+Set_Stacks *initSetStacks(unsigned num_sets, unsigned max_assoc)
+{
+    Set_Stacks *stacks = (Set_Stacks *)malloc(sizeof(Set_Stacks));
+
+    stacks->num_sets = num_sets;
+    stacks->max_assoc = max_assoc;
+    stacks->stacks = (uint64_t *)malloc((uint64_t)num_sets * max_assoc * sizeof(uint64_t));
+    stacks->depth = (unsigned *)calloc(num_sets, sizeof(unsigned));
+    stacks->histogram = (uint64_t *)calloc(max_assoc + 1, sizeof(uint64_t));
+    stacks->accesses = 0;
+
+    return stacks;
+}
+
+void freeSetStacks(Set_Stacks *stacks)
+{
+    free(stacks->stacks);
+    free(stacks->depth);
+    free(stacks->histogram);
+    free(stacks);
+}
+
+// Account an access to block, returns its distance within its set
+// (max_assoc if it is not among the max_assoc most recent blocks)
+unsigned accessSetStack(Set_Stacks *stacks, uint64_t block)
+{
+    unsigned set = block % stacks->num_sets;
+    uint64_t *stack = &stacks->stacks[(uint64_t)set * stacks->max_assoc];
+    unsigned depth = stacks->depth[set];
+
+    unsigned distance = 0;
+    while (distance < depth && stack[distance] != block)
+    {
+        ++distance;
+    }
+
+    // Move to front; the least recent block falls off a full stack
+    unsigned last = distance;
+    if (distance == depth)
+    {
+        if (depth < stacks->max_assoc)
+        {
+            ++stacks->depth[set];
+        }
+        else
+        {
+            --last;
+        }
+        distance = stacks->max_assoc;
+    }
+    memmove(&stack[1], &stack[0], last * sizeof(uint64_t));
+    stack[0] = block;
+
+    ++stacks->histogram[distance];
+    ++stacks->accesses;
+
+    return distance;
+}
+
+double setStackHitRate(const Set_Stacks *stacks, unsigned assoc)
+{
+    uint64_t hits = 0;
+    unsigned d;
+    for (d = 0; d < assoc && d < stacks->max_assoc; d++)
+    {
+        hits += stacks->histogram[d];
+    }
+    return stacks->accesses ? (double)hits / stacks->accesses : 0;
+}
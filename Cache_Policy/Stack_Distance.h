@@ -0,0 +1,78 @@
+#ifndef __STACK_DISTANCE_HH__
+#define __STACK_DISTANCE_HH__
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h> // uint64_t
+
+// Mattson stack distances.
+//
+// The stack distance of an access is the number of distinct blocks touched
+// since the previous access to the same block. A fully-associative LRU cache
+// of C blocks hits exactly the accesses with a distance below C, so one pass
+// gives the hit rate of every cache size.
+//
+// Every access gets a position (its time). A Fenwick tree over positions
+// marks the position of the last access of each block; the distance of an
+// access is the number of marks after the previous access of its block,
+// O(log n). When positions run out the live marks are renumbered in order
+// (compaction), so the tree stays within twice the number of blocks.
+
+#define cold_miss UINT64_MAX // Distance of the first access to a block
+
+typedef struct Stack_Distance
+{
+    // Distinct blocks, in order of first access
+    uint64_t *blocks;
+    uint64_t *last_access; // Position of the last access of each block
+    uint64_t num_blocks;
+    uint64_t blocks_capacity;
+
+    // Open-addressing (linear probing) hash table: block -> index + 1, 0 is empty
+    uint32_t *slots;
+    uint64_t slot_mask;
+
+    // Fenwick tree over positions, and the block accessed at each position
+    uint32_t *tree;
+    uint32_t *owner;
+    uint64_t capacity; // Positions
+    uint64_t now; // Next position
+
+    // Distance histogram; histogram[d] counts accesses at distance d
+    uint64_t *histogram;
+    uint64_t accesses;
+    uint64_t cold_misses;
+}Stack_Distance;
+
+// Per-set LRU stacks of a cache with num_sets sets, one move-to-front list
+// per set. Distances at or beyond max_assoc are all counted as max_assoc.
+typedef struct Set_Stacks
+{
+    unsigned num_sets;
+    unsigned max_assoc;
+
+    uint64_t *stacks; // num_sets x max_assoc blocks, most recent first
+    unsigned *depth; // Valid entries of each stack
+
+    uint64_t *histogram; // max_assoc + 1 buckets
+    uint64_t accesses;
+}Set_Stacks;
+
+Stack_Distance *initStackDistance();
+void freeStackDistance(Stack_Distance *stack);
+uint64_t accessStack(Stack_Distance *stack, uint64_t block);
+// Hit rate of a fully-associative LRU cache of size blocks
+double stackHitRate(const Stack_Distance *stack, uint64_t size);
+
+Set_Stacks *initSetStacks(unsigned num_sets, unsigned max_assoc);
+void freeSetStacks(Set_Stacks *stacks);
+unsigned accessSetStack(Set_Stacks *stacks, uint64_t block);
+// Hit rate of an assoc-way LRU cache with num_sets sets
+double setStackHitRate(const Set_Stacks *stacks, unsigned assoc);
+
+#endif
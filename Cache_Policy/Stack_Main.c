@@ -0,0 +1,150 @@
+#include "Trace.h"
+#include "Stack_Distance.h"
+
+// One-pass LRU hit-rate curves of a memory trace: every fully-associative
+// cache size at once and, with --sets, every associativity for a given
+// number of sets.
+
+extern TraceParser *initTraceParser(const char * mem_file);
+extern bool getRequest(TraceParser *mem_trace);
+extern void closeTraceParser(TraceParser *mem_trace);
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s [options] %s\n", prog, "<mem-file>");
+    printf("  --block B          block size in bytes (default 64)\n");
+    printf("  --sets S           also report set-associative curves for S sets\n");
+    printf("  --max-assoc A      largest associativity reported with --sets (default 32)\n");
+    printf("  --csv <file>       write the full fully-associative curve as CSV\n");
+}
+
+// The fully-associative curve at every distance where it changes
+static bool dumpCurve(const Stack_Distance *stack, unsigned block_size, const char *csv_file)
+{
+    FILE *fd = fopen(csv_file, "w");
+    if (fd == NULL)
+    {
+        perror(csv_file);
+        return false;
+    }
+
+    fprintf(fd, "blocks,bytes,hit_rate\n");
+    uint64_t hits = 0;
+    uint64_t d;
+    for (d = 0; d < stack->num_blocks; d++)
+    {
+        if (stack->histogram[d] == 0)
+        {
+            continue;
+        }
+        hits += stack->histogram[d];
+        // A cache of d + 1 blocks also hits the accesses at distance d
+        fprintf(fd, "%"PRIu64",%"PRIu64",%f\n", d + 1, (d + 1) * block_size,
+                100.0 * hits / stack->accesses);
+    }
+
+    return fclose(fd) == 0;
+}
+
+int main(int argc, const char *argv[])
+{
+    const char *mem_file = NULL;
+    const char *csv_file = NULL;
+    unsigned block_size = 64;
+    unsigned num_sets = 0;
+    unsigned max_assoc = 32;
+
+    int arg;
+    for (arg = 1; arg < argc; arg++)
+    {
+        if (strcmp(argv[arg], "--block") == 0 && arg + 1 < argc)
+        {
+            block_size = atoi(argv[++arg]);
+        }
+        else if (strcmp(argv[arg], "--sets") == 0 && arg + 1 < argc)
+        {
+            num_sets = atoi(argv[++arg]);
+        }
+        else if (strcmp(argv[arg], "--max-assoc") == 0 && arg + 1 < argc)
+        {
+            max_assoc = atoi(argv[++arg]);
+        }
+        else if (strcmp(argv[arg], "--csv") == 0 && arg + 1 < argc)
+        {
+            csv_file = argv[++arg];
+        }
+        else if (argv[arg][0] != '-' && mem_file == NULL)
+        {
+            mem_file = argv[arg];
+        }
+        else
+        {
+            mem_file = NULL;
+            break;
+        }
+    }
+
+    if (mem_file == NULL || block_size == 0 || max_assoc == 0)
+    {
+        usage(argv[0]);
+
+        return 0;
+    }
+
+    TraceParser *mem_trace = initTraceParser(mem_file);
+    if (mem_trace == NULL)
+    {
+        return 1;
+    }
+
+    Stack_Distance *stack = initStackDistance();
+    Set_Stacks *set_stacks = num_sets > 0 ? initSetStacks(num_sets, max_assoc) : NULL;
+
+    while (getRequest(mem_trace))
+    {
+        uint64_t block = mem_trace->cur_req->load_or_store_addr / block_size;
+
+        accessStack(stack, block);
+        if (set_stacks != NULL)
+        {
+            accessSetStack(set_stacks, block);
+        }
+    }
+    closeTraceParser(mem_trace);
+
+    printf("Accesses: %"PRIu64"\n", stack->accesses);
+    printf("Distinct blocks (cold misses): %"PRIu64"\n", stack->cold_misses);
+
+    printf("Fully-associative LRU\n");
+    printf("%12s %12s %10s\n", "Size (KB)", "Blocks", "Hit rate");
+    uint64_t size;
+    for (size = 1; ; size *= 2)
+    {
+        printf("%12.2f %12"PRIu64" %9.4f%%\n", (double)size * block_size / 1024, size,
+               100.0 * stackHitRate(stack, size));
+        if (size >= stack->num_blocks)
+        {
+            break;
+        }
+    }
+
+    if (set_stacks != NULL)
+    {
+        printf("Set-associative LRU, %u sets\n", num_sets);
+        printf("%12s %12s %10s\n", "Size (KB)", "Assoc", "Hit rate");
+        unsigned assoc;
+        for (assoc = 1; assoc <= max_assoc; assoc++)
+        {
+            printf("%12.2f %12u %9.4f%%\n", (double)num_sets * assoc * block_size / 1024, assoc,
+                   100.0 * setStackHitRate(set_stacks, assoc));
+        }
+        freeSetStacks(set_stacks);
+    }
+
+    if (csv_file != NULL)
+    {
+        dumpCurve(stack, block_size, csv_file);
+    }
+
+    freeStackDistance(stack);
+}
@@ -2,62 +2,143 @@
 
 TraceParser *initTraceParser(const char * mem_file)
 {
+    return openTraceParser(mem_file, 0);
+}
+
+TraceParser *openTraceParser(const char * mem_file, unsigned decode_threads)
+{
+    FILE *fd = openTraceFile(mem_file);
+    if (fd == NULL)
+    {
+        perror(mem_file);
+        return NULL;
+    }
+
+    Stream_Kind kind;
+    uint32_t flags;
+    Chunk_Reader *chunked = openChunkReader(fd);
+    bool binary = chunked != NULL || readStreamHeader(fd, &kind, &flags);
+    kind = chunked != NULL ? chunked->kind : kind;
+    if (binary && kind == BRANCH_STREAM)
+    {
+        fprintf(stderr, "%s is a %s stream, not a memory trace\n", mem_file, streamKindName(kind));
+        if (chunked != NULL)
+        {
+            closeChunkReader(chunked);
+        }
+        fclose(fd);
+        return NULL;
+    }
+
     TraceParser *trace_parser = (TraceParser *)malloc(sizeof(TraceParser));
 
-    trace_parser->fd = fopen(mem_file, "r");
+    trace_parser->fd = fd;
     trace_parser->cur_req = (Request *)malloc(sizeof(Request));
+    trace_parser->binary = binary;
+    trace_parser->kind = kind;
+    trace_parser->chunked = chunked;
+    trace_parser->rejected_lines = 0;
+
+    // Text traces decode to the records of a memory stream
+    trace_parser->pipeline = NULL;
+    if (decode_threads > 0)
+    {
+        trace_parser->pipeline = openDecodePipeline(fd, binary ? kind : MEMORY_STREAM, !binary,
+                                                    chunked, decode_threads);
+    }
 
     return trace_parser;
 }
 
+void closeTraceParser(TraceParser *mem_trace)
+{
+    if (mem_trace->pipeline != NULL)
+    {
+        mem_trace->rejected_lines += mem_trace->pipeline->rejected_lines;
+        closeDecodePipeline(mem_trace->pipeline);
+    }
+    if (mem_trace->rejected_lines > 0)
+    {
+        fprintf(stderr, "Skipped %"PRIu64" malformed trace lines\n", mem_trace->rejected_lines);
+    }
+    if (mem_trace->chunked != NULL)
+    {
+        closeChunkReader(mem_trace->chunked);
+    }
+    fclose(mem_trace->fd);
+    free(mem_trace->cur_req);
+    free(mem_trace);
+}
+
+// The next load or store of a binary stream, or of any trace decoded on
+// threads of its own
+static bool getBinaryRequest(TraceParser *mem_trace)
+{
+    Stream_Record record;
+    do
+    {
+        bool more;
+        if (mem_trace->pipeline != NULL)
+        {
+            more = readDecodedRecord(mem_trace->pipeline, &record);
+        }
+        else
+        {
+            more = mem_trace->chunked != NULL ? readChunkRecord(mem_trace->chunked, &record)
+                                              : readFlatRecord(mem_trace->fd, mem_trace->kind, &record);
+        }
+        if (!more)
+        {
+            if ((mem_trace->chunked != NULL && mem_trace->chunked->corrupt) ||
+                (mem_trace->pipeline != NULL && mem_trace->pipeline->corrupt))
+            {
+                fprintf(stderr, "Corrupt chunk, the trace ends early\n");
+            }
+            return false;
+        }
+    } while (record.type != LOAD_RECORD && record.type != STORE_RECORD);
+
+    mem_trace->cur_req->req_type = record.type == STORE_RECORD ? STORE : LOAD;
+    mem_trace->cur_req->load_or_store_addr = record.addr;
+    mem_trace->cur_req->PC = record.PC;
+    mem_trace->cur_req->core_id = record.core;
+    mem_trace->cur_req->next_use = no_next_use;
+    return true;
+}
+
 bool getRequest(TraceParser *mem_trace)
 {
+    if (mem_trace->binary || mem_trace->pipeline != NULL)
+    {
+        return getBinaryRequest(mem_trace);
+    }
+
+    // Parsed as on the decode threads (see parseTextRecord()); lines that
+    // are not records are left out and counted
     char *line = NULL;
     size_t len = 0;
-    ssize_t read;
+    Stream_Record record;
 
-    if ((read = getline(&line, &len, mem_trace->fd)) != -1)
+    while (getline(&line, &len, mem_trace->fd) != -1)
     {
-	char delim[] = " \n";
-
-	char *ptr = strtok(line, delim);
-        // Extract core ID
-        int core_id = atoi(ptr);
-        // Extract PC
-        ptr = strtok(NULL, delim);
-        uint64_t PC = convToUint64(ptr);
-        // Extract Load or Store Address
-        ptr = strtok(NULL, delim);
-        uint64_t load_or_store_addr = convToUint64(ptr);
-        // Extract Request Type
-        ptr = strtok(NULL, delim);
-        Request_Type req_type;
-        if (strcmp(ptr, "L") == 0)
+        if (!parseTextRecord(line, MEMORY_STREAM, &record))
         {
-            req_type = LOAD;
-        }
-        else if (strcmp(ptr, "S") == 0)
-        {
-            req_type = STORE;
+            mem_trace->rejected_lines += !isBlankLine(line);
+            continue;
         }
 
-        mem_trace->cur_req->req_type = req_type;
-        mem_trace->cur_req->load_or_store_addr = load_or_store_addr;
-        mem_trace->cur_req->PC = PC;
-        mem_trace->cur_req->core_id = core_id;
+        mem_trace->cur_req->req_type = record.type == STORE_RECORD ? STORE : LOAD;
+        mem_trace->cur_req->load_or_store_addr = record.addr;
+        mem_trace->cur_req->PC = record.PC;
+        mem_trace->cur_req->core_id = record.core;
+        mem_trace->cur_req->next_use = no_next_use;
 
         free(line);
-        line = NULL;
-//        printMemRequest(mem_trace->cur_req);
-	return true;
+        return true;
     }
 
-    // Release memory
+    // End of the trace, the parser stays open until closeTraceParser()
     free(line);
-
-    fclose(mem_trace->fd);
-    free(mem_trace->cur_req);
-    free(mem_trace);
     return false;
 }
 
@@ -7,16 +7,35 @@
 #include <string.h>
 
 #include "Request.h"
+#include "Binary_Trace.h"
+#include "Chunked_Trace.h"
+#include "Trace_Decode.h"
 
 typedef struct TraceParser
 {
     FILE *fd; // file descriptor for the trace file
 
     Request *cur_req; // current instruction
+
+    // Binary streams, flat (see Binary_Trace.h) or chunked (Chunked_Trace.h)
+    bool binary;
+    Stream_Kind kind;
+    Chunk_Reader *chunked; // NULL if flat
+
+    Decode_Pipeline *pipeline; // NULL if decoded on the caller's thread
+
+    uint64_t rejected_lines; // Text lines that are not records, left out
 }TraceParser;
 
 // Define functions
+// NULL if the trace cannot be opened or is a binary stream of branches.
+// Text traces, binary streams and chunked containers are told apart by their
+// first bytes; of a CPU stream only the loads and stores are read.
 TraceParser *initTraceParser(const char * mem_file);
+// The same, decoding on decode_threads threads (see Trace_Decode.h), 0 for
+// none
+TraceParser *openTraceParser(const char * mem_file, unsigned decode_threads);
+void closeTraceParser(TraceParser *mem_trace);
 bool getRequest(TraceParser *mem_trace);
 uint64_t convToUint64(char *ptr);
 void printMemRequest(Request *req);
@@ -0,0 +1,59 @@
+#include "Victim_Cache.h"
+
+Victim_Cache *initVictimCache(unsigned num_entries)
+{
+    Victim_Cache *victim_cache = (Victim_Cache *)malloc(sizeof(Victim_Cache));
+
+    victim_cache->entries = (Victim_Entry *)calloc(num_entries, sizeof(Victim_Entry));
+    victim_cache->num_entries = num_entries;
+
+    return victim_cache;
+}
+
+void freeVictimCache(Victim_Cache *victim_cache)
+{
+    free(victim_cache->entries);
+    free(victim_cache);
+}
+
+Victim_Entry *findVictim(Victim_Cache *victim_cache, uint64_t block)
+{
+    unsigned i;
+    for (i = 0; i < victim_cache->num_entries; i++)
+    {
+        Victim_Entry *entry = &victim_cache->entries[i];
+        if (entry->valid && entry->block == block)
+        {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+bool putVictim(Victim_Cache *victim_cache, Victim_Entry *entry, uint64_t block, bool dirty,
+               uint64_t time)
+{
+    bool wb_required = false;
+    if (entry == NULL)
+    {
+        // An invalid entry, else the least recent one
+        entry = &victim_cache->entries[0];
+        unsigned i;
+        for (i = 0; i < victim_cache->num_entries && entry->valid; i++)
+        {
+            Victim_Entry *other = &victim_cache->entries[i];
+            if (!other->valid || other->when_touched < entry->when_touched)
+            {
+                entry = other;
+            }
+        }
+        wb_required = entry->valid && entry->dirty;
+    }
+
+    entry->block = block;
+    entry->when_touched = time;
+    entry->valid = true;
+    entry->dirty = dirty;
+
+    return wb_required;
+}
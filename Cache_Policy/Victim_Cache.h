@@ -0,0 +1,45 @@
+#ifndef __VICTIM_CACHE_HH__
+#define __VICTIM_CACHE_HH__
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h> // uint64_t
+
+// A victim cache: a few fully-associative entries behind the cache, holding
+// the blocks it evicts. A miss of the cache probes it; on a hit the block
+// goes back to the cache and the block the cache evicts for it takes its
+// entry (swap on hit), else the evicted block replaces the least recently
+// put or swapped entry. Dirty blocks stay dirty until they leave it.
+
+#define max_victim_entries 1024
+
+typedef struct Victim_Entry
+{
+    uint64_t block; // Block number
+    uint64_t when_touched;
+    bool valid;
+    bool dirty;
+}Victim_Entry;
+
+typedef struct Victim_Cache
+{
+    Victim_Entry *entries;
+    unsigned num_entries;
+}Victim_Cache;
+
+Victim_Cache *initVictimCache(unsigned num_entries);
+void freeVictimCache(Victim_Cache *victim_cache);
+// The entry of block, NULL if it is not there. Swap it with the block the
+// cache evicts through putVictim(), or invalidate it if the cache evicted
+// none.
+Victim_Entry *findVictim(Victim_Cache *victim_cache, uint64_t block);
+// Put a block the cache evicted in entry, found or NULL for the least
+// recent one. Returns true if that pushes out a dirty block to write back.
+bool putVictim(Victim_Cache *victim_cache, Victim_Entry *entry, uint64_t block, bool dirty,
+               uint64_t time);
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef __CACHESIM_HH__
+#define __CACHESIM_HH__
+
+#include <stdbool.h>
+
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h> // uint64_t
+
+#include "Cache_Config.h"
+
+// libcachesim: the set-associative cache as a library.
+//
+// Every cache is an independent instance built from a Cache_Config; there
+// is no global state, so any number of them can run in one process (one
+// thread per instance at a time). The header needs nothing from the trace
+// side, so it can sit next to bpsim.h.
+
+// Of the accesses through accessCache()
+typedef struct Cache_Stats
+{
+    uint64_t accesses;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions; // Valid blocks replaced
+    uint64_t writebacks; // Dirty blocks replaced
+}Cache_Stats;
+
+typedef struct Cache Cache;
+
+// NULL if the configuration is invalid or the memory cannot be had
+CACHESIM_API Cache *initCache(const Cache_Config *config);
+CACHESIM_API void freeCache(Cache *cache);
+// Back to the state of a new cache with the same policy, statistics included
+CACHESIM_API void resetCache(Cache *cache);
+
+// Switch to another policy than the one of the config; call before the
+// first access. BELADY_POLICY needs the next use of every request, which
+// accessCache() does not have.
+CACHESIM_API void setPolicy(Cache *cache, Replacement_Policy policy);
+CACHESIM_API Replacement_Policy getPolicy(const Cache *cache);
+CACHESIM_API const char *policyName(Replacement_Policy policy);
+// Parse a policy by name, see Cache_Config.h
+CACHESIM_API bool parsePolicy(const char *name, Replacement_Policy *policy);
+// The access kernel the cache runs: "generic", or the geometry it is
+// specialized for, "8x64" for 8 ways of 64 B blocks
+CACHESIM_API const char *kernelName(const Cache *cache);
+
+// Access the block of addr for the instruction at PC, inserting it on a
+// miss. Returns whether it hit.
+CACHESIM_API bool accessCache(Cache *cache, uint64_t PC, uint64_t addr, bool store, int core_id);
+// accessCache() count times in order, on core 0; stores may be NULL for
+// loads only. hit_out[i] tells whether access i hit. Returns the number of
+// hits.
+CACHESIM_API uint64_t accessCacheBatch(Cache *cache, const uint64_t *pcs, const uint64_t *addrs,
+                                       const uint8_t *stores, unsigned count, uint8_t *hit_out);
+
+CACHESIM_API void getCacheStats(const Cache *cache, Cache_Stats *stats);
+
+#endif
@@ -0,0 +1,92 @@
+#include "Arena.h"
+
+#include <sys/mman.h>
+
+bool initArena(Arena *arena, uint64_t size, Arena_Pages pages)
+{
+    arena->used = 0;
+    arena->hugetlb = false;
+    arena->mapped = size >= huge_page_size;
+
+    if (!arena->mapped)
+    {
+        arena->size = arenaBytes(size);
+        arena->base = (char *)calloc(1, arena->size);
+        return arena->base != NULL;
+    }
+
+    arena->size = (size + huge_page_size - 1) & ~(huge_page_size - 1);
+
+    #ifdef MAP_HUGETLB
+    if (pages == HUGETLB_PAGES)
+    {
+        void *base = mmap(NULL, arena->size, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (base != MAP_FAILED)
+        {
+            arena->base = (char *)base;
+            arena->hugetlb = true;
+            return true;
+        }
+    }
+    #endif
+
+    // Map a huge page more than needed, then trim to a huge page boundary
+    char *base = (char *)mmap(NULL, arena->size + huge_page_size, PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == (char *)MAP_FAILED)
+    {
+        perror("arena");
+        arena->base = NULL;
+        return false;
+    }
+    uint64_t head = (huge_page_size - (uintptr_t)base % huge_page_size) % huge_page_size;
+    if (head > 0)
+    {
+        munmap(base, head);
+    }
+    munmap(base + head + arena->size, huge_page_size - head);
+    arena->base = base + head;
+
+    #ifdef MADV_HUGEPAGE
+    if (pages != SMALL_PAGES)
+    {
+        madvise(arena->base, arena->size, MADV_HUGEPAGE);
+    }
+    #endif
+
+    return true;
+}
+
+void freeArena(Arena *arena)
+{
+    if (arena->mapped)
+    {
+        munmap(arena->base, arena->size);
+    }
+    else
+    {
+        free(arena->base);
+    }
+    arena->base = NULL;
+}
+
+const char *arenaPagesName(Arena_Pages pages)
+{
+    static const char *names[] = {"none", "thp", "hugetlb"};
+    return names[pages];
+}
+
+bool parseArenaPages(const char *name, Arena_Pages *pages)
+{
+    Arena_Pages p;
+    for (p = SMALL_PAGES; p <= HUGETLB_PAGES; p++)
+    {
+        if (strcmp(name, arenaPagesName(p)) == 0)
+        {
+            *pages = p;
+            return true;
+        }
+    }
+    return false;
+}
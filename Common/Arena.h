@@ -0,0 +1,60 @@
+#ifndef __ARENA_HH__
+#define __ARENA_HH__
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h> // uint64_t
+
+// One allocation per simulator instance.
+//
+// The owner adds up what it needs (arenaBytes() of every piece), reserves
+// it at once and carves it up with arenaAlloc(); teardown is freeArena().
+// Memory comes zeroed, so only non-zero state needs initializing.
+// Arenas of at least a huge page are mmap'ed 2 MB aligned and, unless
+// SMALL_PAGES, backed by transparent huge pages (madvise) or by the
+// reserved hugetlbfs pool (MAP_HUGETLB, falling back to madvise if the pool
+// is empty), which keeps TLB misses down on large tables.
+
+typedef enum Arena_Pages{SMALL_PAGES, HUGE_PAGES, HUGETLB_PAGES}Arena_Pages;
+
+#define arena_align 64 // Cache line
+#define huge_page_size (2ull << 20)
+
+typedef struct Arena
+{
+    char *base;
+    uint64_t size; // Reserved bytes
+    uint64_t used;
+    bool mapped; // From mmap, else from calloc
+    bool hugetlb; // From the hugetlbfs pool
+}Arena;
+
+// Room a piece of size bytes takes in an arena
+static inline uint64_t arenaBytes(uint64_t size)
+{
+    return (size + arena_align - 1) & ~(uint64_t)(arena_align - 1);
+}
+
+// Returns false if the memory cannot be had
+bool initArena(Arena *arena, uint64_t size, Arena_Pages pages);
+void freeArena(Arena *arena);
+
+static inline void *arenaAlloc(Arena *arena, uint64_t size)
+{
+    assert(arena->used + arenaBytes(size) <= arena->size);
+
+    void *ptr = arena->base + arena->used;
+    arena->used += arenaBytes(size);
+    return ptr;
+}
+
+const char *arenaPagesName(Arena_Pages pages);
+// Parse none, thp or hugetlb
+bool parseArenaPages(const char *name, Arena_Pages *pages);
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef __BENCH_HH__
+#define __BENCH_HH__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h> // uint64_t
+
+// Helpers shared by the Bench programs: a seeded generator so every
+// synthetic trace is reproducible, a clock and peak RSS.
+
+// splitmix64
+static inline uint64_t benchRandom(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// Uniform in [0, 1)
+static inline double benchUniform(uint64_t *state)
+{
+    return (double)(benchRandom(state) >> 11) / (double)(1ull << 53);
+}
+
+static inline uint64_t benchNowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// Peak resident set size of this process (in KB)
+static inline long benchPeakRssKb()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+#endif
@@ -0,0 +1,217 @@
+#define _GNU_SOURCE // fopencookie()
+#include "Binary_Trace.h"
+
+#include <errno.h>
+
+static void putLE(unsigned char *buf, uint64_t val, unsigned bytes)
+{
+    unsigned i;
+    for (i = 0; i < bytes; i++)
+    {
+        buf[i] = val >> (8 * i);
+    }
+}
+
+static uint64_t getLE(const unsigned char *buf, unsigned bytes)
+{
+    uint64_t val = 0;
+    unsigned i;
+    for (i = 0; i < bytes; i++)
+    {
+        val |= (uint64_t)buf[i] << (8 * i);
+    }
+    return val;
+}
+
+// A pipe, with its first bytes kept to go back to
+typedef struct Pipe_Replay
+{
+    FILE *pipe;
+    unsigned char head[replay_bytes];
+    size_t head_bytes; // Read from the pipe so far, while they fit in head
+    uint64_t pos;
+    bool past_head; // Read beyond head, no going back
+}Pipe_Replay;
+
+static ssize_t readReplay(void *cookie, char *buf, size_t size)
+{
+    Pipe_Replay *replay = (Pipe_Replay *)cookie;
+    if (replay->pos < replay->head_bytes)
+    {
+        size_t bytes = replay->head_bytes - replay->pos;
+        bytes = bytes < size ? bytes : size;
+        memcpy(buf, &replay->head[replay->pos], bytes);
+        replay->pos += bytes;
+        return bytes;
+    }
+
+    size_t got = fread(buf, 1, size, replay->pipe);
+    if (got == 0 && ferror(replay->pipe))
+    {
+        return -1;
+    }
+    if (!replay->past_head && replay->pos + got <= replay_bytes)
+    {
+        memcpy(&replay->head[replay->pos], buf, got);
+        replay->head_bytes += got;
+    }
+    else
+    {
+        replay->past_head = true;
+    }
+    replay->pos += got;
+    return got;
+}
+
+// Only back within head, or to where the pipe stands (ftell())
+static int seekReplay(void *cookie, off64_t *offset, int whence)
+{
+    Pipe_Replay *replay = (Pipe_Replay *)cookie;
+    int64_t target = whence == SEEK_SET ? *offset
+                     : whence == SEEK_CUR ? (int64_t)replay->pos + *offset : -1;
+    if (target < 0 || ((uint64_t)target != replay->pos &&
+                       (replay->past_head || (uint64_t)target > replay->head_bytes)))
+    {
+        errno = ESPIPE;
+        return -1;
+    }
+    replay->pos = target;
+    *offset = target;
+    return 0;
+}
+
+static int closeReplay(void *cookie)
+{
+    Pipe_Replay *replay = (Pipe_Replay *)cookie;
+    int ret = fclose(replay->pipe);
+    free(replay);
+    return ret;
+}
+
+FILE *openTraceFile(const char *file)
+{
+    FILE *fd = fopen(file, "rb");
+    if (fd == NULL || fseek(fd, 0, SEEK_CUR) == 0)
+    {
+        return fd;
+    }
+
+    Pipe_Replay *replay = (Pipe_Replay *)calloc(1, sizeof(Pipe_Replay));
+    cookie_io_functions_t functions = {readReplay, NULL, seekReplay, closeReplay};
+    FILE *replayed = replay != NULL ? fopencookie(replay, "rb", functions) : NULL;
+    if (replayed == NULL)
+    {
+        free(replay);
+        fclose(fd);
+        return NULL;
+    }
+    replay->pipe = fd;
+    return replayed;
+}
+
+bool readStreamHeader(FILE *fd, Stream_Kind *kind, uint32_t *flags)
+{
+    unsigned char header[16];
+    if (fread(header, sizeof(header), 1, fd) == 1 &&
+        memcmp(header, binary_trace_magic, 8) == 0 && getLE(&header[8], 4) <= MEMORY_STREAM)
+    {
+        *kind = (Stream_Kind)getLE(&header[8], 4);
+        *flags = getLE(&header[12], 4);
+        return true;
+    }
+
+    rewind(fd);
+    return false;
+}
+
+bool writeStreamHeader(FILE *fd, Stream_Kind kind, uint32_t flags)
+{
+    unsigned char header[16];
+    memcpy(header, binary_trace_magic, 8);
+    putLE(&header[8], kind, 4);
+    putLE(&header[12], flags, 4);
+    return fwrite(header, sizeof(header), 1, fd) == 1;
+}
+
+bool readBranchRecord(FILE *fd, Branch_Record *record)
+{
+    unsigned char buf[branch_record_size];
+    if (fread_unlocked(buf, sizeof(buf), 1, fd) != 1)
+    {
+        return false;
+    }
+    record->PC = getLE(&buf[0], 8);
+    record->skipped = getLE(&buf[8], 4);
+    record->taken = buf[12];
+    return true;
+}
+
+bool readMemoryRecord(FILE *fd, Memory_Record *record)
+{
+    unsigned char buf[memory_record_size];
+    if (fread_unlocked(buf, sizeof(buf), 1, fd) != 1)
+    {
+        return false;
+    }
+    record->PC = getLE(&buf[0], 8);
+    record->addr = getLE(&buf[8], 8);
+    record->core = buf[16];
+    record->store = buf[17];
+    record->size = getLE(&buf[18], 2);
+    return true;
+}
+
+bool writeBranchRecord(FILE *fd, const Branch_Record *record)
+{
+    unsigned char buf[branch_record_size];
+    putLE(&buf[0], record->PC, 8);
+    putLE(&buf[8], record->skipped, 4);
+    buf[12] = record->taken;
+    return fwrite_unlocked(buf, sizeof(buf), 1, fd) == 1;
+}
+
+bool writeMemoryRecord(FILE *fd, const Memory_Record *record)
+{
+    unsigned char buf[memory_record_size];
+    putLE(&buf[0], record->PC, 8);
+    putLE(&buf[8], record->addr, 8);
+    buf[16] = record->core;
+    buf[17] = record->store;
+    putLE(&buf[18], record->size, 2);
+    return fwrite_unlocked(buf, sizeof(buf), 1, fd) == 1;
+}
+
+unsigned flatRecordSize(Stream_Kind kind)
+{
+    return kind == BRANCH_STREAM ? branch_record_size : memory_record_size;
+}
+
+void decodeFlatRecord(const unsigned char *buf, Stream_Kind kind, Stream_Record *record)
+{
+    if (kind == BRANCH_STREAM)
+    {
+        *record = (Stream_Record){getLE(&buf[0], 8), 0, getLE(&buf[8], 4), 0,
+                                  buf[12] == skip_only ? SKIP_RECORD : BRANCH_RECORD,
+                                  buf[12] == 1, 0};
+        return;
+    }
+    *record = (Stream_Record){getLE(&buf[0], 8), getLE(&buf[8], 8), 0, getLE(&buf[18], 2),
+                              buf[17] ? STORE_RECORD : LOAD_RECORD, 0, buf[16]};
+}
+
+bool readFlatRecord(FILE *fd, Stream_Kind kind, Stream_Record *record)
+{
+    unsigned char buf[memory_record_size];
+    if (kind > MEMORY_STREAM || fread_unlocked(buf, flatRecordSize(kind), 1, fd) != 1)
+    {
+        return false;
+    }
+    decodeFlatRecord(buf, kind, record);
+    return true;
+}
+
+const char *streamKindName(Stream_Kind kind)
+{
+    static const char *names[] = {"branch", "memory", "cpu"};
+    return names[kind];
+}
@@ -0,0 +1,96 @@
+#ifndef __BINARY_TRACE_HH__
+#define __BINARY_TRACE_HH__
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h> // uint64_t
+
+// Compact binary trace streams, written by Trace_Tools/Filter and read by
+// the TraceParser of both simulators in place of text traces. These flat
+// streams hold fixed-size records; Chunked_Trace.h stores the same records
+// compressed.
+//
+// A stream starts with the 8 byte magic "BTRACE01", its kind and its flags
+// (uint32_t each), then holds fixed-size little-endian records:
+//   branch stream: PC (8 bytes), skipped (4), taken (1)
+//   memory stream: PC (8), address (8), core (1), store (1), size (2)
+// skipped counts the other instructions of the original trace right before
+// the branch, so that a branch stream keeps the instruction count. A record
+// whose taken byte is skip_only carries skipped alone: it ends the stream
+// if instructions follow the last branch, or splits a run too long for 32
+// bits.
+
+#define binary_trace_magic "BTRACE01"
+#define skip_only 0xff
+
+// CPU streams, every instruction of a CPU trace, only come chunked
+typedef enum Stream_Kind{BRANCH_STREAM, MEMORY_STREAM, CPU_STREAM}Stream_Kind;
+
+// Flags
+#define l1_filtered_stream 1 // Only the accesses missing a front cache
+
+#define branch_record_size 13
+#define memory_record_size 20
+
+typedef struct Branch_Record
+{
+    uint64_t PC;
+    uint32_t skipped;
+    uint8_t taken; // 0, 1 or skip_only
+}Branch_Record;
+
+typedef struct Memory_Record
+{
+    uint64_t PC;
+    uint64_t addr;
+    uint8_t core;
+    bool store;
+    uint16_t size; // In bytes, 0 if the original trace has none
+}Memory_Record;
+
+// Any record of any stream. SKIP_RECORD carries skipped alone.
+typedef enum Record_Type{EXE_RECORD, BRANCH_RECORD, LOAD_RECORD, STORE_RECORD,
+                         SKIP_RECORD}Record_Type;
+
+typedef struct Stream_Record
+{
+    uint64_t PC;
+    uint64_t addr; // Loads and stores
+    uint32_t skipped; // Instructions left out right before this one
+    uint16_t size; // Loads and stores
+    uint8_t type; // Record_Type
+    uint8_t taken; // Branches
+    uint8_t core;
+}Stream_Record;
+
+// fopen() a trace to read. Telling a text trace from a binary one takes
+// reading its first bytes and going back, which a pipe cannot do; a pipe is
+// read through a stream that keeps its first replay_bytes to go back to.
+// NULL, with errno set, if the file does not open.
+#define replay_bytes (1 << 16)
+FILE *openTraceFile(const char *file);
+
+// True, with the kind and flags, if fd is at the start of a binary stream.
+// Otherwise fd is back at its start, for a text trace.
+bool readStreamHeader(FILE *fd, Stream_Kind *kind, uint32_t *flags);
+bool writeStreamHeader(FILE *fd, Stream_Kind kind, uint32_t flags);
+
+// False at the end of the stream
+bool readBranchRecord(FILE *fd, Branch_Record *record);
+bool readMemoryRecord(FILE *fd, Memory_Record *record);
+bool writeBranchRecord(FILE *fd, const Branch_Record *record);
+bool writeMemoryRecord(FILE *fd, const Memory_Record *record);
+
+// The next record of a flat stream of kind, as a Stream_Record
+bool readFlatRecord(FILE *fd, Stream_Kind kind, Stream_Record *record);
+// The same, from the flatRecordSize() bytes at buf
+unsigned flatRecordSize(Stream_Kind kind);
+void decodeFlatRecord(const unsigned char *buf, Stream_Kind kind, Stream_Record *record);
+
+const char *streamKindName(Stream_Kind kind);
+
+#endif
@@ -0,0 +1,619 @@
+#include "Chunked_Trace.h"
+
+// Record tags
+#define tag_type_mask 7
+#define tag_taken (1 << 3)
+#define tag_skipped (1 << 4)
+#define tag_core (1 << 5)
+#define tag_size (1 << 6)
+
+#define chunk_header_size 12
+#define trailer_size 32
+#define max_record_bytes 32 // Tag, varints and core of one record
+#define max_varint_bytes 10
+
+#define empty_slot UINT32_MAX
+
+static void putLE(unsigned char *buf, uint64_t val, unsigned bytes)
+{
+    unsigned i;
+    for (i = 0; i < bytes; i++)
+    {
+        buf[i] = val >> (8 * i);
+    }
+}
+
+static uint64_t getLE(const unsigned char *buf, unsigned bytes)
+{
+    uint64_t val = 0;
+    unsigned i;
+    for (i = 0; i < bytes; i++)
+    {
+        val |= (uint64_t)buf[i] << (8 * i);
+    }
+    return val;
+}
+
+static unsigned char *putVarint(unsigned char *p, uint64_t val)
+{
+    while (val >= 0x80)
+    {
+        *p++ = val | 0x80;
+        val >>= 7;
+    }
+    *p++ = val;
+    return p;
+}
+
+static bool getVarint(const unsigned char **p, const unsigned char *end, uint64_t *val)
+{
+    uint64_t v = 0;
+    unsigned shift;
+    for (shift = 0; *p < end && shift < 64; shift += 7)
+    {
+        unsigned char byte = *(*p)++;
+        v |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+        {
+            *val = v;
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint64_t zigzag(int64_t val)
+{
+    return ((uint64_t)val << 1) ^ (uint64_t)(val >> 63);
+}
+
+static int64_t unzigzag(uint64_t val)
+{
+    return (int64_t)(val >> 1) ^ -(int64_t)(val & 1);
+}
+
+static uint64_t guessAddr(const PC_State *state, uint64_t last_addr)
+{
+    return state->seen ? state->last_addr + state->stride : last_addr;
+}
+
+static void updateAddr(PC_State *state, uint64_t addr)
+{
+    state->stride = state->seen ? (int64_t)(addr - state->last_addr) : 0;
+    state->last_addr = addr;
+    state->seen = true;
+}
+
+static bool isMemory(unsigned type)
+{
+    return type == LOAD_RECORD || type == STORE_RECORD;
+}
+
+/* Writer */
+Chunk_Writer *openChunkWriter(FILE *fd, Stream_Kind kind, uint32_t flags, unsigned chunk_records)
+{
+    if (chunk_records == 0 || chunk_records > max_chunk_records)
+    {
+        chunk_records = default_chunk_records;
+    }
+
+    unsigned char header[16];
+    memcpy(header, chunked_trace_magic, 8);
+    putLE(&header[8], kind, 4);
+    putLE(&header[12], flags, 4);
+    if (fwrite(header, sizeof(header), 1, fd) != 1)
+    {
+        return NULL;
+    }
+
+    Chunk_Writer *writer = (Chunk_Writer *)calloc(1, sizeof(Chunk_Writer));
+    writer->fd = fd;
+    writer->chunk_records = chunk_records;
+    writer->records = (Stream_Record *)malloc(chunk_records * sizeof(Stream_Record));
+
+    writer->table_bits = 1;
+    while ((1u << writer->table_bits) < 2 * chunk_records)
+    {
+        ++writer->table_bits;
+    }
+    writer->table_pcs = (uint64_t *)malloc(sizeof(uint64_t) << writer->table_bits);
+    writer->table_index = (unsigned *)malloc(sizeof(unsigned) << writer->table_bits);
+    writer->pcs = (uint64_t *)malloc(chunk_records * sizeof(uint64_t));
+    writer->states = (PC_State *)malloc(chunk_records * sizeof(PC_State));
+
+    writer->buffer = (unsigned char *)malloc((size_t)chunk_records *
+                                             (max_record_bytes + max_varint_bytes));
+    return writer;
+}
+
+// Dictionary index of PC in the chunk, added if new
+static unsigned lookupPC(Chunk_Writer *writer, uint64_t PC, unsigned *num_pcs)
+{
+    uint64_t mask = (1ull << writer->table_bits) - 1;
+    uint64_t slot = (PC * 0x9E3779B97F4A7C15ull) >> (64 - writer->table_bits);
+    while (writer->table_index[slot] != empty_slot && writer->table_pcs[slot] != PC)
+    {
+        slot = (slot + 1) & mask;
+    }
+
+    if (writer->table_index[slot] == empty_slot)
+    {
+        writer->table_pcs[slot] = PC;
+        writer->table_index[slot] = *num_pcs;
+        writer->pcs[(*num_pcs)++] = PC;
+    }
+    return writer->table_index[slot];
+}
+
+static bool flushChunk(Chunk_Writer *writer)
+{
+    if (writer->num_records == 0)
+    {
+        return true;
+    }
+
+    // The dictionary, in order of first use
+    memset(writer->table_index, 0xff, sizeof(unsigned) << writer->table_bits);
+    unsigned num_pcs = 0;
+    unsigned r;
+    for (r = 0; r < writer->num_records; r++)
+    {
+        if (writer->records[r].type != SKIP_RECORD)
+        {
+            lookupPC(writer, writer->records[r].PC, &num_pcs);
+        }
+    }
+
+    unsigned char *p = writer->buffer;
+    uint64_t prev = 0;
+    unsigned i;
+    for (i = 0; i < num_pcs; i++)
+    {
+        p = putVarint(p, zigzag(writer->pcs[i] - prev));
+        prev = writer->pcs[i];
+    }
+    memset(writer->states, 0, num_pcs * sizeof(PC_State));
+
+    uint64_t last_addr = 0;
+    for (r = 0; r < writer->num_records; r++)
+    {
+        const Stream_Record *record = &writer->records[r];
+        unsigned char *tag = p++;
+        *tag = record->type | (record->taken ? tag_taken : 0) |
+               (record->skipped ? tag_skipped : 0) | (record->core ? tag_core : 0);
+
+        PC_State *state = NULL;
+        if (record->type != SKIP_RECORD)
+        {
+            unsigned index = lookupPC(writer, record->PC, &num_pcs);
+            state = &writer->states[index];
+            p = putVarint(p, index);
+        }
+        if (record->skipped)
+        {
+            p = putVarint(p, record->skipped);
+        }
+        if (record->core)
+        {
+            *p++ = record->core;
+        }
+        if (isMemory(record->type))
+        {
+            p = putVarint(p, zigzag(record->addr - guessAddr(state, last_addr)));
+            updateAddr(state, record->addr);
+            last_addr = record->addr;
+            if (record->size != state->last_size)
+            {
+                *tag |= tag_size;
+                p = putVarint(p, record->size);
+                state->last_size = record->size;
+            }
+        }
+    }
+
+    if (writer->num_chunks == writer->index_capacity)
+    {
+        writer->index_capacity = writer->index_capacity ? 2 * writer->index_capacity : 256;
+        writer->index = (Chunk_Index_Entry *)realloc(writer->index, writer->index_capacity *
+                                                     sizeof(Chunk_Index_Entry));
+    }
+    Chunk_Index_Entry *entry = &writer->index[writer->num_chunks++];
+    entry->offset = ftell(writer->fd);
+    entry->first_record = writer->total_records;
+
+    unsigned char header[chunk_header_size];
+    putLE(&header[0], writer->num_records, 4);
+    putLE(&header[4], num_pcs, 4);
+    putLE(&header[8], p - writer->buffer, 4);
+    if (fwrite(header, sizeof(header), 1, writer->fd) != 1 ||
+        fwrite(writer->buffer, p - writer->buffer, 1, writer->fd) != 1)
+    {
+        writer->failed = true;
+    }
+
+    writer->total_records += writer->num_records;
+    writer->num_records = 0;
+    return !writer->failed;
+}
+
+bool writeChunkRecord(Chunk_Writer *writer, const Stream_Record *record)
+{
+    writer->records[writer->num_records++] = *record;
+    return writer->num_records < writer->chunk_records || flushChunk(writer);
+}
+
+bool closeChunkWriter(Chunk_Writer *writer)
+{
+    flushChunk(writer);
+
+    // The empty chunk ending the chunks, the index and its trailer
+    unsigned char header[chunk_header_size] = {0};
+    uint64_t index_offset = ftell(writer->fd);
+    bool ok = !writer->failed && fwrite(header, sizeof(header), 1, writer->fd) == 1;
+
+    uint64_t c;
+    for (c = 0; ok && c < writer->num_chunks; c++)
+    {
+        unsigned char entry[16];
+        putLE(&entry[0], writer->index[c].offset, 8);
+        putLE(&entry[8], writer->index[c].first_record, 8);
+        ok = fwrite(entry, sizeof(entry), 1, writer->fd) == 1;
+    }
+
+    unsigned char trailer[trailer_size];
+    putLE(&trailer[0], index_offset + chunk_header_size, 8);
+    putLE(&trailer[8], writer->num_chunks, 8);
+    putLE(&trailer[16], writer->total_records, 8);
+    memcpy(&trailer[24], chunk_index_magic, 8);
+    ok = ok && fwrite(trailer, sizeof(trailer), 1, writer->fd) == 1 && fflush(writer->fd) == 0;
+
+    free(writer->records);
+    free(writer->table_pcs);
+    free(writer->table_index);
+    free(writer->pcs);
+    free(writer->states);
+    free(writer->buffer);
+    free(writer->index);
+    free(writer);
+    return ok;
+}
+
+/* Reader */
+// Load the index from the trailer; the container is still readable in
+// order without it
+static void readIndex(Chunk_Reader *reader)
+{
+    unsigned char trailer[trailer_size];
+    if (fseek(reader->fd, -trailer_size, SEEK_END) != 0 ||
+        fread(trailer, sizeof(trailer), 1, reader->fd) != 1 ||
+        memcmp(&trailer[24], chunk_index_magic, 8) != 0)
+    {
+        return;
+    }
+
+    // The index sits between the empty chunk and the trailer
+    uint64_t index_offset = getLE(&trailer[0], 8);
+    uint64_t num_chunks = getLE(&trailer[8], 8);
+    uint64_t index_end = reader->file_size - trailer_size;
+    if (index_offset < 16 + chunk_header_size || index_offset > index_end ||
+        num_chunks > (index_end - index_offset) / 16)
+    {
+        reader->corrupt = true;
+        return;
+    }
+    if (fseek(reader->fd, index_offset, SEEK_SET) != 0)
+    {
+        return;
+    }
+
+    reader->index = (Chunk_Index_Entry *)malloc((num_chunks + 1) * sizeof(Chunk_Index_Entry));
+    if (reader->index == NULL)
+    {
+        reader->corrupt = true;
+        return;
+    }
+    uint64_t c;
+    for (c = 0; c < num_chunks; c++)
+    {
+        unsigned char entry[16];
+        if (fread(entry, sizeof(entry), 1, reader->fd) != 1)
+        {
+            free(reader->index);
+            reader->index = NULL;
+            return;
+        }
+        reader->index[c].offset = getLE(&entry[0], 8);
+        reader->index[c].first_record = getLE(&entry[8], 8);
+    }
+    reader->num_chunks = num_chunks;
+    reader->total_records = getLE(&trailer[16], 8);
+    reader->end_offset = index_offset - chunk_header_size;
+}
+
+Chunk_Reader *openChunkReader(FILE *fd)
+{
+    unsigned char header[16];
+    if (fread(header, sizeof(header), 1, fd) != 1 ||
+        memcmp(header, chunked_trace_magic, 8) != 0 || getLE(&header[8], 4) > CPU_STREAM)
+    {
+        rewind(fd);
+        return NULL;
+    }
+
+    Chunk_Reader *reader = (Chunk_Reader *)calloc(1, sizeof(Chunk_Reader));
+    reader->fd = fd;
+    reader->kind = (Stream_Kind)getLE(&header[8], 4);
+    reader->flags = getLE(&header[12], 4);
+
+    // A pipe has no size to check against, nor an index to read
+    reader->file_size = fseek(fd, 0, SEEK_END) == 0 ? (uint64_t)ftell(fd) : UINT64_MAX;
+    readIndex(reader);
+    fseek(fd, sizeof(header), SEEK_SET);
+    return reader;
+}
+
+bool readRawChunk(Chunk_Reader *reader, Raw_Chunk *chunk)
+{
+    // Every container ends its chunks with an empty one, so running out of
+    // file before it means the container was cut short
+    unsigned char header[chunk_header_size];
+    if (reader->corrupt || fread(header, sizeof(header), 1, reader->fd) != 1)
+    {
+        reader->corrupt = true;
+        return false;
+    }
+    chunk->num_records = getLE(&header[0], 4);
+    chunk->num_pcs = getLE(&header[4], 4);
+    chunk->bytes = getLE(&header[8], 4);
+    if (chunk->num_records == 0)
+    {
+        return false;
+    }
+
+    // Check the header before trusting it with an allocation
+    uint64_t max_bytes = (uint64_t)chunk->num_records * max_record_bytes +
+                         (uint64_t)chunk->num_pcs * max_varint_bytes;
+    long offset = ftell(reader->fd);
+    if (chunk->num_records > max_chunk_records || chunk->num_pcs > chunk->num_records ||
+        chunk->bytes > max_bytes || offset < 0 || chunk->bytes > reader->file_size - offset)
+    {
+        reader->corrupt = true;
+        return false;
+    }
+
+    if (chunk->bytes > chunk->capacity)
+    {
+        unsigned char *payload = (unsigned char *)realloc(chunk->payload, chunk->bytes);
+        if (payload == NULL)
+        {
+            reader->corrupt = true;
+            return false;
+        }
+        chunk->payload = payload;
+        chunk->capacity = chunk->bytes;
+    }
+    if (fread(chunk->payload, chunk->bytes, 1, reader->fd) != 1)
+    {
+        reader->corrupt = true;
+        return false;
+    }
+    return true;
+}
+
+// Read the dictionary of a chunk and get ready to decode its records
+static bool startChunk(Chunk_Reader *reader, const Raw_Chunk *chunk)
+{
+    if (chunk->num_pcs > reader->pcs_capacity)
+    {
+        reader->pcs_capacity = chunk->num_pcs;
+        reader->pcs = (uint64_t *)realloc(reader->pcs, chunk->num_pcs * sizeof(uint64_t));
+        reader->states = (PC_State *)realloc(reader->states, chunk->num_pcs * sizeof(PC_State));
+    }
+
+    reader->pos = chunk->payload;
+    reader->end = chunk->payload + chunk->bytes;
+    uint64_t prev = 0;
+    unsigned i;
+    for (i = 0; i < chunk->num_pcs; i++)
+    {
+        uint64_t delta;
+        if (!getVarint(&reader->pos, reader->end, &delta))
+        {
+            reader->corrupt = true;
+            return false;
+        }
+        prev += unzigzag(delta);
+        reader->pcs[i] = prev;
+    }
+    memset(reader->states, 0, chunk->num_pcs * sizeof(PC_State));
+
+    reader->num_pcs = chunk->num_pcs;
+    reader->records_left = chunk->num_records;
+    reader->last_addr = 0;
+    return true;
+}
+
+// Read the next chunk and its dictionary; false at the end of the chunks
+static bool loadChunk(Chunk_Reader *reader)
+{
+    Raw_Chunk chunk = {0, 0, 0, reader->buffer, reader->buffer_size};
+    bool loaded = readRawChunk(reader, &chunk);
+    reader->buffer = chunk.payload;
+    reader->buffer_size = chunk.capacity;
+
+    return loaded && startChunk(reader, &chunk);
+}
+
+static bool decodeRecord(Chunk_Reader *reader, Stream_Record *record)
+{
+    if (reader->pos >= reader->end)
+    {
+        return false;
+    }
+    unsigned tag = *reader->pos++;
+    record->type = tag & tag_type_mask;
+    record->taken = (tag & tag_taken) != 0;
+    record->PC = 0;
+    record->addr = 0;
+    record->size = 0;
+    record->skipped = 0;
+    record->core = 0;
+    if (record->type > SKIP_RECORD)
+    {
+        return false;
+    }
+
+    uint64_t val;
+    PC_State *state = NULL;
+    if (record->type != SKIP_RECORD)
+    {
+        if (!getVarint(&reader->pos, reader->end, &val) || val >= reader->num_pcs)
+        {
+            return false;
+        }
+        record->PC = reader->pcs[val];
+        state = &reader->states[val];
+    }
+    if (tag & tag_skipped)
+    {
+        if (!getVarint(&reader->pos, reader->end, &val))
+        {
+            return false;
+        }
+        record->skipped = val;
+    }
+    if (tag & tag_core)
+    {
+        if (reader->pos >= reader->end)
+        {
+            return false;
+        }
+        record->core = *reader->pos++;
+    }
+    if (isMemory(record->type))
+    {
+        if (!getVarint(&reader->pos, reader->end, &val))
+        {
+            return false;
+        }
+        record->addr = guessAddr(state, reader->last_addr) + unzigzag(val);
+        updateAddr(state, record->addr);
+        reader->last_addr = record->addr;
+        if (tag & tag_size)
+        {
+            if (!getVarint(&reader->pos, reader->end, &val))
+            {
+                return false;
+            }
+            state->last_size = val;
+        }
+        record->size = state->last_size;
+    }
+    return true;
+}
+
+bool readChunkRecord(Chunk_Reader *reader, Stream_Record *record)
+{
+    while (reader->records_left == 0)
+    {
+        if (reader->corrupt || !loadChunk(reader))
+        {
+            return false;
+        }
+    }
+
+    if (!decodeRecord(reader, record))
+    {
+        reader->corrupt = true;
+        reader->records_left = 0;
+        return false;
+    }
+    --reader->records_left;
+    return true;
+}
+
+unsigned decodeChunk(const Raw_Chunk *chunk, Stream_Record *records)
+{
+    // A reader of its own, chunks do not depend on each other
+    Chunk_Reader reader;
+    memset(&reader, 0, sizeof(Chunk_Reader));
+
+    unsigned r = 0;
+    if (startChunk(&reader, chunk))
+    {
+        while (r < chunk->num_records && decodeRecord(&reader, &records[r]))
+        {
+            ++r;
+        }
+    }
+    free(reader.pcs);
+    free(reader.states);
+    return r;
+}
+
+bool seekChunk(Chunk_Reader *reader, uint64_t record, uint64_t *first_record)
+{
+    if (reader->index == NULL || record > reader->total_records)
+    {
+        return false;
+    }
+
+    // The last chunk starting at or before record, else the end
+    uint64_t offset = reader->end_offset;
+    *first_record = reader->total_records;
+    if (record < reader->total_records)
+    {
+        uint64_t lo = 0, hi = reader->num_chunks;
+        while (hi - lo > 1)
+        {
+            uint64_t mid = (lo + hi) / 2;
+            if (reader->index[mid].first_record <= record)
+            {
+                lo = mid;
+            }
+            else
+            {
+                hi = mid;
+            }
+        }
+        offset = reader->index[lo].offset;
+        *first_record = reader->index[lo].first_record;
+    }
+
+    if (fseek(reader->fd, offset, SEEK_SET) != 0)
+    {
+        return false;
+    }
+    reader->records_left = 0;
+    reader->corrupt = false;
+    return true;
+}
+
+bool seekChunkRecord(Chunk_Reader *reader, uint64_t record)
+{
+    uint64_t r;
+    if (record >= reader->total_records || !seekChunk(reader, record, &r))
+    {
+        return false;
+    }
+
+    // Addresses are coded against the ones before, so decode up to record
+    Stream_Record skipped;
+    for (; r < record; r++)
+    {
+        if (!readChunkRecord(reader, &skipped))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void closeChunkReader(Chunk_Reader *reader)
+{
+    free(reader->buffer);
+    free(reader->pcs);
+    free(reader->states);
+    free(reader->index);
+    free(reader);
+}
@@ -0,0 +1,139 @@
+#ifndef __CHUNKED_TRACE_HH__
+#define __CHUNKED_TRACE_HH__
+
+#include "Binary_Trace.h"
+
+// Compressed trace container, written by Trace_Tools/Pack and read by the
+// TraceParser of both simulators.
+//
+// The records of a stream (see Binary_Trace.h) are cut into chunks that
+// decode on their own:
+//   header: the 8 byte magic "CTRACE01", kind and flags (uint32_t each)
+//   chunks: records, PCs and payload bytes (uint32_t each), then the payload
+//   a chunk of 0 records, ending the chunks
+//   index:  per chunk its file offset and first record (uint64_t each)
+//   trailer: index offset, chunks and records (uint64_t each), "CTINDEX1"
+// All fixed-size fields are little-endian.
+//
+// The payload starts with the chunk's dictionary of distinct PCs, each as
+// the zigzag varint delta to the previous one, followed by the records:
+//   tag: type (3 bits), taken, has skipped, has core, new size (1 bit each)
+//   PC: dictionary index (varint), except in SKIP_RECORD
+//   skipped (varint), core (1 byte): if flagged
+//   loads and stores: the zigzag varint of the address minus its guess (the
+//   last address of the PC plus its last stride, else the last address of
+//   the chunk), and the size (varint) if it is not the last one of the PC
+// A few thousand PCs repeat over billions of records and most addresses
+// are strided, so records take 2 to 4 bytes.
+
+#define chunked_trace_magic "CTRACE01"
+#define chunk_index_magic "CTINDEX1"
+
+#define default_chunk_records 65536
+#define max_chunk_records (1u << 24)
+
+// Per dictionary PC, to guess addresses and sizes
+typedef struct PC_State
+{
+    uint64_t last_addr;
+    int64_t stride;
+    uint16_t last_size;
+    bool seen;
+}PC_State;
+
+typedef struct Chunk_Index_Entry
+{
+    uint64_t offset;
+    uint64_t first_record;
+}Chunk_Index_Entry;
+
+// A chunk as stored, to be decoded away from its reader (see Trace_Decode.h)
+typedef struct Raw_Chunk
+{
+    unsigned num_records;
+    unsigned num_pcs;
+    size_t bytes;
+    unsigned char *payload; // Grown by readRawChunk(), freed by the caller
+    size_t capacity;
+}Raw_Chunk;
+
+typedef struct Chunk_Writer
+{
+    FILE *fd;
+    unsigned chunk_records;
+
+    Stream_Record *records; // Of the chunk being filled
+    unsigned num_records;
+    uint64_t total_records;
+
+    // Dictionary of the chunk, in an open-addressed table of at least
+    // 2 x chunk_records slots
+    unsigned table_bits;
+    uint64_t *table_pcs;
+    unsigned *table_index;
+    uint64_t *pcs;
+    PC_State *states;
+
+    unsigned char *buffer; // Encoded chunk
+    Chunk_Index_Entry *index;
+    uint64_t num_chunks;
+    uint64_t index_capacity;
+    bool failed;
+}Chunk_Writer;
+
+typedef struct Chunk_Reader
+{
+    FILE *fd;
+    Stream_Kind kind;
+    uint32_t flags;
+
+    // The chunk being read
+    unsigned char *buffer;
+    size_t buffer_size;
+    const unsigned char *pos;
+    const unsigned char *end;
+    unsigned records_left;
+    uint64_t *pcs;
+    PC_State *states;
+    unsigned num_pcs;
+    unsigned pcs_capacity;
+    uint64_t last_addr;
+
+    // Random access, if the index is there
+    Chunk_Index_Entry *index;
+    uint64_t num_chunks;
+    uint64_t total_records;
+    uint64_t end_offset; // Of the empty chunk ending the chunks
+    uint64_t file_size; // To bound what the headers ask for
+    bool corrupt;
+}Chunk_Reader;
+
+// chunk_records per chunk, 0 for the default
+Chunk_Writer *openChunkWriter(FILE *fd, Stream_Kind kind, uint32_t flags, unsigned chunk_records);
+bool writeChunkRecord(Chunk_Writer *writer, const Stream_Record *record);
+// Write the last chunk and the index, free the writer; false on I/O errors.
+// fd stays open.
+bool closeChunkWriter(Chunk_Writer *writer);
+
+// NULL, with fd back at its start, if fd does not hold a container
+Chunk_Reader *openChunkReader(FILE *fd);
+// False at the end of the records or on a corrupt chunk (corrupt is set)
+bool readChunkRecord(Chunk_Reader *reader, Stream_Record *record);
+// Go to record; false if past the end or the container has no index
+bool seekChunkRecord(Chunk_Reader *reader, uint64_t record);
+// Go to the start of the chunk holding record, first_record, or to the end
+// if record is the number of records; for readRawChunk() or
+// readChunkRecord(). False, with the reader untouched, where
+// seekChunkRecord() fails.
+bool seekChunk(Chunk_Reader *reader, uint64_t record, uint64_t *first_record);
+// The next chunk, undecoded; false at the end of the chunks, or if it is cut
+// short or its header does not fit the file (corrupt is set). Not to be mixed
+// with readChunkRecord().
+bool readRawChunk(Chunk_Reader *reader, Raw_Chunk *chunk);
+// Decode the records of chunk into records, room for chunk->num_records of
+// them; returns how many decoded, fewer if the chunk is corrupt
+unsigned decodeChunk(const Raw_Chunk *chunk, Stream_Record *records);
+// Frees the reader, fd stays open
+void closeChunkReader(Chunk_Reader *reader);
+
+#endif
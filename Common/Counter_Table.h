@@ -0,0 +1,152 @@
+#ifndef __COUNTER_TABLE_HH__
+#define __COUNTER_TABLE_HH__
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h> // uint64_t
+
+// Packed table of saturating counters.
+//
+// Counters live in power-of-two wide slots inside 64-bit words: 2-bit
+// counters take 2-bit slots (32 per word), 3- and 4-bit counters take 4-bit
+// slots (16 per word). A 65536-entry 2-bit table is therefore 16 KB instead
+// of the 512 KB an array of Sat_Counter needs.
+typedef struct Counter_Table
+{
+    uint64_t *words; // Packed counters
+
+    unsigned size; // Number of counters
+    unsigned counter_bits; // Width of a counter
+    uint8_t max_val;
+
+    unsigned slot_shift; // log2 of the slot width (in bits)
+    unsigned word_shift; // log2 of counters per word
+    uint64_t slot_mask;
+}Counter_Table;
+
+// Slot width (in bits) used to store a counter_bits wide counter
+static inline unsigned counterSlotBits(unsigned counter_bits)
+{
+    return counter_bits <= 1 ? 1 : counter_bits <= 2 ? 2 : counter_bits <= 4 ? 4 : 8;
+}
+
+// Number of 64-bit words backing a table
+static inline unsigned counterTableWords(unsigned size, unsigned counter_bits)
+{
+    return (unsigned)(((uint64_t)size * counterSlotBits(counter_bits) + 63) / 64);
+}
+
+// Every counter starts at init_val. The table lives in words, which holds
+// counterTableWords() words; zeroed words need no filling for init_val 0.
+static inline void initCounterTableIn(Counter_Table *table, uint64_t *words, bool zeroed,
+                                      unsigned size, unsigned counter_bits, uint8_t init_val)
+{
+    assert(counter_bits >= 1 && counter_bits <= 8);
+
+    unsigned slot_bits = counterSlotBits(counter_bits);
+
+    table->size = size;
+    table->counter_bits = counter_bits;
+    table->max_val = (1 << counter_bits) - 1;
+    table->slot_shift = __builtin_ctz(slot_bits);
+    table->word_shift = 6 - table->slot_shift;
+    table->slot_mask = (1ull << slot_bits) - 1;
+
+    assert(init_val <= table->max_val);
+
+    table->words = words;
+    if (zeroed && init_val == 0)
+    {
+        return;
+    }
+
+    // Replicate init_val into every slot of a word
+    uint64_t pattern = 0;
+    unsigned i;
+    for (i = 0; i < 64; i += slot_bits)
+    {
+        pattern |= (uint64_t)init_val << i;
+    }
+
+    unsigned num_words = counterTableWords(size, counter_bits);
+    for (i = 0; i < num_words; i++)
+    {
+        table->words[i] = pattern;
+    }
+}
+
+// Same, on its own allocation (freeCounterTable())
+static inline void initCounterTable(Counter_Table *table, unsigned size,
+                                    unsigned counter_bits, uint8_t init_val)
+{
+    uint64_t *words = (uint64_t *)malloc(counterTableWords(size, counter_bits) * sizeof(uint64_t));
+    initCounterTableIn(table, words, false, size, counter_bits, init_val);
+}
+
+static inline void freeCounterTable(Counter_Table *table)
+{
+    free(table->words);
+    table->words = NULL;
+}
+
+static inline uint8_t getCounter(const Counter_Table *table, unsigned idx)
+{
+    uint64_t word = table->words[idx >> table->word_shift];
+    unsigned shift = (idx & ((1u << table->word_shift) - 1)) << table->slot_shift;
+
+    return (word >> shift) & table->slot_mask;
+}
+
+static inline void setCounter(Counter_Table *table, unsigned idx, uint8_t val)
+{
+    uint64_t *word = &table->words[idx >> table->word_shift];
+    unsigned shift = (idx & ((1u << table->word_shift) - 1)) << table->slot_shift;
+
+    *word = (*word & ~(table->slot_mask << shift)) | ((uint64_t)val << shift);
+}
+
+// MSB determines the direction
+static inline bool getCounterPrediction(const Counter_Table *table, unsigned idx)
+{
+    return getCounter(table, idx) >> (table->counter_bits - 1);
+}
+
+// Saturating step towards up (increment) or !up (decrement), without branches.
+static inline void updateCounter(Counter_Table *table, unsigned idx, bool up)
+{
+    uint64_t *word = &table->words[idx >> table->word_shift];
+    unsigned shift = (idx & ((1u << table->word_shift) - 1)) << table->slot_shift;
+
+    unsigned counter = (*word >> shift) & table->slot_mask;
+    unsigned inc = up & (counter != table->max_val);
+    unsigned dec = !up & (counter != 0);
+    unsigned next = counter + inc - dec;
+
+    *word ^= (uint64_t)(counter ^ next) << shift;
+}
+
+// Same as updateCounter, but leaves the counter alone when enable is false.
+static inline void updateCounterIf(Counter_Table *table, unsigned idx, bool up, bool enable)
+{
+    uint64_t *word = &table->words[idx >> table->word_shift];
+    unsigned shift = (idx & ((1u << table->word_shift) - 1)) << table->slot_shift;
+
+    unsigned counter = (*word >> shift) & table->slot_mask;
+    unsigned inc = enable & up & (counter != table->max_val);
+    unsigned dec = enable & !up & (counter != 0);
+    unsigned next = counter + inc - dec;
+
+    *word ^= (uint64_t)(counter ^ next) << shift;
+}
+
+// Hint that the word holding counter idx is about to be updated
+static inline void prefetchCounter(const Counter_Table *table, unsigned idx)
+{
+    __builtin_prefetch(&table->words[idx >> table->word_shift], 1, 3);
+}
+
+#endif
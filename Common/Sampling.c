@@ -0,0 +1,505 @@
+#include "Sampling.h"
+
+#include <float.h>
+#include <math.h>
+
+#define kmeans_iterations 100
+
+void initSamplingConfig(Sampling_Config *config)
+{
+    config->mode = SAMPLE_NONE;
+    config->interval = 1000000;
+    config->period = 10;
+    config->warm = 0;
+    config->clusters = 10;
+    config->per_cluster = 3;
+}
+
+// Consume the sampling option at argv[*arg] (and its value). Returns false
+// if argv[*arg] is not a sampling option.
+bool parseSamplingOption(Sampling_Config *config, int argc, const char *argv[], int *arg)
+{
+    const char *opt = argv[*arg];
+    if (*arg + 1 >= argc)
+    {
+        return false;
+    }
+    const char *val = argv[*arg + 1];
+
+    if (strcmp(opt, "--sample") == 0)
+    {
+        if (strcmp(val, "periodic") == 0)
+        {
+            config->mode = SAMPLE_PERIODIC;
+        }
+        else if (strcmp(val, "simpoint") == 0)
+        {
+            config->mode = SAMPLE_SIMPOINT;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    else if (strcmp(opt, "--interval") == 0)
+    {
+        config->interval = strtoull(val, NULL, 10);
+    }
+    else if (strcmp(opt, "--period") == 0)
+    {
+        config->period = strtoull(val, NULL, 10);
+    }
+    else if (strcmp(opt, "--warm") == 0)
+    {
+        config->warm = strtoull(val, NULL, 10);
+    }
+    else if (strcmp(opt, "--clusters") == 0)
+    {
+        config->clusters = atoi(val);
+    }
+    else if (strcmp(opt, "--per-cluster") == 0)
+    {
+        config->per_cluster = atoi(val);
+    }
+    else
+    {
+        return false;
+    }
+
+    if (config->interval == 0 || config->period == 0 ||
+        config->clusters == 0 || config->per_cluster == 0)
+    {
+        return false;
+    }
+
+    ++*arg;
+    return true;
+}
+
+void printSamplingUsage()
+{
+    printf("  --sample periodic|simpoint  measure only sampled intervals\n");
+    printf("  --interval N       records per interval (default 1000000)\n");
+    printf("  --period P         periodic: measure one interval in every P (default 10)\n");
+    printf("  --warm W           warm only the W records before each measured interval\n");
+    printf("                     and skip the rest (default: warm everything)\n");
+    printf("  --clusters K       simpoint: number of phase clusters (default 10)\n");
+    printf("  --per-cluster M    simpoint: intervals measured per cluster (default 3)\n");
+}
+
+Sampler *initSampler(const Sampling_Config *config, unsigned num_metrics)
+{
+    assert(num_metrics <= max_sample_metrics);
+
+    Sampler *sampler = (Sampler *)calloc(1, sizeof(Sampler));
+
+    sampler->config = *config;
+    sampler->num_metrics = num_metrics;
+
+    return sampler;
+}
+
+void freeSampler(Sampler *sampler)
+{
+    free(sampler->cluster);
+    free(sampler->measured);
+    free(sampler->next_measured);
+    free(sampler->weight);
+    free(sampler->bbv);
+    free(sampler->sample_cluster);
+    free(sampler->samples);
+    free(sampler);
+}
+
+// SimPoint profiling
+void profileRecord(Sampler *sampler, uint64_t PC)
+{
+    uint64_t interval = sampler->profiled_records / sampler->config.interval;
+
+    if (interval >= sampler->bbv_capacity)
+    {
+        uint64_t capacity = sampler->bbv_capacity ? sampler->bbv_capacity * 2 : 1024;
+        sampler->bbv = (float *)realloc(sampler->bbv, capacity * bbv_dims * sizeof(float));
+        memset(sampler->bbv + sampler->bbv_capacity * bbv_dims, 0,
+               (capacity - sampler->bbv_capacity) * bbv_dims * sizeof(float));
+        sampler->bbv_capacity = capacity;
+    }
+
+    // Hashing the PC is a random projection of the (huge, sparse) basic-block
+    // vector down to bbv_dims dimensions.
+    unsigned dim = (PC * 0x9E3779B97F4A7C15ull) >> 59;
+    sampler->bbv[interval * bbv_dims + dim] += 1;
+
+    ++sampler->profiled_records;
+}
+
+static double distance(const float *a, const float *b)
+{
+    double dist = 0;
+    unsigned d;
+    for (d = 0; d < bbv_dims; d++)
+    {
+        double diff = a[d] - b[d];
+        dist += diff * diff;
+    }
+    return dist;
+}
+
+static uint64_t nextRandom(uint64_t *state)
+{
+    // splitmix64, so the clustering is reproducible
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// Cluster the profiled intervals and pick the ones to measure
+void finishProfile(Sampler *sampler)
+{
+    uint64_t num_intervals = (sampler->profiled_records + sampler->config.interval - 1) /
+                             sampler->config.interval;
+    sampler->num_intervals = num_intervals;
+
+    sampler->cluster = (int *)calloc(num_intervals, sizeof(int));
+    sampler->measured = (bool *)calloc(num_intervals, sizeof(bool));
+    sampler->next_measured = (uint64_t *)malloc(num_intervals * sizeof(uint64_t));
+
+    unsigned k = sampler->config.clusters < num_intervals ? sampler->config.clusters : num_intervals;
+    sampler->weight = (double *)calloc(k ? k : 1, sizeof(double));
+
+    if (num_intervals == 0)
+    {
+        return;
+    }
+
+    // Normalize every vector, so intervals compare by code mix, not length
+    uint64_t i;
+    unsigned d, c;
+    for (i = 0; i < num_intervals; i++)
+    {
+        float *v = &sampler->bbv[i * bbv_dims];
+        double sum = 0;
+        for (d = 0; d < bbv_dims; d++)
+        {
+            sum += v[d];
+        }
+        for (d = 0; d < bbv_dims && sum > 0; d++)
+        {
+            v[d] /= sum;
+        }
+    }
+
+    // k-means++ seeding
+    float *centroids = (float *)malloc(k * bbv_dims * sizeof(float));
+    double *min_dist = (double *)malloc(num_intervals * sizeof(double));
+    uint64_t rng = 1;
+
+    memcpy(centroids, &sampler->bbv[(nextRandom(&rng) % num_intervals) * bbv_dims],
+           bbv_dims * sizeof(float));
+    for (i = 0; i < num_intervals; i++)
+    {
+        min_dist[i] = distance(&sampler->bbv[i * bbv_dims], centroids);
+    }
+
+    for (c = 1; c < k; c++)
+    {
+        double total = 0;
+        for (i = 0; i < num_intervals; i++)
+        {
+            total += min_dist[i];
+        }
+
+        uint64_t pick = nextRandom(&rng) % num_intervals;
+        double target = (double)(nextRandom(&rng) >> 11) / (double)(1ull << 53) * total;
+        for (i = 0; total > 0 && i < num_intervals; i++)
+        {
+            target -= min_dist[i];
+            if (target <= 0)
+            {
+                pick = i;
+                break;
+            }
+        }
+
+        memcpy(&centroids[c * bbv_dims], &sampler->bbv[pick * bbv_dims], bbv_dims * sizeof(float));
+        for (i = 0; i < num_intervals; i++)
+        {
+            double dist = distance(&sampler->bbv[i * bbv_dims], &centroids[c * bbv_dims]);
+            if (dist < min_dist[i])
+            {
+                min_dist[i] = dist;
+            }
+        }
+    }
+
+    // Lloyd iterations
+    double *sums = (double *)malloc(k * bbv_dims * sizeof(double));
+    uint64_t *counts = (uint64_t *)malloc(k * sizeof(uint64_t));
+    int iter;
+    for (iter = 0; iter < kmeans_iterations; iter++)
+    {
+        bool changed = iter == 0;
+        for (i = 0; i < num_intervals; i++)
+        {
+            int best = 0;
+            double best_dist = DBL_MAX;
+            for (c = 0; c < k; c++)
+            {
+                double dist = distance(&sampler->bbv[i * bbv_dims], &centroids[c * bbv_dims]);
+                if (dist < best_dist)
+                {
+                    best_dist = dist;
+                    best = c;
+                }
+            }
+            changed |= sampler->cluster[i] != best;
+            sampler->cluster[i] = best;
+            min_dist[i] = best_dist;
+        }
+
+        if (!changed)
+        {
+            break;
+        }
+
+        memset(sums, 0, k * bbv_dims * sizeof(double));
+        memset(counts, 0, k * sizeof(uint64_t));
+        for (i = 0; i < num_intervals; i++)
+        {
+            c = sampler->cluster[i];
+            ++counts[c];
+            for (d = 0; d < bbv_dims; d++)
+            {
+                sums[c * bbv_dims + d] += sampler->bbv[i * bbv_dims + d];
+            }
+        }
+
+        // An empty cluster keeps its old centroid
+        for (c = 0; c < k; c++)
+        {
+            for (d = 0; counts[c] > 0 && d < bbv_dims; d++)
+            {
+                centroids[c * bbv_dims + d] = sums[c * bbv_dims + d] / counts[c];
+            }
+        }
+    }
+
+    // Measure the per_cluster intervals closest to each centroid
+    for (c = 0; c < k; c++)
+    {
+        uint64_t members = 0;
+        unsigned picked;
+        for (i = 0; i < num_intervals; i++)
+        {
+            members += sampler->cluster[i] == (int)c;
+        }
+        sampler->weight[c] = (double)members / (double)num_intervals;
+
+        for (picked = 0; picked < sampler->config.per_cluster; picked++)
+        {
+            uint64_t best = num_intervals;
+            for (i = 0; i < num_intervals; i++)
+            {
+                if (sampler->cluster[i] == (int)c && !sampler->measured[i] &&
+                    (best == num_intervals || min_dist[i] < min_dist[best]))
+                {
+                    best = i;
+                }
+            }
+
+            if (best == num_intervals)
+            {
+                break;
+            }
+            sampler->measured[best] = true;
+        }
+    }
+
+    uint64_t next = UINT64_MAX;
+    for (i = num_intervals; i-- > 0;)
+    {
+        if (sampler->measured[i])
+        {
+            next = i;
+        }
+        sampler->next_measured[i] = next;
+    }
+
+    free(centroids);
+    free(min_dist);
+    free(sums);
+    free(counts);
+    free(sampler->bbv);
+    sampler->bbv = NULL;
+    sampler->bbv_capacity = 0;
+}
+
+static bool isMeasured(Sampler *sampler, uint64_t interval)
+{
+    if (sampler->config.mode == SAMPLE_PERIODIC)
+    {
+        return interval % sampler->config.period == sampler->config.period - 1;
+    }
+
+    return interval < sampler->num_intervals && sampler->measured[interval];
+}
+
+static uint64_t nextMeasured(Sampler *sampler, uint64_t interval)
+{
+    if (sampler->config.mode == SAMPLE_PERIODIC)
+    {
+        uint64_t period = sampler->config.period;
+        return interval + (period - 1 - interval % period);
+    }
+
+    return interval < sampler->num_intervals ? sampler->next_measured[interval] : UINT64_MAX;
+}
+
+// What to do with the given record (counted from the start of the sampled
+// part of the trace)
+Sample_Action sampleAction(Sampler *sampler, uint64_t record, uint64_t *until)
+{
+    if (sampler->config.mode == SAMPLE_NONE)
+    {
+        *until = UINT64_MAX;
+        return SAMPLE_MEASURE;
+    }
+
+    uint64_t interval_len = sampler->config.interval;
+    uint64_t interval = record / interval_len;
+    if (isMeasured(sampler, interval))
+    {
+        *until = (interval + 1) * interval_len;
+        return SAMPLE_MEASURE;
+    }
+
+    uint64_t next = nextMeasured(sampler, interval + 1);
+    uint64_t next_start = next != UINT64_MAX ? next * interval_len : UINT64_MAX;
+    *until = next_start;
+
+    if (sampler->config.warm == 0)
+    {
+        return SAMPLE_WARM;
+    }
+
+    if (next_start == UINT64_MAX)
+    {
+        return SAMPLE_SKIP;
+    }
+
+    if (next_start - record <= sampler->config.warm)
+    {
+        return SAMPLE_WARM;
+    }
+
+    *until = next_start - sampler->config.warm;
+    return SAMPLE_SKIP;
+}
+
+void addSample(Sampler *sampler, uint64_t interval, const double *metrics)
+{
+    if (sampler->num_samples == sampler->samples_capacity)
+    {
+        sampler->samples_capacity = sampler->samples_capacity ? sampler->samples_capacity * 2 : 64;
+        sampler->samples = (double *)realloc(sampler->samples,
+            sampler->samples_capacity * sampler->num_metrics * sizeof(double));
+        sampler->sample_cluster = (int *)realloc(sampler->sample_cluster,
+            sampler->samples_capacity * sizeof(int));
+    }
+
+    int cluster = 0;
+    if (sampler->config.mode == SAMPLE_SIMPOINT && interval < sampler->num_intervals)
+    {
+        cluster = sampler->cluster[interval];
+    }
+
+    sampler->sample_cluster[sampler->num_samples] = cluster;
+    memcpy(&sampler->samples[sampler->num_samples * sampler->num_metrics], metrics,
+           sampler->num_metrics * sizeof(double));
+    ++sampler->num_samples;
+}
+
+// Stratified estimate of a metric and the half width of its 95% confidence
+// interval. Periodic sampling is a single stratum. Strata with a single
+// sample borrow the pooled within-stratum variance.
+void getEstimate(Sampler *sampler, unsigned metric, double *mean, double *half_width)
+{
+    unsigned num_strata = sampler->config.mode == SAMPLE_SIMPOINT ? sampler->config.clusters : 1;
+
+    double *sum = (double *)calloc(num_strata, sizeof(double));
+    double *sum_sq = (double *)calloc(num_strata, sizeof(double));
+    uint64_t *count = (uint64_t *)calloc(num_strata, sizeof(uint64_t));
+
+    uint64_t i;
+    unsigned h;
+    double all_sum = 0, all_sum_sq = 0;
+    for (i = 0; i < sampler->num_samples; i++)
+    {
+        double value = sampler->samples[i * sampler->num_metrics + metric];
+        h = sampler->sample_cluster[i];
+        sum[h] += value;
+        sum_sq[h] += value * value;
+        ++count[h];
+
+        all_sum += value;
+        all_sum_sq += value * value;
+    }
+
+    // Pooled within-stratum variance
+    double pooled_ss = 0;
+    uint64_t pooled_df = 0;
+    double total_weight = 0;
+    for (h = 0; h < num_strata; h++)
+    {
+        if (count[h] >= 2)
+        {
+            pooled_ss += sum_sq[h] - sum[h] * sum[h] / count[h];
+            pooled_df += count[h] - 1;
+        }
+        if (count[h] > 0)
+        {
+            total_weight += num_strata > 1 ? sampler->weight[h] : 1;
+        }
+    }
+
+    double pooled_var;
+    if (pooled_df > 0)
+    {
+        pooled_var = pooled_ss / pooled_df;
+    }
+    else if (sampler->num_samples >= 2)
+    {
+        // Nothing to pool from; the spread across strata over-estimates it
+        pooled_var = (all_sum_sq - all_sum * all_sum / sampler->num_samples) /
+                     (sampler->num_samples - 1);
+    }
+    else
+    {
+        pooled_var = 0;
+    }
+
+    *mean = 0;
+    double variance = 0;
+    for (h = 0; h < num_strata && total_weight > 0; h++)
+    {
+        if (count[h] == 0)
+        {
+            continue;
+        }
+
+        double w = (num_strata > 1 ? sampler->weight[h] : 1) / total_weight;
+        double stratum_mean = sum[h] / count[h];
+        double stratum_var = count[h] >= 2 ?
+            (sum_sq[h] - sum[h] * stratum_mean) / (count[h] - 1) : pooled_var;
+
+        *mean += w * stratum_mean;
+        variance += w * w * stratum_var / count[h];
+    }
+
+    *half_width = 1.96 * sqrt(variance > 0 ? variance : 0);
+
+    free(sum);
+    free(sum_sq);
+    free(count);
+}
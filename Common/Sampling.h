@@ -0,0 +1,87 @@
+#ifndef __SAMPLING_HH__
+#define __SAMPLING_HH__
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h> // uint64_t
+
+// Sampled simulation.
+//
+// The trace is cut into fixed-size intervals of records. Only selected
+// intervals are measured; the others are either functionally warmed (the
+// simulator state is updated, no statistics are kept) or skipped outright.
+// Intervals are selected either periodically (one out of every period) or
+// SimPoint-style, by clustering per-interval basic-block vectors built from
+// the PCs and measuring the intervals closest to each cluster centroid.
+// Estimates are stratified by cluster and come with a 95% confidence interval.
+
+typedef enum Sampling_Mode{SAMPLE_NONE, SAMPLE_PERIODIC, SAMPLE_SIMPOINT}Sampling_Mode;
+
+typedef enum Sample_Action{SAMPLE_SKIP, SAMPLE_WARM, SAMPLE_MEASURE}Sample_Action;
+
+#define bbv_dims 32 // Dimensions of the (randomly projected) basic-block vectors
+#define max_sample_metrics 4
+
+typedef struct Sampling_Config
+{
+    Sampling_Mode mode;
+
+    uint64_t interval; // Records per interval
+    uint64_t period; // Periodic: measure one interval out of every period
+    uint64_t warm; // Records warmed before a measured interval, 0 warms everything
+
+    unsigned clusters; // SimPoint: number of clusters
+    unsigned per_cluster; // SimPoint: intervals measured per cluster
+}Sampling_Config;
+
+typedef struct Sampler
+{
+    Sampling_Config config;
+
+    // SimPoint plan, one entry per interval
+    uint64_t num_intervals;
+    int *cluster; // Cluster of each interval
+    bool *measured; // Is this interval measured?
+    uint64_t *next_measured; // First measured interval at or after this one
+    double *weight; // Fraction of all intervals in each cluster
+
+    // Basic-block vector profiling
+    float *bbv;
+    uint64_t bbv_capacity; // In intervals
+    uint64_t profiled_records;
+
+    // Per measured interval results
+    unsigned num_metrics;
+    uint64_t num_samples;
+    uint64_t samples_capacity;
+    int *sample_cluster;
+    double *samples; // num_samples x num_metrics
+}Sampler;
+
+// Configuration
+void initSamplingConfig(Sampling_Config *config);
+bool parseSamplingOption(Sampling_Config *config, int argc, const char *argv[], int *arg);
+void printSamplingUsage();
+
+// Sampler life cycle
+Sampler *initSampler(const Sampling_Config *config, unsigned num_metrics);
+void freeSampler(Sampler *sampler);
+
+// SimPoint profiling pass: feed the PC of every record, then finish
+void profileRecord(Sampler *sampler, uint64_t PC);
+void finishProfile(Sampler *sampler);
+
+// Simulation pass. sampleAction() also returns, in until, the first record
+// at which the action may change (the end of a measured interval included).
+Sample_Action sampleAction(Sampler *sampler, uint64_t record, uint64_t *until);
+void addSample(Sampler *sampler, uint64_t interval, const double *metrics);
+
+// Results
+void getEstimate(Sampler *sampler, unsigned metric, double *mean, double *half_width);
+
+#endif
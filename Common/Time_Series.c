@@ -0,0 +1,228 @@
+#include "Time_Series.h"
+
+void initSeriesConfig(Series_Config *config)
+{
+    config->file = NULL;
+    config->interval = 100000;
+}
+
+// Consume the time series option at argv[*arg] (and its value). Returns
+// false if argv[*arg] is not a time series option.
+bool parseSeriesOption(Series_Config *config, int argc, const char *argv[], int *arg)
+{
+    const char *opt = argv[*arg];
+    if (*arg + 1 >= argc)
+    {
+        return false;
+    }
+    const char *val = argv[*arg + 1];
+
+    if (strcmp(opt, "--series") == 0)
+    {
+        config->file = val;
+    }
+    else if (strcmp(opt, "--series-interval") == 0)
+    {
+        config->interval = strtoull(val, NULL, 10);
+        if (config->interval == 0)
+        {
+            return false;
+        }
+    }
+    else
+    {
+        return false;
+    }
+
+    ++*arg;
+    return true;
+}
+
+void printSeriesUsage()
+{
+    printf("  --series <file>    write per-interval statistics to <file>, as CSV if\n");
+    printf("                     it ends in .csv, else in a compact binary format\n");
+    printf("  --series-interval N  records per time series row (default 100000)\n");
+}
+
+static bool writeHeader(Time_Series *series)
+{
+    unsigned c;
+    if (series->csv)
+    {
+        for (c = 0; c < series->num_columns; c++)
+        {
+            fprintf(series->fd, "%s%s", c ? "," : "", series->columns[c]);
+        }
+        return fprintf(series->fd, "\n") > 0;
+    }
+
+    uint32_t num_columns = series->num_columns;
+    bool ok = fwrite("TSERIES1", 8, 1, series->fd) == 1 &&
+              fwrite(&num_columns, sizeof(num_columns), 1, series->fd) == 1;
+    for (c = 0; ok && c < series->num_columns; c++)
+    {
+        ok = fwrite(series->columns[c], strlen(series->columns[c]) + 1, 1, series->fd) == 1;
+    }
+    return ok;
+}
+
+static bool writeRows(Time_Series *series, const double *rows, unsigned num_rows)
+{
+    if (!series->csv)
+    {
+        return fwrite(rows, sizeof(double) * series->num_columns, num_rows, series->fd) == num_rows;
+    }
+
+    unsigned r, c;
+    for (r = 0; r < num_rows; r++)
+    {
+        const double *row = &rows[r * series->num_columns];
+        // The first column is a record number
+        fprintf(series->fd, "%"PRIu64, (uint64_t)row[0]);
+        for (c = 1; c < series->num_columns; c++)
+        {
+            fprintf(series->fd, ",%.10g", row[c]);
+        }
+        if (fprintf(series->fd, "\n") < 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Background writer: write full buffers in order until closing
+static void *seriesWriter(void *arg)
+{
+    Time_Series *series = (Time_Series *)arg;
+
+    pthread_mutex_lock(&series->lock);
+    for (;;)
+    {
+        while (series->pending == 0 && !series->closing)
+        {
+            pthread_cond_wait(&series->filled, &series->lock);
+        }
+        if (series->pending == 0)
+        {
+            break;
+        }
+
+        // The buffer at tail is ours until pending drops
+        unsigned tail = series->tail;
+        pthread_mutex_unlock(&series->lock);
+
+        bool ok = writeRows(series, series->buffers[tail], series->rows[tail]);
+
+        pthread_mutex_lock(&series->lock);
+        series->failed |= !ok;
+        series->rows[tail] = 0;
+        series->tail = (tail + 1) % series_buffers;
+        --series->pending;
+        pthread_cond_signal(&series->drained);
+    }
+    pthread_mutex_unlock(&series->lock);
+
+    return NULL;
+}
+
+Time_Series *openTimeSeries(const Series_Config *config, unsigned num_columns,
+                            const char **columns)
+{
+    if (config->file == NULL)
+    {
+        return NULL;
+    }
+
+    FILE *fd = fopen(config->file, "wb");
+    if (fd == NULL)
+    {
+        perror(config->file);
+        return NULL;
+    }
+
+    Time_Series *series = (Time_Series *)calloc(1, sizeof(Time_Series));
+    series->fd = fd;
+    size_t len = strlen(config->file);
+    series->csv = len >= 4 && strcmp(config->file + len - 4, ".csv") == 0;
+    series->num_columns = num_columns;
+    series->columns = columns;
+
+    unsigned b;
+    for (b = 0; b < series_buffers; b++)
+    {
+        series->buffers[b] = (double *)malloc(series_buffer_rows * num_columns * sizeof(double));
+    }
+
+    series->failed = !writeHeader(series);
+
+    pthread_mutex_init(&series->lock, NULL);
+    pthread_cond_init(&series->filled, NULL);
+    pthread_cond_init(&series->drained, NULL);
+    pthread_create(&series->writer, NULL, seriesWriter, series);
+
+    return series;
+}
+
+// Hand the buffer being filled to the writer and move on to the next one
+static void submitBuffer(Time_Series *series)
+{
+    pthread_mutex_lock(&series->lock);
+    ++series->pending;
+    pthread_cond_signal(&series->filled);
+
+    // Wait for the writer if it has not drained the next buffer yet
+    while (series->pending == series_buffers)
+    {
+        pthread_cond_wait(&series->drained, &series->lock);
+    }
+    series->head = (series->head + 1) % series_buffers;
+    pthread_mutex_unlock(&series->lock);
+}
+
+void addSeriesRow(Time_Series *series, const double *values)
+{
+    unsigned head = series->head;
+    memcpy(&series->buffers[head][series->rows[head] * series->num_columns], values,
+           series->num_columns * sizeof(double));
+
+    if (++series->rows[head] == series_buffer_rows)
+    {
+        submitBuffer(series);
+    }
+}
+
+bool closeTimeSeries(Time_Series *series)
+{
+    if (series == NULL)
+    {
+        return true;
+    }
+
+    if (series->rows[series->head] > 0)
+    {
+        submitBuffer(series);
+    }
+
+    pthread_mutex_lock(&series->lock);
+    series->closing = true;
+    pthread_cond_signal(&series->filled);
+    pthread_mutex_unlock(&series->lock);
+    pthread_join(series->writer, NULL);
+
+    bool ok = !series->failed;
+    ok &= fclose(series->fd) == 0;
+
+    unsigned b;
+    for (b = 0; b < series_buffers; b++)
+    {
+        free(series->buffers[b]);
+    }
+    pthread_mutex_destroy(&series->lock);
+    pthread_cond_destroy(&series->filled);
+    pthread_cond_destroy(&series->drained);
+    free(series);
+
+    return ok;
+}
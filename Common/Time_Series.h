@@ -0,0 +1,71 @@
+#ifndef __TIME_SERIES_HH__
+#define __TIME_SERIES_HH__
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h> // uint64_t
+
+// Per-interval statistics streamed to a file.
+//
+// Every row holds num_columns doubles, the first one being the record at
+// which the interval ends. Rows are buffered and a background thread writes
+// full buffers, so the simulation only blocks if the writer falls
+// series_buffers buffers behind.
+//
+// A file ending in ".csv" gets a header line and one line per row. Any other
+// file gets the binary format: the 8 byte magic "TSERIES1", the number of
+// columns (uint32_t), the NUL-terminated column names, then the rows as raw
+// native-endian doubles.
+
+#define series_buffers 4
+#define series_buffer_rows 1024
+
+typedef struct Series_Config
+{
+    const char *file; // NULL: no time series
+    uint64_t interval; // Records per row
+}Series_Config;
+
+typedef struct Time_Series
+{
+    FILE *fd;
+    bool csv;
+
+    unsigned num_columns;
+    const char **columns;
+
+    // Ring of buffers; the simulation fills buffers[head], the writer
+    // drains buffers[tail]
+    double *buffers[series_buffers];
+    unsigned rows[series_buffers];
+    unsigned head;
+    unsigned tail;
+    unsigned pending; // Full buffers not written yet
+    bool closing;
+    bool failed;
+
+    pthread_t writer;
+    pthread_mutex_t lock;
+    pthread_cond_t filled; // A buffer is ready to be written, or closing
+    pthread_cond_t drained; // A buffer has been written
+}Time_Series;
+
+// Configuration
+void initSeriesConfig(Series_Config *config);
+bool parseSeriesOption(Series_Config *config, int argc, const char *argv[], int *arg);
+void printSeriesUsage();
+
+// Returns NULL if no time series is asked for or the file cannot be opened
+Time_Series *openTimeSeries(const Series_Config *config, unsigned num_columns,
+                            const char **columns);
+void addSeriesRow(Time_Series *series, const double *values);
+// Write the remaining rows and wait for the writer, returns false on I/O errors
+bool closeTimeSeries(Time_Series *series);
+
+#endif
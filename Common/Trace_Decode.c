@@ -0,0 +1,474 @@
+#include "Trace_Decode.h"
+
+#define max_text_fields 8
+
+static bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// Split line into at most max_text_fields fields, in place
+static int splitFields(char *line, char *fields[])
+{
+    int num_fields = 0;
+    char *pos = line;
+    while (num_fields < max_text_fields)
+    {
+        while (isSpace(*pos))
+        {
+            ++pos;
+        }
+        if (*pos == '\0')
+        {
+            break;
+        }
+        fields[num_fields++] = pos;
+        while (*pos != '\0' && !isSpace(*pos))
+        {
+            ++pos;
+        }
+        if (*pos != '\0')
+        {
+            *pos++ = '\0';
+        }
+    }
+    return num_fields;
+}
+
+// The decimal number at the start of field
+static uint64_t parseDecimal(const char *field)
+{
+    uint64_t val = 0;
+    while (*field >= '0' && *field <= '9')
+    {
+        val = 10 * val + (*field++ - '0');
+    }
+    return val;
+}
+
+static bool isRecordType(const char *field, const char *types)
+{
+    return field[0] != '\0' && field[1] == '\0' && strchr(types, field[0]) != NULL;
+}
+
+// Whether the first count fields are decimal numbers
+static bool areDecimals(char *fields[], int count)
+{
+    int i;
+    for (i = 0; i < count; i++)
+    {
+        const char *c = fields[i];
+        while (*c >= '0' && *c <= '9')
+        {
+            ++c;
+        }
+        if (c == fields[i] || *c != '\0')
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool parseTextRecord(char *line, Stream_Kind kind, Stream_Record *record)
+{
+    char *fields[max_text_fields];
+    int num_fields = splitFields(line, fields);
+    memset(record, 0, sizeof(Stream_Record));
+
+    if (kind == MEMORY_STREAM)
+    {
+        if (num_fields < 4 || !areDecimals(fields, 3) || !isRecordType(fields[3], "LS"))
+        {
+            return false;
+        }
+        record->core = parseDecimal(fields[0]);
+        record->PC = parseDecimal(fields[1]);
+        record->addr = parseDecimal(fields[2]);
+        record->type = fields[3][0] == 'S' ? STORE_RECORD : LOAD_RECORD;
+        return true;
+    }
+
+    if (num_fields < 2 || !isRecordType(fields[1], "EBLS") || !areDecimals(fields, 1))
+    {
+        return false;
+    }
+    record->PC = parseDecimal(fields[0]);
+    switch (fields[1][0])
+    {
+        case 'E':
+            record->type = EXE_RECORD;
+            break;
+        case 'B':
+            if (num_fields < 3 || !areDecimals(&fields[2], 1))
+            {
+                return false;
+            }
+            record->type = BRANCH_RECORD;
+            record->taken = parseDecimal(fields[2]) != 0;
+            break;
+        default:
+            if (num_fields < 4 || !areDecimals(&fields[2], 2))
+            {
+                return false;
+            }
+            record->type = fields[1][0] == 'S' ? STORE_RECORD : LOAD_RECORD;
+            record->addr = parseDecimal(fields[2]);
+            record->size = parseDecimal(fields[3]);
+            break;
+    }
+    return true;
+}
+
+bool isBlankLine(const char *line)
+{
+    while (isSpace(*line))
+    {
+        ++line;
+    }
+    return *line == '\0';
+}
+
+static void reserveBytes(Raw_Chunk *raw, size_t bytes)
+{
+    if (bytes > raw->capacity)
+    {
+        raw->capacity = bytes;
+        raw->payload = (unsigned char *)realloc(raw->payload, bytes);
+    }
+}
+
+static void reserveRecords(Decode_Block *block, size_t records)
+{
+    if (records > block->records_capacity)
+    {
+        block->records_capacity = records;
+        block->records = (Stream_Record *)realloc(block->records, records * sizeof(Stream_Record));
+        block->line_ends = (uint32_t *)realloc(block->line_ends, records * sizeof(uint32_t));
+    }
+}
+
+// Whole lines, from the carry of the last block on; the text after the
+// last line is carried to the next block
+static bool readTextBlock(Decode_Pipeline *pipeline, Decode_Block *block)
+{
+    Raw_Chunk *raw = &block->raw;
+    reserveBytes(raw, pipeline->carry_bytes + text_block_bytes + 1);
+    if (pipeline->carry_bytes > 0)
+    {
+        memcpy(raw->payload, pipeline->carry, pipeline->carry_bytes);
+    }
+    size_t bytes = pipeline->carry_bytes;
+    pipeline->carry_bytes = 0;
+
+    for (;;)
+    {
+        size_t want = raw->capacity - 1 - bytes;
+        size_t got = fread_unlocked(raw->payload + bytes, 1, want, pipeline->fd);
+        bytes += got;
+        if (got < want)
+        {
+            break; // The end of the trace, its last line may lack a newline
+        }
+
+        size_t last = bytes;
+        while (last > 0 && raw->payload[last - 1] != '\n')
+        {
+            --last;
+        }
+        if (last > 0)
+        {
+            pipeline->carry_bytes = bytes - last;
+            if (pipeline->carry_bytes > pipeline->carry_capacity)
+            {
+                pipeline->carry_capacity = pipeline->carry_bytes;
+                pipeline->carry = (char *)realloc(pipeline->carry, pipeline->carry_capacity);
+            }
+            memcpy(pipeline->carry, raw->payload + last, pipeline->carry_bytes);
+            bytes = last;
+            break;
+        }
+        reserveBytes(raw, 2 * raw->capacity); // A line longer than the block
+    }
+
+    raw->payload[bytes] = '\0';
+    raw->bytes = bytes;
+    block->offset = pipeline->text_offset;
+    pipeline->text_offset += bytes;
+    return bytes > 0;
+}
+
+// The next block of the trace; false at its end. Under read_lock.
+static bool readBlock(Decode_Pipeline *pipeline, Decode_Block *block)
+{
+    Raw_Chunk *raw = &block->raw;
+    if (pipeline->chunked != NULL)
+    {
+        return readRawChunk(pipeline->chunked, raw);
+    }
+    if (pipeline->text)
+    {
+        return readTextBlock(pipeline, block);
+    }
+
+    unsigned record_size = flatRecordSize(pipeline->kind);
+    reserveBytes(raw, flat_block_records * record_size);
+    size_t got = fread_unlocked(raw->payload, 1, flat_block_records * record_size, pipeline->fd);
+    raw->bytes = got - got % record_size; // A record cut short ends the stream
+    return raw->bytes > 0;
+}
+
+// Decode a block read, away from any lock
+static void decodeBlock(Decode_Pipeline *pipeline, Decode_Block *block)
+{
+    Raw_Chunk *raw = &block->raw;
+    block->num_records = 0;
+    block->corrupt = false;
+    block->rejected_lines = 0;
+
+    if (pipeline->chunked != NULL)
+    {
+        reserveRecords(block, raw->num_records);
+        block->num_records = decodeChunk(raw, block->records);
+        block->corrupt = block->num_records < raw->num_records;
+    }
+    else if (pipeline->text)
+    {
+        char *line = (char *)raw->payload;
+        char *end = line + raw->bytes;
+        reserveRecords(block, raw->bytes / 8 + 1);
+        while (line < end)
+        {
+            char *eol = (char *)memchr(line, '\n', end - line);
+            eol = eol != NULL ? eol : end;
+            *eol = '\0';
+            if (block->num_records == block->records_capacity)
+            {
+                reserveRecords(block, 2 * block->records_capacity);
+            }
+            if (parseTextRecord(line, pipeline->kind, &block->records[block->num_records]))
+            {
+                block->line_ends[block->num_records++] = (eol < end ? eol + 1 : end) -
+                                                         (char *)raw->payload;
+            }
+            else if (!isBlankLine(line))
+            {
+                ++block->rejected_lines;
+            }
+            line = eol + 1;
+        }
+    }
+    else
+    {
+        unsigned record_size = flatRecordSize(pipeline->kind);
+        size_t num_records = raw->bytes / record_size;
+        reserveRecords(block, num_records);
+        size_t r;
+        for (r = 0; r < num_records; r++)
+        {
+            decodeFlatRecord(&raw->payload[r * record_size], pipeline->kind, &block->records[r]);
+        }
+        block->num_records = num_records;
+    }
+}
+
+static void *decodeThread(void *arg)
+{
+    Decode_Pipeline *pipeline = (Decode_Pipeline *)arg;
+
+    for (;;)
+    {
+        // Read the next block in file order, once its slot is free
+        pthread_mutex_lock(&pipeline->read_lock);
+        uint64_t block_id = pipeline->next_read;
+        Decode_Block *block = &pipeline->blocks[block_id % pipeline->num_blocks];
+
+        pthread_mutex_lock(&pipeline->lock);
+        while (block->state != BLOCK_FREE && !pipeline->stop)
+        {
+            pthread_cond_wait(&pipeline->freed, &pipeline->lock);
+        }
+        bool reading = !pipeline->stop && !pipeline->end;
+        pthread_mutex_unlock(&pipeline->lock);
+
+        if (!reading || !readBlock(pipeline, block))
+        {
+            pthread_mutex_lock(&pipeline->lock);
+            if (!pipeline->end)
+            {
+                pipeline->end = true;
+                pipeline->end_block = block_id;
+                pipeline->read_corrupt = pipeline->chunked != NULL && pipeline->chunked->corrupt;
+            }
+            pthread_cond_broadcast(&pipeline->ready);
+            pthread_mutex_unlock(&pipeline->lock);
+            pthread_mutex_unlock(&pipeline->read_lock);
+            return NULL;
+        }
+        ++pipeline->next_read;
+        pthread_mutex_lock(&pipeline->lock);
+        block->state = BLOCK_DECODING;
+        pthread_mutex_unlock(&pipeline->lock);
+        pthread_mutex_unlock(&pipeline->read_lock);
+
+        decodeBlock(pipeline, block);
+
+        pthread_mutex_lock(&pipeline->lock);
+        block->state = BLOCK_READY;
+        pthread_cond_broadcast(&pipeline->ready);
+        pthread_mutex_unlock(&pipeline->lock);
+    }
+}
+
+Decode_Pipeline *openDecodePipeline(FILE *fd, Stream_Kind kind, bool text, Chunk_Reader *chunked,
+                                    unsigned num_threads)
+{
+    Decode_Pipeline *pipeline = (Decode_Pipeline *)calloc(1, sizeof(Decode_Pipeline));
+    pipeline->fd = fd;
+    pipeline->kind = kind;
+    pipeline->text = text;
+    pipeline->chunked = chunked;
+    pipeline->text_offset = text ? ftell(fd) : 0;
+    pipeline->done_offset = pipeline->text_offset;
+
+    num_threads = num_threads < 1 ? 1 : num_threads;
+    num_threads = num_threads > max_decode_threads ? max_decode_threads : num_threads;
+    pipeline->num_blocks = blocks_per_thread * num_threads + 1;
+    pipeline->blocks = (Decode_Block *)calloc(pipeline->num_blocks, sizeof(Decode_Block));
+
+    pthread_mutex_init(&pipeline->read_lock, NULL);
+    pthread_mutex_init(&pipeline->lock, NULL);
+    pthread_cond_init(&pipeline->ready, NULL);
+    pthread_cond_init(&pipeline->freed, NULL);
+
+    pipeline->threads = (pthread_t *)malloc(num_threads * sizeof(pthread_t));
+    unsigned t;
+    for (t = 0; t < num_threads; t++)
+    {
+        if (pthread_create(&pipeline->threads[t], NULL, decodeThread, pipeline) != 0)
+        {
+            break;
+        }
+    }
+    pipeline->num_threads = t;
+    if (t == 0)
+    {
+        closeDecodePipeline(pipeline);
+        return NULL;
+    }
+
+    return pipeline;
+}
+
+// Give the current block back and wait for the next one; false at the end
+static bool nextBlock(Decode_Pipeline *pipeline)
+{
+    pthread_mutex_lock(&pipeline->lock);
+    if (pipeline->current != NULL)
+    {
+        pipeline->corrupt = pipeline->current->corrupt;
+        pipeline->done_offset = pipeline->current->offset + pipeline->current->raw.bytes;
+        pipeline->current->state = BLOCK_FREE;
+        pipeline->current = NULL;
+        ++pipeline->next_block;
+        pthread_cond_broadcast(&pipeline->freed);
+    }
+
+    Decode_Block *block = &pipeline->blocks[pipeline->next_block % pipeline->num_blocks];
+    while (!pipeline->corrupt && block->state != BLOCK_READY &&
+           !(pipeline->end && pipeline->next_block >= pipeline->end_block))
+    {
+        pthread_cond_wait(&pipeline->ready, &pipeline->lock);
+    }
+
+    bool ready = !pipeline->corrupt && block->state == BLOCK_READY;
+    if (ready)
+    {
+        pipeline->current = block;
+        pipeline->next_record = 0;
+        pipeline->rejected_lines += block->rejected_lines;
+    }
+    else
+    {
+        pipeline->corrupt = pipeline->corrupt || pipeline->read_corrupt;
+    }
+    pthread_mutex_unlock(&pipeline->lock);
+    return ready;
+}
+
+bool readDecodedRecord(Decode_Pipeline *pipeline, Stream_Record *record)
+{
+    while (pipeline->current == NULL || pipeline->next_record == pipeline->current->num_records)
+    {
+        if (!nextBlock(pipeline))
+        {
+            return false;
+        }
+    }
+
+    *record = pipeline->current->records[pipeline->next_record++];
+    return true;
+}
+
+uint64_t decodedTextOffset(const Decode_Pipeline *pipeline)
+{
+    const Decode_Block *block = pipeline->current;
+    if (block == NULL || pipeline->next_record == 0)
+    {
+        return pipeline->done_offset;
+    }
+    return block->offset + block->line_ends[pipeline->next_record - 1];
+}
+
+void closeDecodePipeline(Decode_Pipeline *pipeline)
+{
+    pthread_mutex_lock(&pipeline->lock);
+    pipeline->stop = true;
+    pthread_cond_broadcast(&pipeline->freed);
+    pthread_mutex_unlock(&pipeline->lock);
+
+    unsigned t;
+    for (t = 0; t < pipeline->num_threads; t++)
+    {
+        pthread_join(pipeline->threads[t], NULL);
+    }
+
+    unsigned b;
+    for (b = 0; b < pipeline->num_blocks; b++)
+    {
+        free(pipeline->blocks[b].raw.payload);
+        free(pipeline->blocks[b].records);
+        free(pipeline->blocks[b].line_ends);
+    }
+    pthread_mutex_destroy(&pipeline->read_lock);
+    pthread_mutex_destroy(&pipeline->lock);
+    pthread_cond_destroy(&pipeline->ready);
+    pthread_cond_destroy(&pipeline->freed);
+    free(pipeline->blocks);
+    free(pipeline->threads);
+    free(pipeline->carry);
+    free(pipeline);
+}
+
+bool parseDecodeOption(unsigned *num_threads, int argc, const char *argv[], int *arg)
+{
+    if (strcmp(argv[*arg], "--decode-threads") != 0 || *arg + 1 >= argc)
+    {
+        return false;
+    }
+
+    int val = atoi(argv[*arg + 1]);
+    if (val < 0 || val > max_decode_threads)
+    {
+        return false;
+    }
+    *num_threads = val;
+    ++*arg;
+    return true;
+}
+
+void printDecodeUsage()
+{
+    printf("  --decode-threads N decode the trace on N threads, ahead of the simulation\n");
+    printf("                     (default 0: on the simulation's own thread)\n");
+}
@@ -0,0 +1,105 @@
+#ifndef __TRACE_DECODE_HH__
+#define __TRACE_DECODE_HH__
+
+#include <pthread.h>
+
+#include "Binary_Trace.h"
+#include "Chunked_Trace.h"
+
+// Parallel trace decoding, behind the TraceParser of both simulators.
+//
+// The trace is cut at record boundaries into blocks: lines of a text trace,
+// fixed-size records of a flat stream (see Binary_Trace.h) or the chunks of
+// a container (Chunked_Trace.h). Decode threads take the blocks in file
+// order, each reading its block under a lock then decoding it on its own
+// into Stream_Records. The blocks go round a ring of slots, so that at most
+// that many are decoded ahead of the simulator, and are handed out in file
+// order: the simulation stays sequential and sees the records of the
+// sequential parser.
+
+#define text_block_bytes (1 << 20) // Text read per block, cut after its last line
+#define flat_block_records 65536
+#define blocks_per_thread 2 // Slots in the ring, per decode thread
+#define max_decode_threads 64
+
+typedef enum Block_State{BLOCK_FREE, BLOCK_DECODING, BLOCK_READY}Block_State;
+
+typedef struct Decode_Block
+{
+    Block_State state;
+
+    // As read
+    Raw_Chunk raw; // Chunks; text and flat records go in raw.payload too
+    uint64_t offset; // Text: file offset of raw.payload
+
+    // Decoded
+    Stream_Record *records;
+    uint32_t *line_ends; // Text: end of the line of each record, in raw.payload
+    size_t num_records;
+    size_t records_capacity;
+    bool corrupt; // The records stop early
+    size_t rejected_lines; // Text: lines that are not records, blank ones aside
+}Decode_Block;
+
+typedef struct Decode_Pipeline
+{
+    FILE *fd; // At the first record
+    Stream_Kind kind;
+    bool text;
+    Chunk_Reader *chunked; // NULL if text or flat
+
+    pthread_t *threads;
+    unsigned num_threads;
+
+    Decode_Block *blocks; // The ring
+    unsigned num_blocks;
+
+    // Reading, in file order
+    pthread_mutex_t read_lock;
+    uint64_t next_read; // Sequence number of the next block read
+    char *carry; // Text after the last whole line of the last block
+    size_t carry_bytes;
+    size_t carry_capacity;
+    uint64_t text_offset; // File offset of the carry
+
+    // Handing out, also in file order
+    pthread_mutex_t lock;
+    pthread_cond_t ready; // A block is decoded, or the end is read
+    pthread_cond_t freed; // The simulator is done with a block
+    uint64_t next_block; // Sequence number of the next block handed out
+    uint64_t end_block; // Number of blocks, once the end is read
+    bool end;
+    bool stop;
+    bool read_corrupt; // A chunk was cut short
+
+    Decode_Block *current; // Handed out, being read by the simulator
+    size_t next_record;
+    uint64_t done_offset; // Text: end of the blocks given back
+    uint64_t rejected_lines; // Text: of the blocks handed out
+    bool corrupt;
+}Decode_Pipeline;
+
+// Decode the rest of fd, of kind, on num_threads threads. fd is at the first
+// record: after the header of a binary stream, at the start of a text trace,
+// or read through chunked for a container. fd and chunked stay open.
+Decode_Pipeline *openDecodePipeline(FILE *fd, Stream_Kind kind, bool text, Chunk_Reader *chunked,
+                                    unsigned num_threads);
+// False at the end of the trace, or after a corrupt block (corrupt is set)
+bool readDecodedRecord(Decode_Pipeline *pipeline, Stream_Record *record);
+// Of a text trace, the file offset of the line after the last record read
+uint64_t decodedTextOffset(const Decode_Pipeline *pipeline);
+void closeDecodePipeline(Decode_Pipeline *pipeline);
+
+// A line of a text trace, "PC E", "PC B taken" or "PC L|S addr size" for
+// CPU traces and "core PC addr L|S" for memory traces; false if it is not
+// one. line is cut up.
+bool parseTextRecord(char *line, Stream_Kind kind, Stream_Record *record);
+// Whether line holds nothing but spaces, also once parseTextRecord() cut it
+// up; the other lines it turns down are malformed
+bool isBlankLine(const char *line);
+
+// --decode-threads N
+bool parseDecodeOption(unsigned *num_threads, int argc, const char *argv[], int *arg);
+void printDecodeUsage();
+
+#endif
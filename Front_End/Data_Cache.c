@@ -0,0 +1,69 @@
+#include "Data_Cache.h"
+
+Data_Cache *initDataCache(const Cache_Config *config)
+{
+    // Belady needs the next use of every request, a second pass over the trace
+    if (config->policy == BELADY_POLICY)
+    {
+        fprintf(stderr, "The data cache cannot replace with %s\n", policyName(config->policy));
+        return NULL;
+    }
+    Cache *cache = initCache(config);
+    if (cache == NULL)
+    {
+        return NULL;
+    }
+
+    Data_Cache *data_cache = (Data_Cache *)calloc(1, sizeof(Data_Cache));
+    data_cache->cache = cache;
+    data_cache->block_size = config->block_size;
+
+    return data_cache;
+}
+
+void freeDataCache(Data_Cache *data_cache)
+{
+    freeCache(data_cache->cache);
+    free(data_cache);
+}
+
+const char *dataPolicyName(const Data_Cache *data_cache)
+{
+    return policyName(getPolicy(data_cache->cache));
+}
+
+unsigned accessData(Data_Cache *data_cache, uint64_t PC, uint64_t addr, int size, bool store)
+{
+    uint64_t blk_mask = data_cache->block_size - 1;
+    uint64_t first = addr & ~blk_mask;
+    uint64_t last = (addr + (size > 1 ? size : 1) - 1) & ~blk_mask;
+
+    ++data_cache->accesses;
+    data_cache->split_accesses += first != last;
+
+    uint64_t num_blocks = (last - first) / data_cache->block_size + 1;
+    unsigned num_misses = 0;
+    uint64_t i;
+    for (i = 0; i < num_blocks; i++)
+    {
+        // The first block at addr itself, the others from their start
+        uint64_t block_addr = i == 0 ? addr : first + i * data_cache->block_size;
+
+        if (accessCache(data_cache->cache, PC, block_addr, store, 0))
+        {
+            ++data_cache->hits;
+        }
+        else
+        {
+            ++data_cache->misses;
+            ++num_misses;
+        }
+    }
+
+    Cache_Stats stats;
+    getCacheStats(data_cache->cache, &stats);
+    data_cache->evictions = stats.evictions;
+    data_cache->writebacks = stats.writebacks;
+
+    return num_misses;
+}
@@ -0,0 +1,41 @@
+#ifndef __DATA_CACHE_HH__
+#define __DATA_CACHE_HH__
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h> // uint64_t
+
+#include "cachesim.h"
+
+// The data cache of the front-end, on top of libcachesim. Loads and stores
+// of any size become one cache access per block.
+
+typedef struct Data_Cache
+{
+    Cache *cache;
+    uint64_t block_size;
+
+    uint64_t accesses; // Loads and stores
+    uint64_t split_accesses; // Loads and stores crossing a block boundary
+
+    // Per block accessed
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    uint64_t writebacks;
+}Data_Cache;
+
+// NULL if the cache cannot be had, or replaces with Belady
+Data_Cache *initDataCache(const Cache_Config *config);
+void freeDataCache(Data_Cache *data_cache);
+
+const char *dataPolicyName(const Data_Cache *data_cache);
+
+// Load or store the size bytes at addr, one cache access per block they
+// touch. Returns the number of blocks missed.
+unsigned accessData(Data_Cache *data_cache, uint64_t PC, uint64_t addr, int size, bool store);
+
+#endif
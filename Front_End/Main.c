@@ -0,0 +1,269 @@
+#include "Trace.h"
+#include "bpsim.h"
+#include "Data_Cache.h"
+#include "Timing.h"
+#include "Time_Series.h"
+
+extern TraceParser *initTraceParser(const char * trace_file);
+extern TraceParser *openTraceParser(const char * trace_file, unsigned decode_threads);
+extern bool getInstruction(TraceParser *cpu_trace);
+extern void closeTraceParser(TraceParser *cpu_trace);
+
+// Measured counters of both sides, also kept at the start of each time series row
+typedef struct Front_End_Counts
+{
+    uint64_t instructions;
+    uint64_t branches;
+    uint64_t correct;
+    uint64_t mem_accesses; // Loads and stores
+    uint64_t block_accesses; // Cache accesses, more than mem_accesses if some cross blocks
+    uint64_t block_misses;
+    uint64_t split_accesses; // Loads and stores crossing a block boundary
+    uint64_t cycles;
+}Front_End_Counts;
+
+// Copy the measured part of the data cache counters
+static void countData(Front_End_Counts *counts, const Data_Cache *now, const Data_Cache *start)
+{
+    counts->mem_accesses = now->accesses - start->accesses;
+    counts->block_accesses = now->hits + now->misses - start->hits - start->misses;
+    counts->block_misses = now->misses - start->misses;
+    counts->split_accesses = now->split_accesses - start->split_accesses;
+}
+
+// Total cycles so far, charged to stages
+static uint64_t countCycles(Timing *timing, bool drain, uint64_t *stage_cycles)
+{
+    getStageCycles(timing, drain, stage_cycles);
+
+    uint64_t cycles = 0;
+    unsigned stage;
+    for (stage = 0; stage < num_timing_stages; stage++)
+    {
+        cycles += stage_cycles[stage];
+    }
+    return cycles;
+}
+
+const char *seriesColumns[] = {"record", "instructions", "branch_mpki", "correctness",
+                               "cache_mpki", "hit_rate", "cpi"};
+
+// Write the row of the interval ending at record, then start the next one
+static void addFrontEndRow(Time_Series *series, uint64_t record, const Front_End_Counts *now,
+                           Front_End_Counts *start)
+{
+    double instructions = now->instructions - start->instructions;
+    double branches = now->branches - start->branches;
+    double mispredictions = branches - (now->correct - start->correct);
+    double block_accesses = now->block_accesses - start->block_accesses;
+    double block_misses = now->block_misses - start->block_misses;
+    double cycles = now->cycles - start->cycles;
+    if (instructions > 0)
+    {
+        double row[7] = {record, instructions,
+                         1000.0 * mispredictions / instructions,
+                         branches ? 100.0 * (branches - mispredictions) / branches : 100.0,
+                         1000.0 * block_misses / instructions,
+                         block_accesses ? 100.0 * (block_accesses - block_misses) / block_accesses : 100.0,
+                         cycles / instructions};
+        addSeriesRow(series, row);
+    }
+    *start = *now;
+}
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s [--warmup N] [--measure M] [--predictor <name>] %s\n",
+           prog, "[cache and timing options] <trace-file>");
+    printf("  --warmup N         train on the first N instructions without counting them\n");
+    printf("  --measure M        stop after measuring M instructions\n");
+    printPredictorUsage();
+    printCacheUsage();
+    printTimingUsage();
+    printSeriesUsage();
+    printDecodeUsage();
+}
+
+int main(int argc, const char *argv[])
+{
+    const char *trace_file = NULL;
+    uint64_t warmup = 0;
+    uint64_t measure = 0; // 0 means up to the end of the trace
+    unsigned decode_threads = 0;
+
+    Branch_Predictor_Config predictor_config;
+    initPredictorConfig(&predictor_config);
+    Cache_Config cache_config;
+    initCacheConfig(&cache_config);
+    Timing_Config timing_config;
+    initTimingConfig(&timing_config);
+    Series_Config series_config;
+    initSeriesConfig(&series_config);
+
+    int arg;
+    for (arg = 1; arg < argc; arg++)
+    {
+        if (strcmp(argv[arg], "--warmup") == 0 && arg + 1 < argc)
+        {
+            warmup = strtoull(argv[++arg], NULL, 10);
+        }
+        else if (strcmp(argv[arg], "--measure") == 0 && arg + 1 < argc)
+        {
+            measure = strtoull(argv[++arg], NULL, 10);
+        }
+        else if (parsePredictorOption(&predictor_config, argc, argv, &arg))
+        {
+        }
+        else if (parseCacheOption(&cache_config, argc, argv, &arg))
+        {
+        }
+        else if (parseTimingOption(&timing_config, argc, argv, &arg))
+        {
+        }
+        else if (parseSeriesOption(&series_config, argc, argv, &arg))
+        {
+        }
+        else if (parseDecodeOption(&decode_threads, argc, argv, &arg))
+        {
+        }
+        else if (argv[arg][0] != '-' && trace_file == NULL)
+        {
+            trace_file = argv[arg];
+        }
+        else
+        {
+            trace_file = NULL;
+            break;
+        }
+    }
+
+    if (trace_file == NULL)
+    {
+        usage(argv[0]);
+
+        return 0;
+    }
+
+    if (!checkCacheConfig(&cache_config))
+    {
+        return 1;
+    }
+
+    uint64_t end = measure > 0 ? warmup + measure : UINT64_MAX;
+
+    // One trace drives both the branch predictor and the data cache
+    TraceParser *cpu_trace = openTraceParser(trace_file, decode_threads);
+    Branch_Predictor *branch_predictor = initBranchPredictor(&predictor_config);
+    Data_Cache *data_cache = initDataCache(&cache_config);
+    if (cpu_trace == NULL || branch_predictor == NULL || data_cache == NULL)
+    {
+        return 1;
+    }
+
+    // Branches are predicted one at a time, the timing model needs every
+    // misprediction where it happens
+    Timing *timing = initTiming(&timing_config);
+    uint64_t stage_start[num_timing_stages] = {0};
+    uint64_t cycles_start = 0;
+
+    uint64_t num_of_instructions = 0;
+    Front_End_Counts measured = {0, 0, 0, 0, 0, 0, 0, 0};
+    uint64_t stage_cycles[num_timing_stages];
+
+    Time_Series *series = NULL;
+    uint64_t series_until = UINT64_MAX;
+    Front_End_Counts series_start = measured;
+
+    Data_Cache cache_start = *data_cache;
+    while (num_of_instructions < end && getInstruction(cpu_trace))
+    {
+        Instruction *instr = cpu_trace->cur_instr;
+        if (num_of_instructions == warmup)
+        {
+            cache_start = *data_cache;
+            cycles_start = countCycles(timing, false, stage_start);
+
+            series = openTimeSeries(&series_config, 7, seriesColumns);
+            series_until = series != NULL ? warmup + series_config.interval : UINT64_MAX;
+        }
+        if (num_of_instructions == series_until)
+        {
+            countData(&measured, data_cache, &cache_start);
+            measured.cycles = countCycles(timing, false, stage_cycles) - cycles_start;
+            addFrontEndRow(series, num_of_instructions - warmup, &measured, &series_start);
+            series_until += series_config.interval;
+        }
+
+        bool measuring = num_of_instructions >= warmup;
+        timeInstruction(timing);
+        if (instr->instr_type == BRANCH)
+        {
+            bool correct = predictBranch(branch_predictor, instr->PC, instr->taken);
+            timeBranch(timing, correct);
+            if (measuring)
+            {
+                ++measured.branches;
+                measured.correct += correct;
+            }
+        }
+        else if (instr->instr_type == LOAD || instr->instr_type == STORE)
+        {
+            bool store = instr->instr_type == STORE;
+            unsigned num_misses = accessData(data_cache, instr->PC, instr->load_or_store_addr,
+                                             instr->size, store);
+            timeMemory(timing, store, num_misses);
+        }
+        measured.instructions += measuring;
+        ++num_of_instructions;
+    }
+
+    // The loads still in flight complete before the end
+    if (num_of_instructions > warmup)
+    {
+        countData(&measured, data_cache, &cache_start);
+        measured.cycles = countCycles(timing, true, stage_cycles) - cycles_start;
+    }
+
+    if (series != NULL)
+    {
+        addFrontEndRow(series, num_of_instructions - warmup, &measured, &series_start);
+        if (!closeTimeSeries(series))
+        {
+            fprintf(stderr, "Could not write %s\n", series_config.file);
+        }
+    }
+
+    uint64_t mispredictions = measured.branches - measured.correct;
+    uint64_t block_hits = measured.block_accesses - measured.block_misses;
+    double instructions = measured.instructions > 0 ? measured.instructions : 1;
+
+    printf("Number of instructions: %"PRIu64"\n", measured.instructions);
+    printf("Number of branches: %"PRIu64"\n", measured.branches);
+    printf("Number of incorrect predictions: %"PRIu64"\n", mispredictions);
+    printf("Predictor Correctness: %f%%\n",
+           measured.branches ? 100.0 * measured.correct / measured.branches : 100.0);
+    printf("Branch MPKI: %f\n", 1000.0 * mispredictions / instructions);
+
+    printf("Number of loads and stores: %"PRIu64"\n", measured.mem_accesses);
+    printf("Number of cache accesses: %"PRIu64"\n", measured.block_accesses);
+    printf("Cache policy: %s\n", dataPolicyName(data_cache));
+    printf("Cache Hit Rate: %f%%\n",
+           measured.block_accesses ? 100.0 * block_hits / measured.block_accesses : 100.0);
+    printf("Cache MPKI: %f\n", 1000.0 * measured.block_misses / instructions);
+    printf("Accesses crossing a block boundary: %"PRIu64"\n", measured.split_accesses);
+
+    printf("Number of cycles: %"PRIu64"\n", measured.cycles);
+    printf("CPI: %f\n", measured.cycles / instructions);
+    unsigned stage;
+    for (stage = 0; stage < num_timing_stages; stage++)
+    {
+        uint64_t cycles = num_of_instructions > warmup ? stage_cycles[stage] - stage_start[stage] : 0;
+        printf("  %-8s %"PRIu64" cycles, CPI %f\n", stageName((Timing_Stage)stage), cycles,
+               cycles / instructions);
+    }
+
+    closeTraceParser(cpu_trace);
+    freeTiming(timing);
+    freeDataCache(data_cache);
+    freeBranchPredictor(branch_predictor);
+}
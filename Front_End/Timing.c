@@ -0,0 +1,196 @@
+#include "Timing.h"
+
+void initTimingConfig(Timing_Config *config)
+{
+    config->width = 4;
+    config->mispredict_penalty = 14;
+    config->cache_latency = 12;
+    config->dram_latency = 200;
+    config->mshrs = 16;
+    config->rob_size = 128;
+}
+
+bool parseTimingOption(Timing_Config *config, int argc, const char *argv[], int *arg)
+{
+    const char *opt = argv[*arg];
+    if (*arg + 1 >= argc)
+    {
+        return false;
+    }
+    unsigned val = atoi(argv[*arg + 1]);
+
+    if (strcmp(opt, "--width") == 0 && val > 0)
+    {
+        config->width = val;
+    }
+    else if (strcmp(opt, "--mispredict-penalty") == 0)
+    {
+        config->mispredict_penalty = val;
+    }
+    else if (strcmp(opt, "--cache-latency") == 0)
+    {
+        config->cache_latency = val;
+    }
+    else if (strcmp(opt, "--dram-latency") == 0)
+    {
+        config->dram_latency = val;
+    }
+    else if (strcmp(opt, "--mshrs") == 0 && val > 0)
+    {
+        config->mshrs = val;
+    }
+    else if (strcmp(opt, "--rob-size") == 0 && val > 0)
+    {
+        config->rob_size = val;
+    }
+    else
+    {
+        return false;
+    }
+
+    ++*arg;
+    return true;
+}
+
+void printTimingUsage()
+{
+    printf("  --width N          instructions issued per cycle (default 4)\n");
+    printf("  --mispredict-penalty N  cycles lost per mispredicted branch (default 14)\n");
+    printf("  --cache-latency N  data cache hit latency (default 12)\n");
+    printf("  --dram-latency N   latency added by a miss (default 200)\n");
+    printf("  --mshrs N          misses in flight at once (default 16)\n");
+    printf("  --rob-size N       instructions in flight at once (default 128)\n");
+}
+
+Timing *initTiming(const Timing_Config *config)
+{
+    Timing *timing = (Timing *)calloc(1, sizeof(Timing));
+    timing->config = *config;
+
+    timing->load_instr = (uint64_t *)malloc(config->rob_size * sizeof(uint64_t));
+    timing->load_ready = (uint64_t *)malloc(config->rob_size * sizeof(uint64_t));
+    timing->mshr_ready = (uint64_t *)malloc(config->mshrs * sizeof(uint64_t));
+
+    return timing;
+}
+
+void freeTiming(Timing *timing)
+{
+    free(timing->load_instr);
+    free(timing->load_ready);
+    free(timing->mshr_ready);
+    free(timing);
+}
+
+const char *stageName(Timing_Stage stage)
+{
+    static const char *names[num_timing_stages] = {"issue", "branch", "memory", "mshr"};
+    return names[stage];
+}
+
+// Issue nothing before cycle ready, charging the wait to stage
+static void stallUntil(Timing *timing, uint64_t ready, Timing_Stage stage)
+{
+    if (ready <= timing->cycle)
+    {
+        return;
+    }
+    if (timing->slots > 0)
+    {
+        // The cycle that did issue something
+        ++timing->stage_cycles[ISSUE_STAGE];
+        ++timing->cycle;
+        timing->slots = 0;
+    }
+    if (ready > timing->cycle)
+    {
+        timing->stage_cycles[stage] += ready - timing->cycle;
+        timing->cycle = ready;
+    }
+}
+
+void timeInstruction(Timing *timing)
+{
+    // Loads rob_size instructions old have to complete to free their entries
+    while (timing->num_loads > 0 &&
+           timing->load_instr[timing->load_head] + timing->config.rob_size <= timing->instructions)
+    {
+        stallUntil(timing, timing->load_ready[timing->load_head], MEMORY_STAGE);
+        timing->load_head = (timing->load_head + 1) % timing->config.rob_size;
+        --timing->num_loads;
+    }
+
+    if (timing->slots == timing->config.width)
+    {
+        ++timing->stage_cycles[ISSUE_STAGE];
+        ++timing->cycle;
+        timing->slots = 0;
+    }
+    ++timing->slots;
+    ++timing->instructions;
+}
+
+void timeBranch(Timing *timing, bool correct)
+{
+    if (!correct)
+    {
+        // The right path issues once the branch is resolved
+        stallUntil(timing, timing->cycle + 1 + timing->config.mispredict_penalty, BRANCH_STAGE);
+    }
+}
+
+void timeMemory(Timing *timing, bool store, unsigned num_misses)
+{
+    uint64_t ready = timing->cycle + timing->config.cache_latency;
+
+    unsigned i;
+    for (i = 0; i < num_misses; i++)
+    {
+        // Retire the misses already back, else wait for the oldest one
+        while (timing->num_mshrs > 0 &&
+               (timing->mshr_ready[timing->mshr_head] <= timing->cycle ||
+                timing->num_mshrs == timing->config.mshrs))
+        {
+            stallUntil(timing, timing->mshr_ready[timing->mshr_head], MSHR_STAGE);
+            timing->mshr_head = (timing->mshr_head + 1) % timing->config.mshrs;
+            --timing->num_mshrs;
+        }
+
+        // Misses in flight are back in order, they all take dram_latency
+        uint64_t miss_ready = timing->cycle + timing->config.cache_latency +
+                              timing->config.dram_latency;
+        timing->mshr_ready[(timing->mshr_head + timing->num_mshrs) % timing->config.mshrs] =
+            miss_ready;
+        ++timing->num_mshrs;
+        ready = miss_ready;
+    }
+
+    // Stores retire through the store buffer without waiting for their data
+    if (!store)
+    {
+        unsigned tail = (timing->load_head + timing->num_loads) % timing->config.rob_size;
+        timing->load_instr[tail] = timing->instructions - 1;
+        timing->load_ready[tail] = ready;
+        ++timing->num_loads;
+    }
+}
+
+void getStageCycles(Timing *timing, bool drain, uint64_t *cycles)
+{
+    memcpy(cycles, timing->stage_cycles, num_timing_stages * sizeof(uint64_t));
+
+    uint64_t end = timing->cycle + (timing->slots > 0);
+    cycles[ISSUE_STAGE] += timing->slots > 0;
+
+    if (drain)
+    {
+        uint64_t last = end;
+        unsigned i;
+        for (i = 0; i < timing->num_loads; i++)
+        {
+            uint64_t ready = timing->load_ready[(timing->load_head + i) % timing->config.rob_size];
+            last = ready > last ? ready : last;
+        }
+        cycles[MEMORY_STAGE] += last - end;
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef __TIMING_HH__
+#define __TIMING_HH__
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h> // uint64_t
+
+// A simple out-of-order core timing model.
+//
+// Up to width instructions issue per cycle. A mispredicted branch stops
+// issue for mispredict_penalty cycles. A load completes cache_latency cycles
+// after it issues, plus dram_latency for every block it misses; it holds its
+// reorder buffer entry until then, so issue stalls when it is rob_size
+// instructions old and still not complete. Every missing block, loads and
+// stores alike, holds one of the mshrs until its data is back, and a miss
+// finding none free waits for the oldest.
+//
+// Every cycle is charged to one stage, so the stages add up to the total.
+
+typedef enum Timing_Stage{ISSUE_STAGE, BRANCH_STAGE, MEMORY_STAGE, MSHR_STAGE}Timing_Stage;
+
+#define num_timing_stages 4
+
+typedef struct Timing_Config
+{
+    unsigned width; // Instructions issued per cycle
+    unsigned mispredict_penalty;
+    unsigned cache_latency; // Hit latency of the data cache
+    unsigned dram_latency; // Added for every miss
+    unsigned mshrs; // Misses in flight at once
+    unsigned rob_size; // Instructions in flight at once
+}Timing_Config;
+
+typedef struct Timing
+{
+    Timing_Config config;
+
+    uint64_t instructions;
+    uint64_t cycle; // Cycle issuing now
+    unsigned slots; // Instructions issued in cycle so far
+    uint64_t stage_cycles[num_timing_stages]; // Up to cycle
+
+    // Loads in flight, oldest first: ring of rob_size entries
+    uint64_t *load_instr; // Instruction count when issued
+    uint64_t *load_ready; // Cycle the data is back
+    unsigned load_head;
+    unsigned num_loads;
+
+    // Misses in flight, oldest first: ring of mshrs entries
+    uint64_t *mshr_ready;
+    unsigned mshr_head;
+    unsigned num_mshrs;
+}Timing;
+
+// Configuration
+void initTimingConfig(Timing_Config *config);
+bool parseTimingOption(Timing_Config *config, int argc, const char *argv[], int *arg);
+void printTimingUsage();
+
+Timing *initTiming(const Timing_Config *config);
+void freeTiming(Timing *timing);
+const char *stageName(Timing_Stage stage);
+
+// Issue an instruction, then tell what it was
+void timeInstruction(Timing *timing);
+void timeBranch(Timing *timing, bool correct);
+void timeMemory(Timing *timing, bool store, unsigned num_misses);
+
+// Cycles so far per stage, the current cycle included; with drain, as if
+// every load in flight had to complete
+void getStageCycles(Timing *timing, bool drain, uint64_t *cycles);
+
+#endif
@@ -0,0 +1,586 @@
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <stddef.h>
+
+#include "bpsim.h"
+#include "cachesim.h"
+
+// Python bindings of libbpsim and libcachesim, module simulators.
+//
+// Records come in as any C-contiguous buffer (NumPy arrays, array.array,
+// bytes...) and are read in place: PCs and addresses as 8-byte integers,
+// taken and store flags as 1-byte ones. The per-record results go to out,
+// a writable 1-byte buffer such as np.empty(n, np.uint8), or to a new
+// bytearray. Whole batches run without the GIL; meanwhile the instance is
+// busy and any other call on it raises RuntimeError.
+
+#define batch_records (1u << 30) // Records per library call
+
+// Buffer of 1-D integer records of item_size bytes; sets a Python error if not
+static bool getRecords(PyObject *obj, Py_buffer *view, Py_ssize_t item_size, bool writable,
+                       const char *name)
+{
+    int flags = PyBUF_C_CONTIGUOUS | PyBUF_FORMAT | (writable ? PyBUF_WRITABLE : 0);
+    if (PyObject_GetBuffer(obj, view, flags) < 0)
+    {
+        return false;
+    }
+
+    // Any integer type of the right width, in native byte order
+    const char *format = view->format != NULL ? view->format : "B";
+    if (*format == '@' || *format == '=' || *format == '<')
+    {
+        ++format;
+    }
+    if (view->itemsize != item_size || strlen(format) != 1 || strchr("bBhHiIlLqQnN?", *format) == NULL)
+    {
+        PyErr_Format(PyExc_TypeError, "%s must hold %zd-byte integers", name, item_size);
+        PyBuffer_Release(view);
+        return false;
+    }
+    return true;
+}
+
+static Py_ssize_t numRecords(const Py_buffer *view)
+{
+    return view->len / view->itemsize;
+}
+
+// The out buffer of count records, a new bytearray if out is None
+static PyObject *getOutput(PyObject *out, Py_buffer *view, Py_ssize_t count)
+{
+    if (out == Py_None)
+    {
+        out = PyByteArray_FromStringAndSize(NULL, count);
+        if (out == NULL)
+        {
+            return NULL;
+        }
+    }
+    else
+    {
+        Py_INCREF(out);
+    }
+
+    if (!getRecords(out, view, 1, true, "out"))
+    {
+        Py_DECREF(out);
+        return NULL;
+    }
+    if (numRecords(view) != count)
+    {
+        PyErr_SetString(PyExc_ValueError, "out must have one entry per record");
+        PyBuffer_Release(view);
+        Py_DECREF(out);
+        return NULL;
+    }
+    return out;
+}
+
+// Sets a RuntimeError if a batch is running on self
+static bool checkIdle(PyObject *self, bool busy)
+{
+    if (busy)
+    {
+        PyErr_Format(PyExc_RuntimeError, "%s is running a batch in another thread",
+                     Py_TYPE(self)->tp_name);
+        return false;
+    }
+    return true;
+}
+
+// Same, and also if self has no simulator state (__init__ never ran or failed)
+static bool checkReady(PyObject *self, const void *state, bool busy)
+{
+    if (!checkIdle(self, busy))
+    {
+        return false;
+    }
+    if (state == NULL)
+    {
+        PyErr_Format(PyExc_RuntimeError, "%s is not initialized", Py_TYPE(self)->tp_name);
+        return false;
+    }
+    return true;
+}
+
+/* Branch predictor */
+typedef struct Py_Branch_Predictor
+{
+    PyObject_HEAD
+    Branch_Predictor *branch_predictor;
+    bool busy; // A batch runs without the GIL
+}Py_Branch_Predictor;
+
+// Unsigned fields of Branch_Predictor_Config that can be given by keyword
+typedef struct Config_Field
+{
+    const char *name;
+    size_t offset;
+}Config_Field;
+
+static const Config_Field predictorFields[] = {
+    {"local_predictor_size", offsetof(Branch_Predictor_Config, local_predictor_size)},
+    {"local_counter_bits", offsetof(Branch_Predictor_Config, local_counter_bits)},
+    {"local_history_bits", offsetof(Branch_Predictor_Config, local_history_bits)},
+    {"local_history_table_size", offsetof(Branch_Predictor_Config, local_history_table_size)},
+    {"global_predictor_size", offsetof(Branch_Predictor_Config, global_predictor_size)},
+    {"global_counter_bits", offsetof(Branch_Predictor_Config, global_counter_bits)},
+    {"choice_counter_bits", offsetof(Branch_Predictor_Config, choice_counter_bits)},
+    {"gshare_predictor_size", offsetof(Branch_Predictor_Config, gshare_predictor_size)},
+    {"gshare_counter_bits", offsetof(Branch_Predictor_Config, gshare_counter_bits)},
+    {"perceptron_size", offsetof(Branch_Predictor_Config, perceptron_size)},
+    {"perceptron_history", offsetof(Branch_Predictor_Config, perceptron_history)},
+    {NULL, 0}};
+
+// Set one keyword of the predictor configuration
+static bool setPredictorField(Branch_Predictor_Config *config, const char *name, PyObject *value)
+{
+    if (strcmp(name, "theta") == 0)
+    {
+        config->theta = PyFloat_AsDouble(value);
+        return !PyErr_Occurred();
+    }
+    if (strcmp(name, "huge_pages") == 0)
+    {
+        const char *pages = PyUnicode_AsUTF8(value);
+        if (pages != NULL && !parseArenaPages(pages, &config->pages))
+        {
+            PyErr_Format(PyExc_ValueError, "unknown huge_pages: %s", pages);
+        }
+        return !PyErr_Occurred();
+    }
+
+    const Config_Field *field;
+    for (field = predictorFields; field->name != NULL; field++)
+    {
+        if (strcmp(name, field->name) == 0)
+        {
+            unsigned long val = PyLong_AsUnsignedLong(value);
+            *(unsigned *)((char *)config + field->offset) = val;
+            return !PyErr_Occurred();
+        }
+    }
+
+    PyErr_Format(PyExc_TypeError, "unknown predictor option: %s", name);
+    return false;
+}
+
+static int initPyBranchPredictor(Py_Branch_Predictor *self, PyObject *args, PyObject *kwargs)
+{
+    if (!checkIdle((PyObject *)self, self->busy))
+    {
+        return -1;
+    }
+
+    Branch_Predictor_Config config;
+    initPredictorConfig(&config);
+
+    const char *type = NULL;
+    if (!PyArg_ParseTuple(args, "|s", &type))
+    {
+        return -1;
+    }
+    if (type != NULL && !parsePredictorType(type, &config.type))
+    {
+        PyErr_Format(PyExc_ValueError, "unknown predictor: %s", type);
+        return -1;
+    }
+
+    PyObject *key, *value;
+    Py_ssize_t pos = 0;
+    while (kwargs != NULL && PyDict_Next(kwargs, &pos, &key, &value))
+    {
+        const char *name = PyUnicode_AsUTF8(key);
+        if (name == NULL || !setPredictorField(&config, name, value))
+        {
+            return -1;
+        }
+    }
+
+    if (!checkPredictorConfig(&config))
+    {
+        PyErr_SetString(PyExc_ValueError, "invalid predictor configuration");
+        return -1;
+    }
+
+    if (self->branch_predictor != NULL)
+    {
+        freeBranchPredictor(self->branch_predictor);
+    }
+    self->branch_predictor = initBranchPredictor(&config);
+    if (self->branch_predictor == NULL)
+    {
+        PyErr_NoMemory();
+        return -1;
+    }
+    return 0;
+}
+
+static void freePyBranchPredictor(Py_Branch_Predictor *self)
+{
+    if (self->branch_predictor != NULL)
+    {
+        freeBranchPredictor(self->branch_predictor);
+    }
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static PyObject *pyPredict(Py_Branch_Predictor *self, PyObject *args, PyObject *kwargs)
+{
+    static char *keywords[] = {"pcs", "taken", "out", NULL};
+    PyObject *pcs_obj, *taken_obj, *out = Py_None;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|O", keywords, &pcs_obj, &taken_obj, &out) ||
+        !checkReady((PyObject *)self, self->branch_predictor, self->busy))
+    {
+        return NULL;
+    }
+
+    Py_buffer pcs, taken, correct;
+    if (!getRecords(pcs_obj, &pcs, 8, false, "pcs"))
+    {
+        return NULL;
+    }
+    if (!getRecords(taken_obj, &taken, 1, false, "taken"))
+    {
+        PyBuffer_Release(&pcs);
+        return NULL;
+    }
+
+    Py_ssize_t count = numRecords(&pcs);
+    if (numRecords(&taken) != count)
+    {
+        PyErr_SetString(PyExc_ValueError, "pcs and taken differ in length");
+        out = NULL;
+    }
+    else
+    {
+        out = getOutput(out, &correct, count);
+    }
+
+    if (out != NULL)
+    {
+        self->busy = true;
+        Py_BEGIN_ALLOW_THREADS
+        Py_ssize_t i;
+        for (i = 0; i < count; i += batch_records)
+        {
+            unsigned len = count - i < batch_records ? count - i : batch_records;
+            predictBatch(self->branch_predictor, (const uint64_t *)pcs.buf + i,
+                         (const uint8_t *)taken.buf + i, len, (uint8_t *)correct.buf + i, NULL);
+        }
+        Py_END_ALLOW_THREADS
+        self->busy = false;
+        PyBuffer_Release(&correct);
+    }
+
+    PyBuffer_Release(&pcs);
+    PyBuffer_Release(&taken);
+    return out;
+}
+
+static PyObject *pyResetPredictor(Py_Branch_Predictor *self, PyObject *unused)
+{
+    if (!checkReady((PyObject *)self, self->branch_predictor, self->busy))
+    {
+        return NULL;
+    }
+    resetBranchPredictor(self->branch_predictor);
+    Py_RETURN_NONE;
+}
+
+static PyObject *pyPredictorStats(Py_Branch_Predictor *self, PyObject *unused)
+{
+    if (!checkReady((PyObject *)self, self->branch_predictor, self->busy))
+    {
+        return NULL;
+    }
+    Predictor_Stats stats;
+    getPredictorStats(self->branch_predictor, &stats);
+
+    return Py_BuildValue("{s:K,s:K}", "branches", (unsigned long long)stats.branches,
+                         "mispredictions", (unsigned long long)stats.mispredictions);
+}
+
+static PyObject *pyPredictorName(Py_Branch_Predictor *self, void *closure)
+{
+    if (!checkReady((PyObject *)self, self->branch_predictor, false))
+    {
+        return NULL;
+    }
+    return PyUnicode_FromString(predictorName(getPredictorType(self->branch_predictor)));
+}
+
+static PyMethodDef predictorMethods[] = {
+    {"predict", (PyCFunction)(void (*)(void))pyPredict, METH_VARARGS | METH_KEYWORDS,
+     "predict(pcs, taken, out=None) -> out\n\n"
+     "Predict the branches in order and train on them. out[i] is 1 if branch i\n"
+     "was predicted correctly."},
+    {"reset", (PyCFunction)pyResetPredictor, METH_NOARGS, "Back to an untrained predictor."},
+    {"stats", (PyCFunction)pyPredictorStats, METH_NOARGS, "Branches and mispredictions so far."},
+    {NULL, NULL, 0, NULL}};
+
+static PyGetSetDef predictorGetters[] = {
+    {"type", (getter)pyPredictorName, NULL, "Predictor type", NULL},
+    {NULL, NULL, NULL, NULL, NULL}};
+
+static PyTypeObject branchPredictorType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "simulators.BranchPredictor",
+    .tp_doc = "BranchPredictor(type=default, **sizes)\n\n"
+              "A branch predictor: two_bit_local, tournament, gshare or perceptron.\n"
+              "Keywords are the fields of Branch_Predictor_Config (see bpsim.h) and\n"
+              "huge_pages (none, thp or hugetlb).",
+    .tp_basicsize = sizeof(Py_Branch_Predictor),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_new = PyType_GenericNew,
+    .tp_init = (initproc)initPyBranchPredictor,
+    .tp_dealloc = (destructor)freePyBranchPredictor,
+    .tp_methods = predictorMethods,
+    .tp_getset = predictorGetters,
+};
+
+/* Cache */
+typedef struct Py_Cache
+{
+    PyObject_HEAD
+    Cache *cache;
+    bool busy; // A batch runs without the GIL
+}Py_Cache;
+
+static int initPyCache(Py_Cache *self, PyObject *args, PyObject *kwargs)
+{
+    if (!checkIdle((PyObject *)self, self->busy))
+    {
+        return -1;
+    }
+
+    Cache_Config config;
+    initCacheConfig(&config);
+
+    static char *keywords[] = {"block_size", "cache_size", "assoc", "sets", "set_index",
+                               "huge_pages", "policy", "rrpv_bits", NULL};
+    const char *set_index = "mod";
+    const char *pages = NULL;
+    const char *policy_name = NULL;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|$IIIIsssI", keywords, &config.block_size,
+                                     &config.cache_size, &config.assoc, &config.num_sets,
+                                     &set_index, &pages, &policy_name, &config.rrpv_bits))
+    {
+        return -1;
+    }
+
+    if (strcmp(set_index, "mod") == 0 || strcmp(set_index, "xor") == 0)
+    {
+        config.set_index = strcmp(set_index, "xor") == 0 ? XOR_INDEX : MODULO_INDEX;
+    }
+    else
+    {
+        PyErr_Format(PyExc_ValueError, "unknown set_index: %s", set_index);
+        return -1;
+    }
+    if (pages != NULL && !parseArenaPages(pages, &config.pages))
+    {
+        PyErr_Format(PyExc_ValueError, "unknown huge_pages: %s", pages);
+        return -1;
+    }
+
+    // Belady needs the next use of every record, which a batch does not have
+    if (policy_name != NULL &&
+        (!parsePolicy(policy_name, &config.policy) || config.policy == BELADY_POLICY))
+    {
+        PyErr_Format(PyExc_ValueError, "unsupported policy: %s", policy_name);
+        return -1;
+    }
+
+    if (!checkCacheConfig(&config))
+    {
+        PyErr_SetString(PyExc_ValueError, "invalid cache configuration");
+        return -1;
+    }
+
+    if (self->cache != NULL)
+    {
+        freeCache(self->cache);
+    }
+    self->cache = initCache(&config);
+    if (self->cache == NULL)
+    {
+        PyErr_NoMemory();
+        return -1;
+    }
+    return 0;
+}
+
+static void freePyCache(Py_Cache *self)
+{
+    if (self->cache != NULL)
+    {
+        freeCache(self->cache);
+    }
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static PyObject *pyAccess(Py_Cache *self, PyObject *args, PyObject *kwargs)
+{
+    static char *keywords[] = {"pcs", "addrs", "stores", "out", NULL};
+    PyObject *pcs_obj, *addrs_obj, *stores_obj = Py_None, *out = Py_None;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|OO", keywords, &pcs_obj, &addrs_obj,
+                                     &stores_obj, &out) ||
+        !checkReady((PyObject *)self, self->cache, self->busy))
+    {
+        return NULL;
+    }
+
+    Py_buffer pcs, addrs, stores, hits;
+    stores.buf = NULL;
+    if (!getRecords(pcs_obj, &pcs, 8, false, "pcs"))
+    {
+        return NULL;
+    }
+    if (!getRecords(addrs_obj, &addrs, 8, false, "addrs"))
+    {
+        PyBuffer_Release(&pcs);
+        return NULL;
+    }
+    if (stores_obj != Py_None && !getRecords(stores_obj, &stores, 1, false, "stores"))
+    {
+        PyBuffer_Release(&pcs);
+        PyBuffer_Release(&addrs);
+        return NULL;
+    }
+
+    Py_ssize_t count = numRecords(&pcs);
+    if (numRecords(&addrs) != count || (stores.buf != NULL && numRecords(&stores) != count))
+    {
+        PyErr_SetString(PyExc_ValueError, "pcs, addrs and stores differ in length");
+        out = NULL;
+    }
+    else
+    {
+        out = getOutput(out, &hits, count);
+    }
+
+    if (out != NULL)
+    {
+        self->busy = true;
+        Py_BEGIN_ALLOW_THREADS
+        Py_ssize_t i;
+        for (i = 0; i < count; i += batch_records)
+        {
+            unsigned len = count - i < batch_records ? count - i : batch_records;
+            accessCacheBatch(self->cache, (const uint64_t *)pcs.buf + i,
+                             (const uint64_t *)addrs.buf + i,
+                             stores.buf != NULL ? (const uint8_t *)stores.buf + i : NULL, len,
+                             (uint8_t *)hits.buf + i);
+        }
+        Py_END_ALLOW_THREADS
+        self->busy = false;
+        PyBuffer_Release(&hits);
+    }
+
+    PyBuffer_Release(&pcs);
+    PyBuffer_Release(&addrs);
+    if (stores.buf != NULL)
+    {
+        PyBuffer_Release(&stores);
+    }
+    return out;
+}
+
+static PyObject *pyResetCache(Py_Cache *self, PyObject *unused)
+{
+    if (!checkReady((PyObject *)self, self->cache, self->busy))
+    {
+        return NULL;
+    }
+    resetCache(self->cache);
+    Py_RETURN_NONE;
+}
+
+static PyObject *pyCacheStats(Py_Cache *self, PyObject *unused)
+{
+    if (!checkReady((PyObject *)self, self->cache, self->busy))
+    {
+        return NULL;
+    }
+    Cache_Stats stats;
+    getCacheStats(self->cache, &stats);
+
+    return Py_BuildValue("{s:K,s:K,s:K,s:K,s:K}", "accesses", (unsigned long long)stats.accesses,
+                         "hits", (unsigned long long)stats.hits,
+                         "misses", (unsigned long long)stats.misses,
+                         "evictions", (unsigned long long)stats.evictions,
+                         "writebacks", (unsigned long long)stats.writebacks);
+}
+
+static PyObject *pyPolicyName(Py_Cache *self, void *closure)
+{
+    if (!checkReady((PyObject *)self, self->cache, false))
+    {
+        return NULL;
+    }
+    return PyUnicode_FromString(policyName(getPolicy(self->cache)));
+}
+
+static PyMethodDef cacheMethods[] = {
+    {"access", (PyCFunction)(void (*)(void))pyAccess, METH_VARARGS | METH_KEYWORDS,
+     "access(pcs, addrs, stores=None, out=None) -> out\n\n"
+     "Access the blocks in order, inserting on misses. out[i] is 1 if access i\n"
+     "hit. Without stores every access is a load."},
+    {"reset", (PyCFunction)pyResetCache, METH_NOARGS, "Back to an empty cache."},
+    {"stats", (PyCFunction)pyCacheStats, METH_NOARGS,
+     "Accesses, hits, misses, evictions and writebacks so far."},
+    {NULL, NULL, 0, NULL}};
+
+static PyGetSetDef cacheGetters[] = {
+    {"policy", (getter)pyPolicyName, NULL, "Replacement policy", NULL},
+    {NULL, NULL, NULL, NULL, NULL}};
+
+static PyTypeObject cacheType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "simulators.Cache",
+    .tp_doc = "Cache(*, block_size=64, cache_size=512, assoc=8, sets=0, set_index='mod',\n"
+              "      huge_pages='thp', policy='ship', rrpv_bits=2)\n\n"
+              "A set-associative cache (see Cache_Config.h); cache_size is in KB and\n"
+              "policy lru, lfu, srrip, ship or hawkeye.",
+    .tp_basicsize = sizeof(Py_Cache),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_new = PyType_GenericNew,
+    .tp_init = (initproc)initPyCache,
+    .tp_dealloc = (destructor)freePyCache,
+    .tp_methods = cacheMethods,
+    .tp_getset = cacheGetters,
+};
+
+static struct PyModuleDef simulatorsModule = {
+    PyModuleDef_HEAD_INIT,
+    .m_name = "simulators",
+    .m_doc = "The branch predictors and the cache, driven by batches of records.",
+    .m_size = -1,
+};
+
+PyMODINIT_FUNC PyInit_simulators(void)
+{
+    if (PyType_Ready(&branchPredictorType) < 0 || PyType_Ready(&cacheType) < 0)
+    {
+        return NULL;
+    }
+
+    PyObject *module = PyModule_Create(&simulatorsModule);
+    if (module == NULL)
+    {
+        return NULL;
+    }
+
+    Py_INCREF(&branchPredictorType);
+    Py_INCREF(&cacheType);
+    if (PyModule_AddObject(module, "BranchPredictor", (PyObject *)&branchPredictorType) < 0 ||
+        PyModule_AddObject(module, "Cache", (PyObject *)&cacheType) < 0)
+    {
+        Py_DECREF(module);
+        return NULL;
+    }
+    return module;
+}
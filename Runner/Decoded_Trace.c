@@ -0,0 +1,92 @@
+#include "Decoded_Trace.h"
+
+#include "Trace.h"
+
+Decoded_Trace *decodeTrace(const char *trace_file)
+{
+    TraceParser *cpu_trace = initTraceParser(trace_file);
+    if (cpu_trace == NULL)
+    {
+        return NULL;
+    }
+
+    Decoded_Trace *trace = (Decoded_Trace *)calloc(1, sizeof(Decoded_Trace));
+    uint64_t capacity = 0;
+    uint64_t skipped = 0;
+    while (getInstruction(cpu_trace))
+    {
+        Instruction *instr = cpu_trace->cur_instr;
+        ++trace->num_instructions;
+        if (instr->instr_type == EXE && skipped < UINT32_MAX)
+        {
+            ++skipped;
+            continue;
+        }
+
+        if (trace->num_records == capacity)
+        {
+            capacity = capacity ? 2 * capacity : 1 << 16;
+            trace->records = (Trace_Record *)realloc(trace->records,
+                                                     capacity * sizeof(Trace_Record));
+        }
+        Trace_Record *record = &trace->records[trace->num_records++];
+        record->PC = instr->PC;
+        record->addr = instr->load_or_store_addr;
+        record->skipped = skipped;
+        record->type = instr->instr_type;
+        record->taken = instr->instr_type == BRANCH && instr->taken;
+        record->size = instr->size;
+
+        // An EXE record carries a full run of others; this one starts the next
+        skipped = instr->instr_type == EXE;
+    }
+    trace->tail = skipped;
+    closeTraceParser(cpu_trace);
+
+    return trace;
+}
+
+void freeDecodedTrace(Decoded_Trace *trace)
+{
+    free(trace->records);
+    free(trace);
+}
+
+unsigned splitTrace(const Decoded_Trace *trace, uint64_t split, uint64_t **starts)
+{
+    unsigned num_segments = 0;
+    unsigned capacity = 16;
+    *starts = (uint64_t *)malloc(capacity * sizeof(uint64_t));
+    (*starts)[num_segments++] = 0;
+
+    uint64_t instructions = 0;
+    uint64_t r;
+    for (r = 0; split > 0 && r < trace->num_records; r++)
+    {
+        if (instructions >= split)
+        {
+            if (num_segments + 1 == capacity)
+            {
+                capacity *= 2;
+                *starts = (uint64_t *)realloc(*starts, capacity * sizeof(uint64_t));
+            }
+            (*starts)[num_segments++] = r;
+            instructions = 0;
+        }
+        instructions += recordInstructions(&trace->records[r]);
+    }
+    (*starts)[num_segments] = trace->num_records;
+
+    return num_segments;
+}
+
+uint64_t warmStart(const Decoded_Trace *trace, uint64_t start, uint64_t warm)
+{
+    uint64_t instructions = 0;
+    while (start > 0 && instructions < warm)
+    {
+        --start;
+        instructions += recordInstructions(&trace->records[start]);
+    }
+    return start;
+}
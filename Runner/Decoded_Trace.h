@@ -0,0 +1,51 @@
+#ifndef __DECODED_TRACE_HH__
+#define __DECODED_TRACE_HH__
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h> // uint64_t
+
+#include "Instruction.h"
+
+// A CPU trace parsed once into memory and shared, read only, by every job
+// on it. Only branches, loads and stores are kept; the other instructions
+// before each of them are counted in its record.
+
+typedef struct Trace_Record
+{
+    uint64_t PC;
+    uint64_t addr; // Loads and stores
+    uint32_t skipped; // Other instructions right before this one
+    uint8_t type; // Instruction_Type; EXE records only carry skipped
+    uint8_t taken;
+    uint16_t size; // Loads and stores
+}Trace_Record;
+
+typedef struct Decoded_Trace
+{
+    Trace_Record *records;
+    uint64_t num_records;
+    uint64_t num_instructions;
+    uint64_t tail; // Instructions after the last record
+}Decoded_Trace;
+
+// NULL if the trace cannot be read
+Decoded_Trace *decodeTrace(const char *trace_file);
+void freeDecodedTrace(Decoded_Trace *trace);
+
+static inline uint64_t recordInstructions(const Trace_Record *record)
+{
+    return record->skipped + (record->type != EXE);
+}
+
+// Cut the trace into segments of at least split instructions (0: one
+// segment). starts[s] is the first record of segment s, starts[num] the
+// end. Returns the number of segments.
+unsigned splitTrace(const Decoded_Trace *trace, uint64_t split, uint64_t **starts);
+// First record of the warm instructions before record start
+uint64_t warmStart(const Decoded_Trace *trace, uint64_t start, uint64_t warm);
+
+#endif
@@ -0,0 +1,131 @@
+#include "Journal.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define max_name_length 256
+
+bool getFileIdentity(const char *file, File_Identity *identity)
+{
+    struct stat st;
+    if (stat(file, &st) != 0)
+    {
+        perror(file);
+        return false;
+    }
+    identity->size = st.st_size;
+    identity->mtime = st.st_mtim.tv_sec;
+    identity->mtime_ns = st.st_mtim.tv_nsec;
+    return true;
+}
+
+// Replay the lines of an existing journal and set *end past its last whole
+// line; false if its header does not match or an entry stopped the replay
+static bool replayJournal(FILE *fd, const char *file, uint64_t split, uint64_t warm,
+                          Config_Entry_Function onConfig, Trace_Entry_Function onTrace,
+                          Job_Entry_Function onJob, void *ctx, long *end)
+{
+    char *line = NULL;
+    size_t len = 0;
+    bool ok = true;
+    bool header = false;
+    while (ok && getline(&line, &len, fd) != -1)
+    {
+        // Only whole lines count, the last one may have been cut short
+        if (line[strlen(line) - 1] != '\n')
+        {
+            break;
+        }
+        *end = ftell(fd);
+
+        char trace[max_name_length], config[max_name_length];
+        uint64_t a, b;
+        unsigned segment;
+        File_Identity identity;
+        Job_Counts counts;
+        if (!header)
+        {
+            header = true;
+            ok = sscanf(line, "runner-journal %"SCNu64" %"SCNu64, &a, &b) == 2 &&
+                 a == split && b == warm;
+            if (!ok)
+            {
+                fprintf(stderr, "%s is not the journal of a run with --split %"PRIu64
+                        " --split-warm %"PRIu64"\n", file, split, warm);
+            }
+        }
+        else if (sscanf(line, "config %255s %"SCNx64, config, &a) == 2)
+        {
+            ok = onConfig(ctx, config, a);
+        }
+        else if (sscanf(line, "trace %255s %"SCNu64" %u %"SCNu64" %"SCNd64" %"SCNd64, trace, &a,
+                        &segment, &identity.size, &identity.mtime, &identity.mtime_ns) == 6)
+        {
+            ok = onTrace(ctx, trace, a, segment, &identity);
+        }
+        else if (sscanf(line, "job %255s %255s %u %"SCNu64" %"SCNu64" %"SCNu64" %"SCNu64" %"SCNu64,
+                        trace, config, &segment, &counts.instructions, &counts.branches,
+                        &counts.correct, &counts.block_accesses, &counts.block_misses) == 8)
+        {
+            onJob(ctx, trace, config, segment, &counts);
+        }
+    }
+    free(line);
+    return ok;
+}
+
+FILE *openJournal(const char *file, uint64_t split, uint64_t warm, Config_Entry_Function onConfig,
+                  Trace_Entry_Function onTrace, Job_Entry_Function onJob, void *ctx)
+{
+    FILE *fd = fopen(file, "a+");
+    if (fd == NULL)
+    {
+        perror(file);
+        return NULL;
+    }
+
+    long end = 0;
+    if (!replayJournal(fd, file, split, warm, onConfig, onTrace, onJob, ctx, &end))
+    {
+        fclose(fd);
+        return NULL;
+    }
+
+    // Drop a line cut short, a new journal gets its header
+    if (ftruncate(fileno(fd), end) != 0 || fseek(fd, 0, SEEK_END) != 0)
+    {
+        perror(file);
+        fclose(fd);
+        return NULL;
+    }
+    if (end == 0)
+    {
+        fprintf(fd, "runner-journal %"PRIu64" %"PRIu64"\n", split, warm);
+        fflush(fd);
+    }
+
+    return fd;
+}
+
+void journalConfig(FILE *journal, const char *config, uint64_t options_hash)
+{
+    fprintf(journal, "config %s %016"PRIx64"\n", config, options_hash);
+    fflush(journal);
+}
+
+void journalTrace(FILE *journal, const char *trace, uint64_t instructions, unsigned num_segments,
+                  const File_Identity *identity)
+{
+    fprintf(journal, "trace %s %"PRIu64" %u %"PRIu64" %"PRId64" %"PRId64"\n", trace, instructions,
+            num_segments, identity->size, identity->mtime, identity->mtime_ns);
+    fflush(journal);
+}
+
+void journalJob(FILE *journal, const char *trace, const char *config, unsigned segment,
+                const Job_Counts *counts)
+{
+    fprintf(journal, "job %s %s %u %"PRIu64" %"PRIu64" %"PRIu64" %"PRIu64" %"PRIu64"\n",
+            trace, config, segment, counts->instructions, counts->branches, counts->correct,
+            counts->block_accesses, counts->block_misses);
+    fflush(journal);
+}
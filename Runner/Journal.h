@@ -0,0 +1,68 @@
+#ifndef __JOURNAL_HH__
+#define __JOURNAL_HH__
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h> // uint64_t
+
+// The finished jobs of a run, appended one line each as they finish so that
+// an interrupted run resumes with the jobs left:
+//
+//   runner-journal <split> <warm>
+//   config <config> <options-hash>
+//   trace <trace> <instructions> <segments> <file-size> <mtime> <mtime-ns>
+//   job <trace> <config> <segment> <instructions> <branches> <correct>
+//       <block-accesses> <block-misses>
+//
+// (a job is one line). A line cut short by the interruption is ignored and
+// its job runs again. Entries are keyed by the names of the manifest; the
+// config and trace lines tell whether a name still stands for the same
+// options and the same trace file.
+
+// Measured counts of one job, or of a whole trace
+typedef struct Job_Counts
+{
+    uint64_t instructions;
+    uint64_t branches;
+    uint64_t correct;
+    uint64_t block_accesses; // Cache accesses, one per block a load or store touches
+    uint64_t block_misses;
+}Job_Counts;
+
+// A trace file as of a run, to tell if it changed since
+typedef struct File_Identity
+{
+    uint64_t size;
+    int64_t mtime;
+    int64_t mtime_ns;
+}File_Identity;
+
+// False, after printing why, if file cannot be found
+bool getFileIdentity(const char *file, File_Identity *identity);
+
+// The config and trace entries return false to stop the replay, the
+// journal being of another run
+typedef bool (*Config_Entry_Function)(void *ctx, const char *config, uint64_t options_hash);
+typedef bool (*Trace_Entry_Function)(void *ctx, const char *trace, uint64_t instructions,
+                                     unsigned num_segments, const File_Identity *identity);
+typedef void (*Job_Entry_Function)(void *ctx, const char *trace, const char *config,
+                                   unsigned segment, const Job_Counts *counts);
+
+// Replay the entries already in file, then open it for appending. NULL if
+// it cannot be opened, was written with another split or warm, or an
+// entry stopped the replay.
+FILE *openJournal(const char *file, uint64_t split, uint64_t warm, Config_Entry_Function onConfig,
+                  Trace_Entry_Function onTrace, Job_Entry_Function onJob, void *ctx);
+
+// Each entry is flushed at once
+void journalConfig(FILE *journal, const char *config, uint64_t options_hash);
+void journalTrace(FILE *journal, const char *trace, uint64_t instructions, unsigned num_segments,
+                  const File_Identity *identity);
+void journalJob(FILE *journal, const char *trace, const char *config, unsigned segment,
+                const Job_Counts *counts);
+
+#endif
@@ -0,0 +1,666 @@
+#include <math.h>
+#include <unistd.h>
+
+#include "Manifest.h"
+#include "Decoded_Trace.h"
+#include "Journal.h"
+#include "Pool.h"
+#include "Data_Cache.h"
+
+// Runs every configuration of a manifest on every trace of it, as the
+// front-end does without timing: the branch predictor and the data cache
+// driven by one CPU trace.
+//
+// Each trace is decoded once, by a job that then adds one job per
+// configuration and segment; the jobs of a trace share its decoded records,
+// which are freed after the last one. A trace longer than split
+// instructions is cut into segments so that no single job holds up the end
+// of the run. Each segment warms a fresh predictor and cache on the warm
+// instructions before it, so split results are close to, not equal to,
+// those of a whole run.
+
+typedef struct Runner_Config
+{
+    unsigned threads;
+    uint64_t split; // Instructions per segment, 0: whole traces
+    uint64_t warm; // Instructions warmed before each segment
+    const char *journal; // NULL: no resuming
+    const char *output; // CSV of the results, NULL: none
+}Runner_Config;
+
+// What is known and measured of one trace
+typedef struct Trace_State
+{
+    uint64_t num_instructions;
+    unsigned num_segments; // 0 until decoded or found in the journal
+    bool *done; // [config * num_segments + segment]
+    unsigned *segments_done; // Per config
+    Job_Counts *totals; // Per config
+    bool failed;
+
+    Decoded_Trace *decoded;
+    uint64_t *starts; // Of the segments, in records
+    unsigned pending; // Segment jobs left on decoded
+}Trace_State;
+
+typedef struct Runner
+{
+    Runner_Config config;
+    const Manifest *manifest;
+    Trace_State *traces;
+
+    FILE *journal;
+    bool *journaled; // Per config, in the journal with the same options
+    pthread_mutex_t lock; // Trace states and journal
+    uint64_t jobs_run;
+    uint64_t jobs_resumed;
+}Runner;
+
+// A decode job (config and segment unused) or a segment job
+typedef struct Runner_Job
+{
+    Runner *runner;
+    unsigned trace;
+    unsigned config;
+    unsigned segment;
+}Runner_Job;
+
+static void initRunnerConfig(Runner_Config *config)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    config->threads = cpus > 0 ? cpus : 1;
+    config->split = 50000000;
+    config->warm = 5000000;
+    config->journal = NULL;
+    config->output = NULL;
+}
+
+static bool parseRunnerOption(Runner_Config *config, int argc, const char *argv[], int *arg)
+{
+    const char *opt = argv[*arg];
+    if (*arg + 1 >= argc)
+    {
+        return false;
+    }
+    const char *val = argv[*arg + 1];
+
+    if (strcmp(opt, "--threads") == 0 && atoi(val) > 0)
+    {
+        config->threads = atoi(val);
+    }
+    else if (strcmp(opt, "--split") == 0)
+    {
+        config->split = strtoull(val, NULL, 10);
+    }
+    else if (strcmp(opt, "--split-warm") == 0)
+    {
+        config->warm = strtoull(val, NULL, 10);
+    }
+    else if (strcmp(opt, "--journal") == 0)
+    {
+        config->journal = val;
+    }
+    else if (strcmp(opt, "--output") == 0)
+    {
+        config->output = val;
+    }
+    else
+    {
+        return false;
+    }
+
+    ++*arg;
+    return true;
+}
+
+static void printRunnerUsage()
+{
+    printf("  --threads N        worker threads (default: one per CPU)\n");
+    printf("  --split N          cut traces into jobs of N instructions, 0 never\n");
+    printf("                     (default 50000000)\n");
+    printf("  --split-warm W     warm each cut job on the W instructions before it\n");
+    printf("                     (default 5000000)\n");
+    printf("  --journal <file>   record finished jobs in <file> and skip the ones it\n");
+    printf("                     already holds, to resume an interrupted run\n");
+    printf("  --output <file>    also write the results as CSV to <file>\n");
+}
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s [options] <manifest>\n", prog);
+    printf("The manifest has one entry per line:\n");
+    printf("  trace <name> <trace-file>\n");
+    printf("  config <name> [--predictor <name>] [--policy <name>] [cache options]\n");
+    printf("and every config runs on every trace.\n");
+    printRunnerUsage();
+}
+
+// Size the state of a trace of num_segments; false if it was known with another
+static bool setSegments(Trace_State *state, unsigned num_configs, uint64_t instructions,
+                        unsigned num_segments)
+{
+    if (state->num_segments > 0)
+    {
+        return state->num_segments == num_segments && state->num_instructions == instructions;
+    }
+    state->num_instructions = instructions;
+    state->num_segments = num_segments;
+    state->done = (bool *)calloc((size_t)num_configs * num_segments, sizeof(bool));
+    return true;
+}
+
+// Add a finished segment, unless it was already
+static bool addSegment(Runner *runner, unsigned trace, unsigned config, unsigned segment,
+                       const Job_Counts *counts)
+{
+    Trace_State *state = &runner->traces[trace];
+    bool *done = &state->done[config * state->num_segments + segment];
+    if (*done)
+    {
+        return false;
+    }
+    *done = true;
+    ++state->segments_done[config];
+
+    Job_Counts *total = &state->totals[config];
+    total->instructions += counts->instructions;
+    total->branches += counts->branches;
+    total->correct += counts->correct;
+    total->block_accesses += counts->block_accesses;
+    total->block_misses += counts->block_misses;
+    return true;
+}
+
+// Jobs are only taken from the journal for the configs it has with the
+// options of the manifest, and for traces whose file has not changed since
+static bool replayConfig(void *ctx, const char *config, uint64_t options_hash)
+{
+    Runner *runner = (Runner *)ctx;
+    int c = findConfig(runner->manifest, config);
+    if (c < 0)
+    {
+        return true;
+    }
+    if (options_hash != hashRunConfig(&runner->manifest->configs[c]))
+    {
+        fprintf(stderr, "Config %s has other options than in the journal %s\n", config,
+                runner->config.journal);
+        return false;
+    }
+    runner->journaled[c] = true;
+    return true;
+}
+
+static bool replayTrace(void *ctx, const char *trace, uint64_t instructions, unsigned num_segments,
+                        const File_Identity *identity)
+{
+    Runner *runner = (Runner *)ctx;
+    int t = findTrace(runner->manifest, trace);
+    if (t < 0 || num_segments == 0)
+    {
+        return true;
+    }
+
+    const char *file = runner->manifest->traces[t].file;
+    File_Identity now;
+    if (!getFileIdentity(file, &now) || now.size != identity->size ||
+        now.mtime != identity->mtime || now.mtime_ns != identity->mtime_ns ||
+        !setSegments(&runner->traces[t], runner->manifest->num_configs, instructions, num_segments))
+    {
+        fprintf(stderr, "%s has changed since the journal %s was written\n", file,
+                runner->config.journal);
+        return false;
+    }
+    return true;
+}
+
+static void replayJob(void *ctx, const char *trace, const char *config, unsigned segment,
+                      const Job_Counts *counts)
+{
+    Runner *runner = (Runner *)ctx;
+    int t = findTrace(runner->manifest, trace);
+    int c = findConfig(runner->manifest, config);
+    if (t >= 0 && c >= 0 && runner->journaled[c] && segment < runner->traces[t].num_segments &&
+        addSegment(runner, t, c, segment, counts))
+    {
+        ++runner->jobs_resumed;
+    }
+}
+
+// Measure records [start, end) of the trace after warming on [warm_start, start)
+static bool runSegment(const Run_Config *config, const Decoded_Trace *trace, uint64_t warm_start,
+                       uint64_t start, uint64_t end, Job_Counts *counts)
+{
+    Branch_Predictor *branch_predictor = initBranchPredictor(&config->predictor);
+    Data_Cache *data_cache = initDataCache(&config->cache);
+    if (branch_predictor == NULL || data_cache == NULL)
+    {
+        return false;
+    }
+
+    memset(counts, 0, sizeof(Job_Counts));
+    Data_Cache cache_start = *data_cache;
+    uint64_t r;
+    for (r = warm_start; r < end; r++)
+    {
+        const Trace_Record *record = &trace->records[r];
+        if (r == start)
+        {
+            cache_start = *data_cache;
+        }
+
+        bool measuring = r >= start;
+        if (record->type == BRANCH)
+        {
+            bool correct = predictBranch(branch_predictor, record->PC, record->taken);
+            if (measuring)
+            {
+                ++counts->branches;
+                counts->correct += correct;
+            }
+        }
+        else if (record->type == LOAD || record->type == STORE)
+        {
+            accessData(data_cache, record->PC, record->addr, record->size, record->type == STORE);
+        }
+        counts->instructions += measuring ? recordInstructions(record) : 0;
+    }
+    counts->instructions += end == trace->num_records ? trace->tail : 0;
+    counts->block_accesses = data_cache->hits + data_cache->misses -
+                             cache_start.hits - cache_start.misses;
+    counts->block_misses = data_cache->misses - cache_start.misses;
+
+    freeDataCache(data_cache);
+    freeBranchPredictor(branch_predictor);
+    return true;
+}
+
+// The last job on a decoded trace frees it
+static void releaseTrace(Trace_State *state)
+{
+    if (--state->pending == 0)
+    {
+        freeDecodedTrace(state->decoded);
+        free(state->starts);
+        state->decoded = NULL;
+        state->starts = NULL;
+    }
+}
+
+static void segmentJob(Job_Pool *pool, unsigned worker, void *arg)
+{
+    Runner_Job *job = (Runner_Job *)arg;
+    Runner *runner = job->runner;
+    Trace_State *state = &runner->traces[job->trace];
+
+    uint64_t start = state->starts[job->segment];
+    uint64_t end = state->starts[job->segment + 1];
+    uint64_t warm_start = job->segment > 0 ? warmStart(state->decoded, start, runner->config.warm)
+                                           : start;
+    Job_Counts counts;
+    bool ok = runSegment(&runner->manifest->configs[job->config], state->decoded, warm_start,
+                         start, end, &counts);
+
+    pthread_mutex_lock(&runner->lock);
+    if (ok)
+    {
+        addSegment(runner, job->trace, job->config, job->segment, &counts);
+        ++runner->jobs_run;
+        if (runner->journal != NULL)
+        {
+            journalJob(runner->journal, runner->manifest->traces[job->trace].name,
+                       runner->manifest->configs[job->config].name, job->segment, &counts);
+        }
+    }
+    else
+    {
+        fprintf(stderr, "Out of memory for %s on %s\n", runner->manifest->configs[job->config].name,
+                runner->manifest->traces[job->trace].name);
+        state->failed = true;
+    }
+    releaseTrace(state);
+    pthread_mutex_unlock(&runner->lock);
+
+    free(job);
+}
+
+// Decode the trace, then add the segment jobs not done yet on this worker
+static void decodeJob(Job_Pool *pool, unsigned worker, void *arg)
+{
+    Runner_Job *job = (Runner_Job *)arg;
+    Runner *runner = job->runner;
+    unsigned trace = job->trace;
+    const Trace_Entry *entry = &runner->manifest->traces[trace];
+    Trace_State *state = &runner->traces[trace];
+    free(job);
+
+    File_Identity identity;
+    Decoded_Trace *decoded = getFileIdentity(entry->file, &identity) ? decodeTrace(entry->file)
+                                                                      : NULL;
+    uint64_t *starts = NULL;
+    unsigned num_segments = decoded != NULL ? splitTrace(decoded, runner->config.split, &starts) : 0;
+
+    pthread_mutex_lock(&runner->lock);
+    bool known = state->num_segments > 0;
+    if (decoded == NULL)
+    {
+        state->failed = true;
+    }
+    else if (!setSegments(state, runner->manifest->num_configs, decoded->num_instructions,
+                          num_segments))
+    {
+        fprintf(stderr, "%s has changed since the journal was written\n", entry->file);
+        state->failed = true;
+    }
+    else if (!known && runner->journal != NULL)
+    {
+        journalTrace(runner->journal, entry->name, decoded->num_instructions, num_segments,
+                     &identity);
+    }
+
+    state->decoded = decoded;
+    state->starts = starts;
+    state->pending = 1; // Until every job is added
+    unsigned c, s;
+    for (c = 0; !state->failed && c < runner->manifest->num_configs; c++)
+    {
+        for (s = 0; s < num_segments; s++)
+        {
+            if (!state->done[c * num_segments + s])
+            {
+                Runner_Job *segment = (Runner_Job *)malloc(sizeof(Runner_Job));
+                *segment = (Runner_Job){runner, trace, c, s};
+                ++state->pending;
+                submitJob(pool, worker, segmentJob, segment);
+            }
+        }
+    }
+    if (decoded != NULL)
+    {
+        releaseTrace(state);
+    }
+    pthread_mutex_unlock(&runner->lock);
+}
+
+static bool traceComplete(const Trace_State *state, unsigned config)
+{
+    return state->num_segments > 0 && state->segments_done[config] == state->num_segments;
+}
+
+// Geometric mean of the positive values; a zero (e.g. no misses) has no log, so it is
+// skipped and counted instead. False if no value was positive.
+static bool geomean(const double *values, unsigned n, double *mean, unsigned *skipped)
+{
+    double log_sum = 0;
+    unsigned used = 0;
+    unsigned i;
+    for (i = 0; i < n; i++)
+    {
+        if (values[i] > 0)
+        {
+            log_sum += log(values[i]);
+            ++used;
+        }
+    }
+    *skipped = n - used;
+    *mean = used > 0 ? exp(log_sum / used) : 0;
+    return used > 0;
+}
+
+#define num_metrics 4
+
+const char *metricNames[num_metrics] = {"accuracy", "branch_mpki", "hit_rate", "cache_mpki"};
+
+static void getMetrics(const Job_Counts *counts, double *metrics)
+{
+    double instructions = counts->instructions > 0 ? counts->instructions : 1;
+    uint64_t mispredictions = counts->branches - counts->correct;
+    uint64_t block_hits = counts->block_accesses - counts->block_misses;
+
+    metrics[0] = counts->branches ? 100.0 * counts->correct / counts->branches : 100.0;
+    metrics[1] = 1000.0 * mispredictions / instructions;
+    metrics[2] = counts->block_accesses ? 100.0 * block_hits / counts->block_accesses : 100.0;
+    metrics[3] = 1000.0 * counts->block_misses / instructions;
+}
+
+static void printResults(const Runner *runner, FILE *csv)
+{
+    const Manifest *manifest = runner->manifest;
+    unsigned t, c, m;
+
+    if (csv != NULL)
+    {
+        fprintf(csv, "trace,config,instructions,branches,mispredictions,cache_accesses,cache_misses");
+        for (m = 0; m < num_metrics; m++)
+        {
+            fprintf(csv, ",%s", metricNames[m]);
+        }
+        fprintf(csv, "\n");
+    }
+
+    printf("%-16s %-16s %14s %12s %10s %12s %10s %12s\n", "Trace", "Config", "Instructions",
+           "Branches", "Accuracy", "Branch MPKI", "Hit Rate", "Cache MPKI");
+    for (t = 0; t < manifest->num_traces; t++)
+    {
+        const Trace_State *state = &runner->traces[t];
+        for (c = 0; c < manifest->num_configs; c++)
+        {
+            if (!traceComplete(state, c))
+            {
+                continue;
+            }
+            const Job_Counts *counts = &state->totals[c];
+            double metrics[num_metrics];
+            getMetrics(counts, metrics);
+
+            printf("%-16s %-16s %14"PRIu64" %12"PRIu64" %9.4f%% %12.4f %9.4f%% %12.4f\n",
+                   manifest->traces[t].name, manifest->configs[c].name, counts->instructions,
+                   counts->branches, metrics[0], metrics[1], metrics[2], metrics[3]);
+            if (csv != NULL)
+            {
+                fprintf(csv, "%s,%s,%"PRIu64",%"PRIu64",%"PRIu64",%"PRIu64",%"PRIu64,
+                        manifest->traces[t].name, manifest->configs[c].name, counts->instructions,
+                        counts->branches, counts->branches - counts->correct,
+                        counts->block_accesses, counts->block_misses);
+                for (m = 0; m < num_metrics; m++)
+                {
+                    fprintf(csv, ",%f", metrics[m]);
+                }
+                fprintf(csv, "\n");
+            }
+        }
+    }
+
+    // Geometric means over the traces each config completed
+    printf("\n%-16s %8s %10s %12s %10s %12s\n", "Geomean", "Traces", "Accuracy", "Branch MPKI",
+           "Hit Rate", "Cache MPKI");
+    double *values = (double *)malloc(num_metrics * manifest->num_traces * sizeof(double));
+    for (c = 0; c < manifest->num_configs; c++)
+    {
+        unsigned n = 0;
+        for (t = 0; t < manifest->num_traces; t++)
+        {
+            if (traceComplete(&runner->traces[t], c))
+            {
+                double metrics[num_metrics];
+                getMetrics(&runner->traces[t].totals[c], metrics);
+                for (m = 0; m < num_metrics; m++)
+                {
+                    values[m * manifest->num_traces + n] = metrics[m];
+                }
+                ++n;
+            }
+        }
+
+        double means[num_metrics];
+        bool valid[num_metrics];
+        unsigned skipped[num_metrics];
+        char cells[num_metrics][32];
+        for (m = 0; m < num_metrics; m++)
+        {
+            valid[m] = geomean(&values[m * manifest->num_traces], n, &means[m], &skipped[m]);
+            if (!valid[m])
+            {
+                snprintf(cells[m], sizeof(cells[m]), "-");
+            }
+            else if (m == 0 || m == 2)
+            {
+                snprintf(cells[m], sizeof(cells[m]), "%.4f%%", means[m]);
+            }
+            else
+            {
+                snprintf(cells[m], sizeof(cells[m]), "%.4f", means[m]);
+            }
+        }
+        printf("%-16s %8u %10s %12s %10s %12s\n", manifest->configs[c].name, n,
+               cells[0], cells[1], cells[2], cells[3]);
+        for (m = 0; m < num_metrics; m++)
+        {
+            if (skipped[m] > 0)
+            {
+                printf("%-16s %8s skipped %u of %u traces with %s 0\n", "", "", skipped[m], n,
+                       metricNames[m]);
+            }
+        }
+        if (csv != NULL)
+        {
+            fprintf(csv, "geomean,%s,,,,,", manifest->configs[c].name);
+            for (m = 0; m < num_metrics; m++)
+            {
+                if (valid[m])
+                {
+                    fprintf(csv, ",%f", means[m]);
+                }
+                else
+                {
+                    fprintf(csv, ",");
+                }
+            }
+            fprintf(csv, "\n");
+        }
+    }
+    free(values);
+}
+
+int main(int argc, const char *argv[])
+{
+    const char *manifest_file = NULL;
+    Runner runner;
+    initRunnerConfig(&runner.config);
+
+    int arg;
+    for (arg = 1; arg < argc; arg++)
+    {
+        if (parseRunnerOption(&runner.config, argc, argv, &arg))
+        {
+        }
+        else if (argv[arg][0] != '-' && manifest_file == NULL)
+        {
+            manifest_file = argv[arg];
+        }
+        else
+        {
+            manifest_file = NULL;
+            break;
+        }
+    }
+
+    if (manifest_file == NULL)
+    {
+        usage(argv[0]);
+
+        return 0;
+    }
+
+    Manifest *manifest = readManifest(manifest_file);
+    if (manifest == NULL)
+    {
+        return 1;
+    }
+
+    runner.manifest = manifest;
+    runner.traces = (Trace_State *)calloc(manifest->num_traces, sizeof(Trace_State));
+    unsigned t;
+    for (t = 0; t < manifest->num_traces; t++)
+    {
+        runner.traces[t].segments_done = (unsigned *)calloc(manifest->num_configs, sizeof(unsigned));
+        runner.traces[t].totals = (Job_Counts *)calloc(manifest->num_configs, sizeof(Job_Counts));
+    }
+    pthread_mutex_init(&runner.lock, NULL);
+    runner.jobs_run = 0;
+    runner.jobs_resumed = 0;
+
+    runner.journal = NULL;
+    runner.journaled = (bool *)calloc(manifest->num_configs, sizeof(bool));
+    if (runner.config.journal != NULL)
+    {
+        runner.journal = openJournal(runner.config.journal, runner.config.split, runner.config.warm,
+                                     replayConfig, replayTrace, replayJob, &runner);
+        if (runner.journal == NULL)
+        {
+            fprintf(stderr, "Give another --journal to start over\n");
+            return 1;
+        }
+
+        unsigned c;
+        for (c = 0; c < manifest->num_configs; c++)
+        {
+            if (!runner.journaled[c])
+            {
+                journalConfig(runner.journal, manifest->configs[c].name,
+                              hashRunConfig(&manifest->configs[c]));
+            }
+        }
+    }
+
+    // Traces the journal holds in full are not even decoded
+    Job_Pool *pool = initJobPool(runner.config.threads);
+    for (t = 0; t < manifest->num_traces; t++)
+    {
+        unsigned c;
+        bool complete = true;
+        for (c = 0; c < manifest->num_configs; c++)
+        {
+            complete = complete && traceComplete(&runner.traces[t], c);
+        }
+        if (!complete)
+        {
+            Runner_Job *job = (Runner_Job *)malloc(sizeof(Runner_Job));
+            *job = (Runner_Job){&runner, t, 0, 0};
+            submitJob(pool, t, decodeJob, job);
+        }
+    }
+    runJobPool(pool);
+
+    FILE *csv = NULL;
+    if (runner.config.output != NULL && (csv = fopen(runner.config.output, "w")) == NULL)
+    {
+        perror(runner.config.output);
+    }
+    printResults(&runner, csv);
+    printf("\nJobs run: %"PRIu64", from the journal: %"PRIu64", stolen: %"PRIu64"\n",
+           runner.jobs_run, runner.jobs_resumed, pool->steals);
+
+    bool failed = false;
+    for (t = 0; t < manifest->num_traces; t++)
+    {
+        failed = failed || runner.traces[t].failed;
+        free(runner.traces[t].done);
+        free(runner.traces[t].segments_done);
+        free(runner.traces[t].totals);
+    }
+    free(runner.traces);
+    free(runner.journaled);
+    if (csv != NULL)
+    {
+        fclose(csv);
+    }
+    if (runner.journal != NULL)
+    {
+        fclose(runner.journal);
+    }
+    freeJobPool(pool);
+    freeManifest(manifest);
+
+    return failed;
+}
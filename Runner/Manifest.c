@@ -0,0 +1,193 @@
+#include "Manifest.h"
+
+int findTrace(const Manifest *manifest, const char *name)
+{
+    unsigned i;
+    for (i = 0; i < manifest->num_traces; i++)
+    {
+        if (strcmp(manifest->traces[i].name, name) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int findConfig(const Manifest *manifest, const char *name)
+{
+    unsigned i;
+    for (i = 0; i < manifest->num_configs; i++)
+    {
+        if (strcmp(manifest->configs[i].name, name) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// FNV-1a, a byte of word at a time
+static uint64_t hashWord(uint64_t hash, uint64_t word)
+{
+    unsigned i;
+    for (i = 0; i < 8; i++)
+    {
+        hash = (hash ^ (word >> (8 * i) & 0xff)) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+uint64_t hashRunConfig(const Run_Config *config)
+{
+    const Branch_Predictor_Config *predictor = &config->predictor;
+    const Cache_Config *cache = &config->cache;
+
+    uint32_t theta;
+    memcpy(&theta, &predictor->theta, sizeof(theta));
+
+    uint64_t words[] = {predictor->type, predictor->local_predictor_size,
+                        predictor->local_counter_bits, predictor->local_history_bits,
+                        predictor->local_history_table_size, predictor->global_predictor_size,
+                        predictor->global_counter_bits, predictor->choice_counter_bits,
+                        predictor->gshare_predictor_size, predictor->gshare_counter_bits,
+                        predictor->perceptron_size, predictor->perceptron_history, theta,
+                        cache->block_size, cache->cache_size, cache->assoc, cache->num_sets,
+                        cache->set_index, cache->policy, cache->rrpv_bits};
+    uint64_t hash = 0xcbf29ce484222325ull;
+    unsigned i;
+    for (i = 0; i < sizeof(words) / sizeof(words[0]); i++)
+    {
+        hash = hashWord(hash, words[i]);
+    }
+    return hash;
+}
+
+// The options of a config line, from argv[2] on
+static bool parseConfig(Run_Config *config, int argc, const char *argv[])
+{
+    initPredictorConfig(&config->predictor);
+    initCacheConfig(&config->cache);
+
+    int arg;
+    for (arg = 2; arg < argc; arg++)
+    {
+        if (parsePredictorOption(&config->predictor, argc, argv, &arg))
+        {
+        }
+        else if (parseCacheOption(&config->cache, argc, argv, &arg))
+        {
+        }
+        else
+        {
+            fprintf(stderr, "Config %s: unknown option %s\n", argv[1], argv[arg]);
+            return false;
+        }
+    }
+
+    // Belady needs the next use of every request, a second pass over the trace
+    if (config->cache.policy == BELADY_POLICY)
+    {
+        fprintf(stderr, "Config %s: the data cache cannot replace with %s\n", argv[1],
+                policyName(BELADY_POLICY));
+        return false;
+    }
+    return checkPredictorConfig(&config->predictor) && checkCacheConfig(&config->cache);
+}
+
+Manifest *readManifest(const char *file)
+{
+    FILE *fd = fopen(file, "r");
+    if (fd == NULL)
+    {
+        perror(file);
+        return NULL;
+    }
+
+    Manifest *manifest = (Manifest *)calloc(1, sizeof(Manifest));
+    unsigned trace_capacity = 0;
+    unsigned config_capacity = 0;
+    bool ok = true;
+
+    char *line = NULL;
+    size_t len = 0;
+    unsigned line_num = 0;
+    while (ok && getline(&line, &len, fd) != -1)
+    {
+        ++line_num;
+
+        const char *argv[max_manifest_args];
+        int argc = 0;
+        char *ptr = strtok(line, " \t\r\n");
+        while (ptr != NULL && ptr[0] != '#' && argc < max_manifest_args)
+        {
+            argv[argc++] = ptr;
+            ptr = strtok(NULL, " \t\r\n");
+        }
+        if (argc == 0)
+        {
+            continue;
+        }
+
+        if (strcmp(argv[0], "trace") == 0 && argc == 3 && findTrace(manifest, argv[1]) < 0)
+        {
+            if (manifest->num_traces == trace_capacity)
+            {
+                trace_capacity = trace_capacity ? 2 * trace_capacity : 16;
+                manifest->traces = (Trace_Entry *)realloc(manifest->traces,
+                                                          trace_capacity * sizeof(Trace_Entry));
+            }
+            Trace_Entry *trace = &manifest->traces[manifest->num_traces++];
+            trace->name = strdup(argv[1]);
+            trace->file = strdup(argv[2]);
+        }
+        else if (strcmp(argv[0], "config") == 0 && argc >= 2 && findConfig(manifest, argv[1]) < 0)
+        {
+            if (manifest->num_configs == config_capacity)
+            {
+                config_capacity = config_capacity ? 2 * config_capacity : 16;
+                manifest->configs = (Run_Config *)realloc(manifest->configs,
+                                                          config_capacity * sizeof(Run_Config));
+            }
+            Run_Config *config = &manifest->configs[manifest->num_configs++];
+            config->name = strdup(argv[1]);
+            ok = parseConfig(config, argc, argv);
+        }
+        else
+        {
+            fprintf(stderr, "%s:%u: expected a trace or config line with a new name\n",
+                    file, line_num);
+            ok = false;
+        }
+    }
+    free(line);
+    fclose(fd);
+
+    if (ok && (manifest->num_traces == 0 || manifest->num_configs == 0))
+    {
+        fprintf(stderr, "%s: no traces or no configs\n", file);
+        ok = false;
+    }
+    if (!ok)
+    {
+        freeManifest(manifest);
+        return NULL;
+    }
+    return manifest;
+}
+
+void freeManifest(Manifest *manifest)
+{
+    unsigned i;
+    for (i = 0; i < manifest->num_traces; i++)
+    {
+        free(manifest->traces[i].name);
+        free(manifest->traces[i].file);
+    }
+    for (i = 0; i < manifest->num_configs; i++)
+    {
+        free(manifest->configs[i].name);
+    }
+    free(manifest->traces);
+    free(manifest->configs);
+    free(manifest);
+}
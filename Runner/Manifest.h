@@ -0,0 +1,57 @@
+#ifndef __MANIFEST_HH__
+#define __MANIFEST_HH__
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bpsim.h"
+#include "cachesim.h"
+
+// The traces and configurations of a run, one per line:
+//
+//   # comment
+//   trace <name> <trace-file>
+//   config <name> [--predictor <name>] [--policy <name>] [cache options]
+//
+// Every configuration runs on every trace. Names are the keys of the
+// results and of the journal, so they must be unique.
+
+#define max_manifest_args 64
+
+typedef struct Trace_Entry
+{
+    char *name;
+    char *file;
+}Trace_Entry;
+
+typedef struct Run_Config
+{
+    char *name;
+    Branch_Predictor_Config predictor;
+    Cache_Config cache; // With the policy
+}Run_Config;
+
+typedef struct Manifest
+{
+    Trace_Entry *traces;
+    unsigned num_traces;
+    Run_Config *configs;
+    unsigned num_configs;
+}Manifest;
+
+// NULL, after printing what is wrong, if the manifest cannot be used
+Manifest *readManifest(const char *file);
+void freeManifest(Manifest *manifest);
+
+// Of the options of a configuration, not its name, to tell if they changed.
+// The backing of the tables and the cache kernel do not change results and
+// are left out.
+uint64_t hashRunConfig(const Run_Config *config);
+
+// Index of the trace or configuration called name, -1 if none
+int findTrace(const Manifest *manifest, const char *name);
+int findConfig(const Manifest *manifest, const char *name);
+
+#endif
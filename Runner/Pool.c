@@ -0,0 +1,188 @@
+#include "Pool.h"
+
+#define initial_deque_capacity 64
+
+Job_Pool *initJobPool(unsigned num_workers)
+{
+    Job_Pool *pool = (Job_Pool *)malloc(sizeof(Job_Pool));
+    pool->num_workers = num_workers;
+    pool->deques = (Job_Deque *)malloc(num_workers * sizeof(Job_Deque));
+    pool->workers = (Worker *)malloc(num_workers * sizeof(Worker));
+
+    unsigned w;
+    for (w = 0; w < num_workers; w++)
+    {
+        Job_Deque *deque = &pool->deques[w];
+        deque->capacity = initial_deque_capacity;
+        deque->jobs = (Job *)malloc(deque->capacity * sizeof(Job));
+        deque->head = 0;
+        deque->count = 0;
+        pthread_mutex_init(&deque->lock, NULL);
+
+        pool->workers[w].pool = pool;
+        pool->workers[w].index = w;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pool->queued = 0;
+    pool->outstanding = 0;
+    pool->steals = 0;
+
+    return pool;
+}
+
+void freeJobPool(Job_Pool *pool)
+{
+    unsigned w;
+    for (w = 0; w < pool->num_workers; w++)
+    {
+        free(pool->deques[w].jobs);
+        pthread_mutex_destroy(&pool->deques[w].lock);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->wake);
+
+    free(pool->deques);
+    free(pool->workers);
+    free(pool);
+}
+
+static void pushJob(Job_Deque *deque, Job job)
+{
+    pthread_mutex_lock(&deque->lock);
+    if (deque->count == deque->capacity)
+    {
+        // Unroll the ring into a buffer twice as big
+        Job *jobs = (Job *)malloc(2 * deque->capacity * sizeof(Job));
+        unsigned i;
+        for (i = 0; i < deque->count; i++)
+        {
+            jobs[i] = deque->jobs[(deque->head + i) % deque->capacity];
+        }
+        free(deque->jobs);
+        deque->jobs = jobs;
+        deque->head = 0;
+        deque->capacity *= 2;
+    }
+    deque->jobs[(deque->head + deque->count) % deque->capacity] = job;
+    ++deque->count;
+    pthread_mutex_unlock(&deque->lock);
+}
+
+// The newest job, by the owner
+static bool popJob(Job_Deque *deque, Job *job)
+{
+    pthread_mutex_lock(&deque->lock);
+    bool found = deque->count > 0;
+    if (found)
+    {
+        --deque->count;
+        *job = deque->jobs[(deque->head + deque->count) % deque->capacity];
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
+
+// The oldest job, by a thief
+static bool stealJob(Job_Deque *deque, Job *job)
+{
+    pthread_mutex_lock(&deque->lock);
+    bool found = deque->count > 0;
+    if (found)
+    {
+        *job = deque->jobs[deque->head];
+        deque->head = (deque->head + 1) % deque->capacity;
+        --deque->count;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
+
+void submitJob(Job_Pool *pool, unsigned worker, Job_Function run, void *arg)
+{
+    // Count the job before it can be taken, else a thief could run it and
+    // take it off the counters first: outstanding would reach 0 early
+    pthread_mutex_lock(&pool->lock);
+    ++pool->queued;
+    ++pool->outstanding;
+    pthread_mutex_unlock(&pool->lock);
+
+    Job job = {run, arg};
+    pushJob(&pool->deques[worker % pool->num_workers], job);
+
+    pthread_mutex_lock(&pool->lock);
+    pthread_cond_signal(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// Own deque first, then the others starting from the next worker
+static bool takeJob(Job_Pool *pool, unsigned worker, Job *job)
+{
+    bool stolen = false;
+    bool found = popJob(&pool->deques[worker], job);
+    unsigned i;
+    for (i = 1; !found && i < pool->num_workers; i++)
+    {
+        found = stolen = stealJob(&pool->deques[(worker + i) % pool->num_workers], job);
+    }
+
+    if (found)
+    {
+        pthread_mutex_lock(&pool->lock);
+        --pool->queued;
+        pool->steals += stolen;
+        pthread_mutex_unlock(&pool->lock);
+    }
+    return found;
+}
+
+static void *runWorker(void *arg)
+{
+    Worker *worker = (Worker *)arg;
+    Job_Pool *pool = worker->pool;
+
+    for (;;)
+    {
+        Job job;
+        if (takeJob(pool, worker->index, &job))
+        {
+            job.run(pool, worker->index, job.arg);
+
+            pthread_mutex_lock(&pool->lock);
+            if (--pool->outstanding == 0)
+            {
+                pthread_cond_broadcast(&pool->wake);
+            }
+            pthread_mutex_unlock(&pool->lock);
+            continue;
+        }
+
+        // Nothing to take: wait for a running job to add one, or for the end
+        pthread_mutex_lock(&pool->lock);
+        while (pool->queued == 0 && pool->outstanding > 0)
+        {
+            pthread_cond_wait(&pool->wake, &pool->lock);
+        }
+        bool done = pool->outstanding == 0;
+        pthread_mutex_unlock(&pool->lock);
+        if (done)
+        {
+            break;
+        }
+    }
+    return NULL;
+}
+
+void runJobPool(Job_Pool *pool)
+{
+    unsigned w;
+    for (w = 0; w < pool->num_workers; w++)
+    {
+        pthread_create(&pool->workers[w].thread, NULL, runWorker, &pool->workers[w]);
+    }
+    for (w = 0; w < pool->num_workers; w++)
+    {
+        pthread_join(pool->workers[w].thread, NULL);
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef __POOL_HH__
+#define __POOL_HH__
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h> // uint64_t
+
+// A work-stealing pool of threads.
+//
+// Every worker has its own deque of jobs. It runs the newest job of its own
+// deque and, once that is empty, steals the oldest job of another worker.
+// The jobs a job adds thus stay on its worker, close to the data it just
+// made, while idle workers take the older and bigger ones. Jobs are coarse
+// (whole trace segments), so each deque simply has a lock.
+
+typedef struct Job_Pool Job_Pool;
+
+// A job runs on worker and may add jobs to the pool
+typedef void (*Job_Function)(Job_Pool *pool, unsigned worker, void *arg);
+
+typedef struct Job
+{
+    Job_Function run;
+    void *arg;
+}Job;
+
+// Ring of jobs, the oldest at head
+typedef struct Job_Deque
+{
+    Job *jobs;
+    unsigned capacity;
+    unsigned head;
+    unsigned count;
+    pthread_mutex_t lock;
+}Job_Deque;
+
+typedef struct Worker
+{
+    Job_Pool *pool;
+    unsigned index;
+    pthread_t thread;
+}Worker;
+
+struct Job_Pool
+{
+    unsigned num_workers;
+    Job_Deque *deques;
+    Worker *workers;
+
+    pthread_mutex_t lock;
+    pthread_cond_t wake; // A job was added, or none is left
+    uint64_t queued; // Jobs in the deques
+    uint64_t outstanding; // Jobs queued or running
+    uint64_t steals;
+};
+
+Job_Pool *initJobPool(unsigned num_workers);
+void freeJobPool(Job_Pool *pool);
+
+// Add a job to the deque of worker, the one running the calling job or,
+// before runJobPool(), any worker to spread the first jobs
+void submitJob(Job_Pool *pool, unsigned worker, Job_Function run, void *arg);
+// Run the jobs until all of them, including the ones added by jobs, are done
+void runJobPool(Job_Pool *pool);
+
+#endif
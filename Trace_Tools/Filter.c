@@ -0,0 +1,208 @@
+#include "Trace.h"
+#include "Binary_Trace.h"
+#include "cachesim.h"
+
+// Cuts a CPU trace down to the streams a sweep reads: the branches alone
+// for the branch predictor, the loads and stores alone for the cache and,
+// optionally, only the loads and stores missing a small front cache, for
+// the levels behind it. Both TraceParsers read the streams in place of text
+// traces (see Binary_Trace.h).
+
+extern TraceParser *initTraceParser(const char * trace_file);
+extern bool getInstruction(TraceParser *cpu_trace);
+extern void closeTraceParser(TraceParser *cpu_trace);
+
+typedef struct Filter_Output
+{
+    const char *file; // NULL: not asked for
+    FILE *fd;
+    uint64_t records;
+}Filter_Output;
+
+static bool openOutput(Filter_Output *output, Stream_Kind kind, uint32_t flags)
+{
+    output->records = 0;
+    output->fd = NULL;
+    if (output->file == NULL)
+    {
+        return true;
+    }
+
+    output->fd = fopen(output->file, "wb");
+    if (output->fd == NULL || !writeStreamHeader(output->fd, kind, flags))
+    {
+        perror(output->file);
+        return false;
+    }
+    return true;
+}
+
+// Close and report; false on write errors
+static bool closeOutput(Filter_Output *output, const char *what)
+{
+    if (output->fd == NULL)
+    {
+        return true;
+    }
+
+    long bytes = ftell(output->fd);
+    bool ok = !ferror(output->fd);
+    ok = fclose(output->fd) == 0 && ok;
+    if (!ok)
+    {
+        fprintf(stderr, "Could not write %s\n", output->file);
+        return false;
+    }
+    printf("%-20s %s: %"PRIu64" records, %ld bytes\n", what, output->file, output->records, bytes);
+    return true;
+}
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s [options] <trace-file>\n", prog);
+    printf("  --branches <file>  write the branches to <file>\n");
+    printf("  --memory <file>    write the loads and stores to <file>\n");
+    printf("  --l1-misses <file> write the loads and stores missing a front cache\n");
+    printf("                     to <file>\n");
+    printf("Front cache options (default 32 KB, 8 ways, 64 B blocks):\n");
+    printCacheUsage();
+}
+
+int main(int argc, const char *argv[])
+{
+    const char *trace_file = NULL;
+    Filter_Output branches = {NULL, NULL, 0};
+    Filter_Output memory = {NULL, NULL, 0};
+    Filter_Output l1_misses = {NULL, NULL, 0};
+
+    Cache_Config cache_config;
+    initCacheConfig(&cache_config);
+    cache_config.cache_size = 32;
+    cache_config.pages = SMALL_PAGES;
+
+    int arg;
+    for (arg = 1; arg < argc; arg++)
+    {
+        if (strcmp(argv[arg], "--branches") == 0 && arg + 1 < argc)
+        {
+            branches.file = argv[++arg];
+        }
+        else if (strcmp(argv[arg], "--memory") == 0 && arg + 1 < argc)
+        {
+            memory.file = argv[++arg];
+        }
+        else if (strcmp(argv[arg], "--l1-misses") == 0 && arg + 1 < argc)
+        {
+            l1_misses.file = argv[++arg];
+        }
+        else if (parseCacheOption(&cache_config, argc, argv, &arg))
+        {
+        }
+        else if (argv[arg][0] != '-' && trace_file == NULL)
+        {
+            trace_file = argv[arg];
+        }
+        else
+        {
+            trace_file = NULL;
+            break;
+        }
+    }
+
+    if (trace_file == NULL || (branches.file == NULL && memory.file == NULL && l1_misses.file == NULL))
+    {
+        usage(argv[0]);
+
+        return 0;
+    }
+
+    // The front cache, only to tell misses
+    Cache *cache = NULL;
+    if (l1_misses.file != NULL)
+    {
+        if (!checkCacheConfig(&cache_config))
+        {
+            return 1;
+        }
+        if (cache_config.policy == BELADY_POLICY)
+        {
+            fprintf(stderr, "The front cache cannot replace with %s\n", policyName(BELADY_POLICY));
+            return 1;
+        }
+        if ((cache = initCache(&cache_config)) == NULL)
+        {
+            return 1;
+        }
+    }
+
+    TraceParser *cpu_trace = initTraceParser(trace_file);
+    if (cpu_trace == NULL || !openOutput(&branches, BRANCH_STREAM, 0) ||
+        !openOutput(&memory, MEMORY_STREAM, 0) ||
+        !openOutput(&l1_misses, MEMORY_STREAM, l1_filtered_stream))
+    {
+        return 1;
+    }
+
+    uint64_t num_of_instructions = 0;
+    uint32_t skipped = 0; // Instructions since the last branch
+    while (getInstruction(cpu_trace))
+    {
+        Instruction *instr = cpu_trace->cur_instr;
+        ++num_of_instructions;
+
+        if (instr->instr_type == BRANCH)
+        {
+            Branch_Record record = {instr->PC, skipped, instr->taken != 0};
+            branches.records += branches.fd != NULL && writeBranchRecord(branches.fd, &record);
+            skipped = 0;
+            continue;
+        }
+
+        if (skipped == UINT32_MAX)
+        {
+            Branch_Record record = {0, skipped, skip_only};
+            branches.records += branches.fd != NULL && writeBranchRecord(branches.fd, &record);
+            skipped = 0;
+        }
+        ++skipped;
+
+        if (instr->instr_type == LOAD || instr->instr_type == STORE)
+        {
+            bool store = instr->instr_type == STORE;
+            Memory_Record record = {instr->PC, instr->load_or_store_addr, 0, store, instr->size};
+            memory.records += memory.fd != NULL && writeMemoryRecord(memory.fd, &record);
+            if (cache != NULL && !accessCache(cache, instr->PC, instr->load_or_store_addr, store, 0))
+            {
+                l1_misses.records += writeMemoryRecord(l1_misses.fd, &record);
+            }
+        }
+    }
+
+    // The instructions after the last branch
+    if (skipped > 0)
+    {
+        Branch_Record record = {0, skipped, skip_only};
+        branches.records += branches.fd != NULL && writeBranchRecord(branches.fd, &record);
+    }
+
+    long trace_bytes = ftell(cpu_trace->fd);
+    closeTraceParser(cpu_trace);
+
+    printf("%-20s %s: %"PRIu64" instructions, %ld bytes\n", "Trace", trace_file,
+           num_of_instructions, trace_bytes);
+    bool ok = closeOutput(&branches, "Branch stream");
+    ok = closeOutput(&memory, "Memory stream") && ok;
+    ok = closeOutput(&l1_misses, "L1 miss stream") && ok;
+
+    if (cache != NULL)
+    {
+        Cache_Stats stats;
+        getCacheStats(cache, &stats);
+        printf("Front cache: %u KB, %u ways, %s, hit rate %f%%\n", cache_config.cache_size,
+               cache_config.assoc, policyName(getPolicy(cache)),
+               stats.accesses ? 100.0 * stats.hits / stats.accesses : 100.0);
+        freeCache(cache);
+    }
+
+    return !ok;
+}
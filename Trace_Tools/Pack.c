@@ -0,0 +1,256 @@
+#include "Binary_Trace.h"
+#include "Chunked_Trace.h"
+#include "Trace_Decode.h"
+
+// Packs a trace into a chunked container (see Chunked_Trace.h), or unpacks
+// one back to text. The input may be a CPU or memory text trace, a flat
+// stream of Filter or another container, decoded by a Decode_Pipeline (see
+// Trace_Decode.h) while the previous records are packed.
+
+typedef struct Trace_Input
+{
+    FILE *fd;
+    Stream_Kind kind;
+    uint32_t flags;
+    bool text;
+    Chunk_Reader *chunked; // NULL if flat or text
+    Decode_Pipeline *pipeline;
+    char *line;
+    size_t len;
+}Trace_Input;
+
+static bool openInput(Trace_Input *input, const char *file)
+{
+    memset(input, 0, sizeof(Trace_Input));
+    input->fd = openTraceFile(file);
+    if (input->fd == NULL)
+    {
+        perror(file);
+        return false;
+    }
+
+    if ((input->chunked = openChunkReader(input->fd)) != NULL)
+    {
+        input->kind = input->chunked->kind;
+        input->flags = input->chunked->flags;
+    }
+    else if (!readStreamHeader(input->fd, &input->kind, &input->flags))
+    {
+        // A CPU trace has the record type second, a memory trace fourth
+        input->text = true;
+        Stream_Record record;
+        if (getline(&input->line, &input->len, input->fd) != -1)
+        {
+            input->kind = parseTextRecord(input->line, CPU_STREAM, &record) ? CPU_STREAM
+                                                                           : MEMORY_STREAM;
+        }
+        rewind(input->fd);
+    }
+
+    input->pipeline = openDecodePipeline(input->fd, input->kind, input->text, input->chunked, 1);
+    return input->pipeline != NULL;
+}
+
+static void closeInput(Trace_Input *input)
+{
+    if (input->pipeline != NULL)
+    {
+        closeDecodePipeline(input->pipeline);
+    }
+    if (input->chunked != NULL)
+    {
+        closeChunkReader(input->chunked);
+    }
+    free(input->line);
+    fclose(input->fd);
+}
+
+// The record as text, in the format of its kind; branch streams come out as
+// CPU traces, the instructions they left out as "0 E"
+static void printRecord(FILE *out, Stream_Kind kind, const Stream_Record *record)
+{
+    static const char types[] = "EBLS";
+    uint32_t i;
+    for (i = 0; i < record->skipped; i++)
+    {
+        fputs("0 E\n", out);
+    }
+
+    if (record->type == SKIP_RECORD)
+    {
+        return;
+    }
+    if (kind == MEMORY_STREAM)
+    {
+        fprintf(out, "%u %"PRIu64" %"PRIu64" %c\n", record->core, record->PC, record->addr,
+                types[record->type]);
+    }
+    else if (record->type == BRANCH_RECORD)
+    {
+        fprintf(out, "%"PRIu64" B %u\n", record->PC, record->taken);
+    }
+    else if (record->type == EXE_RECORD)
+    {
+        fprintf(out, "%"PRIu64" E\n", record->PC);
+    }
+    else
+    {
+        fprintf(out, "%"PRIu64" %c %"PRIu64" %u\n", record->PC, types[record->type], record->addr,
+                record->size);
+    }
+}
+
+static int unpack(const char *file, uint64_t from, uint64_t count)
+{
+    FILE *fd = openTraceFile(file);
+    if (fd == NULL)
+    {
+        perror(file);
+        return 1;
+    }
+    Chunk_Reader *reader = openChunkReader(fd);
+    if (reader == NULL)
+    {
+        fprintf(stderr, "%s is not a chunked trace\n", file);
+        fclose(fd);
+        return 1;
+    }
+    if (from > 0 && !seekChunkRecord(reader, from))
+    {
+        fprintf(stderr, "%s has no record %"PRIu64" or no index\n", file, from);
+        closeChunkReader(reader);
+        fclose(fd);
+        return 1;
+    }
+
+    Stream_Record record;
+    uint64_t r;
+    for (r = 0; (count == 0 || r < count) && readChunkRecord(reader, &record); r++)
+    {
+        printRecord(stdout, reader->kind, &record);
+    }
+
+    bool corrupt = reader->corrupt;
+    if (corrupt)
+    {
+        fprintf(stderr, "%s is corrupt after record %"PRIu64"\n", file, from + r);
+    }
+    closeChunkReader(reader);
+    fclose(fd);
+    return corrupt;
+}
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s [--chunk N] <trace-file> <container>\n", prog);
+    printf("       %s --unpack [--from R] [--count C] <container>\n", prog);
+    printf("  --chunk N          records per chunk (default %u)\n", default_chunk_records);
+    printf("  --unpack           print the records of <container> as a text trace\n");
+    printf("  --from R           start at record R, through the chunk index\n");
+    printf("  --count C          print at most C records\n");
+}
+
+int main(int argc, const char *argv[])
+{
+    const char *files[2] = {NULL, NULL};
+    unsigned num_files = 0;
+    unsigned chunk_records = default_chunk_records;
+    bool unpacking = false;
+    uint64_t from = 0;
+    uint64_t count = 0;
+
+    int arg;
+    for (arg = 1; arg < argc; arg++)
+    {
+        if (strcmp(argv[arg], "--chunk") == 0 && arg + 1 < argc)
+        {
+            chunk_records = strtoul(argv[++arg], NULL, 10);
+        }
+        else if (strcmp(argv[arg], "--unpack") == 0)
+        {
+            unpacking = true;
+        }
+        else if (strcmp(argv[arg], "--from") == 0 && arg + 1 < argc)
+        {
+            from = strtoull(argv[++arg], NULL, 10);
+        }
+        else if (strcmp(argv[arg], "--count") == 0 && arg + 1 < argc)
+        {
+            count = strtoull(argv[++arg], NULL, 10);
+        }
+        else if (argv[arg][0] != '-' && num_files < 2)
+        {
+            files[num_files++] = argv[arg];
+        }
+        else
+        {
+            num_files = 0;
+            break;
+        }
+    }
+
+    if (num_files != (unpacking ? 1 : 2))
+    {
+        usage(argv[0]);
+
+        return 0;
+    }
+    if (unpacking)
+    {
+        return unpack(files[0], from, count);
+    }
+    if (chunk_records == 0 || chunk_records > max_chunk_records)
+    {
+        fprintf(stderr, "--chunk must be between 1 and %u\n", max_chunk_records);
+        return 1;
+    }
+
+    Trace_Input input;
+    if (!openInput(&input, files[0]))
+    {
+        return 1;
+    }
+    FILE *out = fopen(files[1], "wb");
+    Chunk_Writer *writer = out != NULL ? openChunkWriter(out, input.kind, input.flags, chunk_records)
+                                       : NULL;
+    if (writer == NULL)
+    {
+        perror(files[1]);
+        return 1;
+    }
+
+    Stream_Record record;
+    uint64_t num_records = 0;
+    bool ok = true;
+    while (ok && readDecodedRecord(input.pipeline, &record))
+    {
+        ok = writeChunkRecord(writer, &record);
+        ++num_records;
+    }
+    long in_bytes = ftell(input.fd);
+    ok = closeChunkWriter(writer) && ok;
+    long out_bytes = ftell(out);
+    ok = fclose(out) == 0 && ok;
+    if (input.pipeline->corrupt)
+    {
+        fprintf(stderr, "%s is corrupt\n", files[0]);
+        ok = false;
+    }
+    if (input.pipeline->rejected_lines > 0)
+    {
+        fprintf(stderr, "Skipped %"PRIu64" malformed lines of %s\n", input.pipeline->rejected_lines,
+                files[0]);
+    }
+    closeInput(&input);
+
+    if (!ok)
+    {
+        fprintf(stderr, "Could not write %s\n", files[1]);
+        return 1;
+    }
+    printf("%s: %s stream, %"PRIu64" records, %ld bytes\n", files[0], streamKindName(input.kind),
+           num_records, in_bytes);
+    printf("%s: %ld bytes (%.2fx smaller)\n", files[1], out_bytes,
+           out_bytes > 0 ? (double)in_bytes / out_bytes : 0.0);
+    return 0;
+}